@@ -1,4 +1,18 @@
 #include "raylib.h"
+#include "ledger.h"
+#include "journal.h"
+#include "snapshot.h"
+#include "import.h"
+#include "rules.h"
+#include "search.h"
+#include "rollup.h"
+#include "table.h"
+#include "profile.h"
+#include "report.h"
+#include "budget.h"
+#include "watch.h"
+#include "trend.h"
+#include "text.h"
 #include <iostream>
 #include <vector>
 #include <string>
@@ -9,19 +23,16 @@
 #include <algorithm>
 #include <cmath>
 #include <cstring>
-#include <fstream>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 const int screenWidth = 1200;
 const int screenHeight = 700;
 const float pi = 3.14159265358979323846f;
 
-struct Transaction {
-    std::string date;
-    std::string category;
-    float amount;
-    std::string description;
-};
-
 std::map<std::string, Color> categoryColors = {
     {"Food", ORANGE},
     {"Housing", BLUE},
@@ -36,89 +47,285 @@ std::map<std::string, Color> categoryColors = {
     {"Income", DARKGREEN}
 };
 
-std::vector<Transaction> transactions;
-std::vector<std::string> categories = {"Food", "Housing", "Transportation", "Entertainment", 
-                                     "Utilities", "Healthcare", "Education", "Shopping", 
-                                     "Savings", "Other", "Income"};
-
-enum AppScreen { DASHBOARD, ADD_TRANSACTION, MONTHLY_SUMMARY };
+enum AppScreen { DASHBOARD, ADD_TRANSACTION, MONTHLY_SUMMARY, RANGE_SUMMARY, LEDGER_TABLE, TREND_CHART };
 AppScreen currentScreen = DASHBOARD;
 
 bool showCategoryDropdown = false;
 int selectedCategory = 0;
 char amountInput[32] = "";
 char descriptionInput[128] = "";
+int64_t editingRow = -1; // row the Add screen is editing, -1 when adding
+char editDateInput[11] = "";
+AppScreen editReturnScreen = DASHBOARD;
 int currentMonth = 0;
 int currentYear = 0;
-Font customFont;
+int recentPage = 0;
+std::vector<uint32_t> recentRows;
+char searchInput[64] = "";
+int searchCategory = -1; // -1 for all categories
+int searchRange = 0;     // 0 all time, 1 month on screen, 2 its year
+std::vector<uint32_t> searchRows;
+int rangePreset = 1; // this month, year to date, last 12 months, all time, custom
+char rangeFromInput[11] = "";
+char rangeToInput[11] = "";
+int trendLevel = -1;               // TrendLevel, or -1 to follow the zoom
+double trendFirstDay = 0;          // the view, in days since 1970-01-01;
+double trendLastDay = 0;           // empty until the chart is first shown
+uint64_t trendSeriesShown = 0b111; // bit per TrendSeries: income, expense, balance
+TableColumn tableSort = COLUMN_DATE;
+bool tableDescending = true;
+size_t tableFirstRow = 0; // scroll position: rank of the top row in the current order
+std::vector<uint32_t> tableRows;
+
+// The ledger loads on loaderThread while the window is already drawing.
+// Until ledgerReady the store belongs to the loader, and screens read only
+// loadProgress.
+std::thread loaderThread;
+std::atomic<bool> ledgerLoaded(false);
+bool ledgerReady = false;
+bool ledgerReloading = false; // loading again after the file changed on disk
+LoadStats ledgerLoadStats = {0, 0};
+std::string importStatus;
+bool journalFailureShown = false;
+
+// With --idle the loop sleeps in EndDrawing until there is input, once the
+// ledger has loaded (the progress bar before that needs every frame).
+// raylib's desktop build links GLFW, whose empty event also wakes that wait;
+// idleTimer posts one a minute so date-dependent screens still roll over.
+extern "C" void glfwPostEmptyEvent(void);
+bool idleRendering = false;
+std::thread idleTimer;
+std::mutex idleMutex;
+std::condition_variable idleWake;
+bool idleStopping = false;
+uint64_t framesRendered = 0;
 
+#ifdef BUDGET_PROFILE
+// F3 shows the profiler overlay, F4 writes the trace so far; it is also
+// written on exit.
+const char* profilePath = "profile.json";
+bool showProfiler = false;
+void DrawProfilerOverlay();
+#endif
+
+// A screen region drawn into its own texture and redrawn only when its key,
+// a hash of everything it shows, changes; other frames just blit it.
+struct CachedPanel {
+    RenderTexture2D target;
+    uint64_t key;
+    bool valid;
+};
+CachedPanel headerPanel = {};
+CachedPanel dashboardPanel = {};
+CachedPanel summaryPanel = {};
+CachedPanel rangePanel = {};
+CachedPanel ledgerPanel = {};
+CachedPanel trendPanel = {};
+const Rectangle headerBounds = {0, 0, screenWidth, 60};
+const Rectangle bodyBounds = {0, 60, screenWidth, screenHeight - 60};
+
+Color GetCategoryColor(const std::string& category);
 void DrawDashboard();
 void DrawAddTransaction();
+void BeginEditTransaction(uint32_t row);
+void EndEditTransaction();
+void DrawEditButtons();
 void DrawMonthlySummary();
+void DrawRangeSummary();
+void DrawRangeTotals(const MonthSummary& summary, const MonthSummary& previous, bool compare);
+void DrawLedgerTable();
+void DrawTrendChart();
+void DrawTrendAxes(Rectangle plot, double firstDay, double lastDay, double low, double high);
+bool EditDateInput(char* input, bool focused);
+void DrawLoadingProgress(int y);
+uint64_t MixKey(uint64_t key, uint64_t value);
+bool BeginPanel(CachedPanel& panel, Rectangle bounds, uint64_t key, Color background);
+void EndPanel();
+void DrawPanel(const CachedPanel& panel, Rectangle bounds);
 void InitBudgetTracker();
-void AddTransaction(const Transaction& transaction);
-void LoadTransactionsFromCSV();
-void SaveTransactionToCSV(const Transaction& transaction);
-std::string GetMonthName(int month);
-std::vector<Transaction> GetTransactionsForMonth(int month, int year);
-std::map<std::string, float> GetCategorySummary(const std::vector<Transaction>& transactions);
-float GetTotalIncome(const std::vector<Transaction>& transactions);
-float GetTotalExpense(const std::vector<Transaction>& transactions);
-
-int main() 
+void FinishBudgetTracker();
+void ReloadChangedLedger();
+void ImportDroppedFiles();
+void StartIdleTimer();
+void StopIdleTimer();
+
+int main(int argc, char** argv) 
 {
+    FsyncPolicy fsyncPolicy = FSYNC_INTERVAL;
+    int fsyncIntervalMs = 1000;
+    const char* exportPath = nullptr;
+    const char* importPath = nullptr;
+    bool applyRules = false;
+    bool report = false;
+    int reportFirstMonth = 0;
+    int reportLastMonth = 0;
+    ReportFormat reportFormat = REPORT_CSV;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--fsync=", 8) == 0) {
+            if (!ParseFsyncPolicy(argv[i] + 8, fsyncPolicy, fsyncIntervalMs)) {
+                std::cerr << "Unknown fsync policy '" << argv[i] + 8 << "' (use commit, never or <N>ms)\n";
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--export-csv=", 13) == 0) {
+            exportPath = argv[i] + 13;
+        } else if (strncmp(argv[i], "--import-csv=", 13) == 0) {
+            importPath = argv[i] + 13;
+        } else if (strcmp(argv[i], "--apply-rules") == 0) {
+            applyRules = true;
+        } else if (strcmp(argv[i], "--idle") == 0) {
+            idleRendering = true;
+        } else if (strcmp(argv[i], "--report") == 0) {
+            // The twelve months up to and including this one.
+            time_t now = time(0);
+            struct tm* ltm = localtime(&now);
+            report = true;
+            reportLastMonth = (ltm->tm_year + 1900) * 12 + ltm->tm_mon;
+            reportFirstMonth = reportLastMonth - 11;
+        } else if (strncmp(argv[i], "--report=", 9) == 0) {
+            if (!ParseMonthRange(argv[i] + 9, reportFirstMonth, reportLastMonth)) {
+                std::cerr << "Bad report range '" << argv[i] + 9 << "' (use YYYY-MM or YYYY-MM:YYYY-MM)\n";
+                return 1;
+            }
+            report = true;
+        } else if (strncmp(argv[i], "--compact-at=", 13) == 0) {
+            if (!ParseCompactionPercent(argv[i] + 13, compactionRatio)) {
+                std::cerr << "Bad compaction threshold '" << argv[i] + 13 << "' (use a percentage from 0 to 100)\n";
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--format=", 9) == 0) {
+            if (!ParseReportFormat(argv[i] + 9, reportFormat)) {
+                std::cerr << "Unknown report format '" << argv[i] + 9 << "' (use csv or json)\n";
+                return 1;
+            }
+        }
+    }
+    
+    // Reports go to stdout and nothing else does, so they can be piped.
+    if (report) {
+        buildBrowseIndexes = false;
+        LoadLedger();
+        WriteReport(reportFirstMonth, reportLastMonth, reportFormat, std::cout);
+#ifdef BUDGET_PROFILE
+        WriteProfileTrace(profilePath);
+#endif
+        return 0;
+    }
+    
+    // CSV import/export and rule runs happen without opening a window.
+    if (exportPath || importPath || applyRules) {
+        buildBrowseIndexes = false;
+        LoadLedger();
+        LoadRules(rulesPath, rules);
+        LoadBudgets(budgetsPath);
+        if (applyRules) {
+            size_t changed = 0;
+            if (!ApplyRulesToLedger(changed)) {
+                std::cerr << "Could not rewrite " << ledgerPath << ", rules not applied\n";
+                return 1;
+            }
+            std::cout << "Recategorized " << changed << " rows\n";
+        }
+        if (importPath) {
+            ImportStats imported = ImportStatement(importPath);
+            std::cout << "Imported " << imported.rowsImported << " rows (" << imported.rowsDuplicate
+                      << " duplicates, " << imported.rowsSkipped << " skipped)\n";
+            for (const BudgetAlert& alert : budgetAlerts) std::cout << FormatBudgetAlert(alert) << "\n";
+        }
+        if (exportPath) {
+            if (!ExportTransactionsToCSV(exportPath)) {
+                std::cerr << "Could not write " << exportPath << "\n";
+                return 1;
+            }
+            std::cout << "Exported " << GetLiveRowCount() << " rows to " << exportPath << "\n";
+        }
+        SaveSnapshot();
+#ifdef BUDGET_PROFILE
+        WriteProfileTrace(profilePath);
+#endif
+        return 0;
+    }
+    
     InitWindow(screenWidth, screenHeight, "Budget Tracker");
     SetTargetFPS(60);
     
-    customFont = LoadFont("Roboto-Regular.ttf");
-    if (customFont.texture.id == 0) {
-        customFont = GetFontDefault();
-    }
+    LoadUIFonts("Roboto-Regular.ttf");
     
     time_t now = time(0);
     struct tm* ltm = localtime(&now);
     currentMonth = ltm->tm_mon;
     currentYear = 1900 + ltm->tm_year;
     
+    StartJournal(ledgerPath, fsyncPolicy, fsyncIntervalMs);
+    StartLedgerWatch(ledgerPath, idleRendering ? glfwPostEmptyEvent : nullptr);
     InitBudgetTracker();
+    double startTime = GetTime();
+    double startCpu = GetProcessCpuSeconds();
     
     while (!WindowShouldClose()) 
     {
+        if (!ledgerReady && ledgerLoaded) {
+            FinishBudgetTracker();
+            // The progress bar needed every frame; from here on only input changes the screen.
+            if (idleRendering) {
+                EnableEventWaiting();
+                if (!idleTimer.joinable()) StartIdleTimer();
+            }
+        }
+        if (ledgerReady && IsFileDropped()) {
+            ImportDroppedFiles();
+        }
+        if (ledgerReady && LedgerFileChanged()) ReloadChangedLedger();
+        if (ledgerReady) CompactLedgerIfNeeded();
+        // Limits crossed by the rows added last frame go to the status line.
+        if (!budgetAlerts.empty()) {
+            importStatus = FormatBudgetAlert(budgetAlerts.back());
+            if (budgetAlerts.size() > 1) importStatus += TextFormat(" (+%zu more)", budgetAlerts.size() - 1);
+            budgetAlerts.clear();
+        }
+        // The journal keeps retrying a failed append; until one succeeds the header says so.
+        bool saveFailing = JournalWriteFailed();
+        if (saveFailing != journalFailureShown) {
+            journalFailureShown = saveFailing;
+            importStatus = TextFormat(saveFailing ? "Could not write to %s, retrying" : "Saved to %s again", ledgerPath.c_str());
+        }
+        
+        PROFILE_BEGIN_FRAME();
+        PROFILE_PHASES("Header");
         BeginDrawing();
         ClearBackground(RAYWHITE);
         
-        DrawRectangle(0, 0, screenWidth, 60, (Color){50, 50, 50, 255});
-        DrawTextEx(customFont, "Budget Tracker", (Vector2){20, 15}, 30, 1, WHITE);
-        
-        Rectangle dashboardBtn = {screenWidth - 500, 10, 150, 40};
-        Rectangle addTransactionBtn = {screenWidth - 330, 10, 150, 40};
-        Rectangle summaryBtn = {screenWidth - 160, 10, 150, 40};
-        
-        if (CheckCollisionPointRec(GetMousePosition(), dashboardBtn)) {
-            DrawRectangleRec(dashboardBtn, (Color){90, 90, 90, 255});
-            if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) currentScreen = DASHBOARD;
-        } else {
-            DrawRectangleRec(dashboardBtn, (Color){70, 70, 70, 255});
-        }
-        
-        if (CheckCollisionPointRec(GetMousePosition(), addTransactionBtn)) {
-            DrawRectangleRec(addTransactionBtn, (Color){90, 90, 90, 255});
-            if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) currentScreen = ADD_TRANSACTION;
-        } else {
-            DrawRectangleRec(addTransactionBtn, (Color){70, 70, 70, 255});
+        // The header redraws only when the pointer crosses a button or the status changes.
+        const Rectangle headerButtons[] = {
+            {screenWidth - 960, 10, 150, 40}, {screenWidth - 800, 10, 150, 40}, {screenWidth - 640, 10, 150, 40},
+            {screenWidth - 480, 10, 150, 40}, {screenWidth - 320, 10, 150, 40}, {screenWidth - 160, 10, 150, 40}
+        };
+        const AppScreen buttonScreens[] = {TREND_CHART, LEDGER_TABLE, RANGE_SUMMARY, DASHBOARD, ADD_TRANSACTION, MONTHLY_SUMMARY};
+        const char* buttonLabels[] = {"Trends", "Ledger", "Ranges", "Dashboard", "Add Transaction", "Summary"};
+        const int labelX[] = {screenWidth - 915, screenWidth - 757, screenWidth - 595, screenWidth - 460, screenWidth - 310, screenWidth - 130};
+        int hoveredButton = -1;
+        for (int i = 0; i < 6; i++) {
+            if (CheckCollisionPointRec(GetMousePosition(), headerButtons[i])) {
+                hoveredButton = i;
+                if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
+                    if (editingRow >= 0) EndEditTransaction(); // leaving the form cancels an edit
+                    currentScreen = buttonScreens[i];
+                }
+            }
         }
-        
-        if (CheckCollisionPointRec(GetMousePosition(), summaryBtn)) {
-            DrawRectangleRec(summaryBtn, (Color){90, 90, 90, 255});
-            if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) currentScreen = MONTHLY_SUMMARY;
-        } else {
-            DrawRectangleRec(summaryBtn, (Color){70, 70, 70, 255});
+        uint64_t headerKey = MixKey(HashBytes(importStatus.data(), importStatus.size()), hoveredButton + 1);
+        if (BeginPanel(headerPanel, headerBounds, headerKey, (Color){50, 50, 50, 255})) {
+            // The status sits under the title, clear of the buttons.
+            DrawUIText("Budget Tracker", (Vector2){20, 8}, 28, WHITE);
+            DrawUIText(importStatus.c_str(), (Vector2){22, 40}, 14, LIGHTGRAY);
+            for (int i = 0; i < 6; i++) {
+                DrawRectangleRec(headerButtons[i], i == hoveredButton ? (Color){90, 90, 90, 255} : (Color){70, 70, 70, 255});
+                DrawUIText(buttonLabels[i], (Vector2){(float)labelX[i], 20}, 20, WHITE);
+            }
+            EndPanel();
         }
+        DrawPanel(headerPanel, headerBounds);
         
-        DrawTextEx(customFont, "Dashboard", (Vector2){screenWidth - 480, 20}, 20, 1, WHITE);
-        DrawTextEx(customFont, "Add Transaction", (Vector2){screenWidth - 320, 20}, 20, 1, WHITE);
-        DrawTextEx(customFont, "Summary", (Vector2){screenWidth - 130, 20}, 20, 1, WHITE);
-        
+        PROFILE_NEXT_PHASE("Screen");
         switch (currentScreen) {
             case DASHBOARD:
                 DrawDashboard();
@@ -129,20 +336,102 @@ int main()
             case MONTHLY_SUMMARY:
                 DrawMonthlySummary();
                 break;
+            case RANGE_SUMMARY:
+                DrawRangeSummary();
+                break;
+            case LEDGER_TABLE:
+                DrawLedgerTable();
+                break;
+            case TREND_CHART:
+                DrawTrendChart();
+                break;
         }
         
+#ifdef BUDGET_PROFILE
+        if (IsKeyPressed(KEY_F3)) showProfiler = !showProfiler;
+        if (IsKeyPressed(KEY_F4)) WriteProfileTrace(profilePath);
+        if (showProfiler) {
+            FlushUIText(); // the overlay covers the screen's text
+            DrawProfilerOverlay();
+        }
+#endif
+        FlushUIText();
+        EndUITextFrame();
+        PROFILE_END_FRAME();
+        PROFILE_NEXT_PHASE("Present"); // includes the vsync or event wait
         EndDrawing();
+        framesRendered++;
     }
     
-    UnloadFont(customFont);
+    TraceLog(LOG_INFO, "Rendered %llu frames in %.1f s using %.2f s of CPU (%s)",
+             (unsigned long long)framesRendered, GetTime() - startTime, GetProcessCpuSeconds() - startCpu,
+             idleRendering ? "idle" : "continuous");
+    StopIdleTimer();
+    if (loaderThread.joinable()) loaderThread.join();
+    StopLedgerWatch();
+    StopCompaction();
+    StopJournal(); // writes out anything still queued
+    if (JournalWriteFailed()) TraceLog(LOG_WARNING, "Rows not yet written to %s were lost", ledgerPath.c_str());
+    SaveSnapshot();
+#ifdef BUDGET_PROFILE
+    WriteProfileTrace(profilePath);
+#endif
+    for (CachedPanel* panel : {&headerPanel, &dashboardPanel, &summaryPanel, &rangePanel, &ledgerPanel, &trendPanel}) {
+        if (panel->target.id != 0) UnloadRenderTexture(panel->target);
+    }
+    UnloadUIFonts();
     CloseWindow();
     return 0;
 }
 
 void InitBudgetTracker() {
-    LoadTransactionsFromCSV();
+    ResetLoadProgress(PackDate(currentYear, currentMonth + 1, 1), PackDate(currentYear, currentMonth + 1, 31));
+    loaderThread = std::thread([]() {
+        ledgerLoadStats = LoadLedger();
+        ledgerLoaded = true;
+    });
+}
+
+void StartIdleTimer() {
+    idleTimer = std::thread([]() {
+        std::unique_lock<std::mutex> lock(idleMutex);
+        while (!idleWake.wait_for(lock, std::chrono::minutes(1), []() { return idleStopping; })) {
+            glfwPostEmptyEvent();
+        }
+    });
+}
+
+void StopIdleTimer() {
+    if (!idleTimer.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        idleStopping = true;
+    }
+    idleWake.notify_one();
+    idleTimer.join();
+}
+
+// Runs on the UI thread once the loader is done, so the sample rows below
+// are only added to a complete ledger.
+void FinishBudgetTracker() {
+    loaderThread.join();
+    recentRows.clear(); // row ids from before a reload; the next frame fills them again
+    tableRows.clear();
+    ledgerReady = true;
+    StartLedgerTail();
+    if (ledgerLoadStats.rowsSkipped > 0) {
+        TraceLog(LOG_WARNING, "Skipped %zu malformed rows in %s", ledgerLoadStats.rowsSkipped, ledgerPath.c_str());
+    }
+    LoadStats ruleStats = LoadRules(rulesPath, rules);
+    if (ruleStats.rowsSkipped > 0) {
+        TraceLog(LOG_WARNING, "Skipped %zu malformed rules in %s", ruleStats.rowsSkipped, rulesPath.c_str());
+    }
+    LoadStats budgetStats = LoadBudgets(budgetsPath);
+    if (budgetStats.rowsSkipped > 0) {
+        TraceLog(LOG_WARNING, "Skipped %zu malformed budgets in %s", budgetStats.rowsSkipped, budgetsPath.c_str());
+    }
     
-    if (transactions.empty()) {
+    if (transactions.empty() && !ledgerReloading) {
         time_t now = time(0);
         struct tm* ltm = localtime(&now);
         int year = 1900 + ltm->tm_year;
@@ -169,167 +458,250 @@ void InitBudgetTracker() {
             AddTransaction(transaction);
         }
     }
+    ledgerReloading = false;
 }
 
-void LoadTransactionsFromCSV() {
-    transactions.clear();
-    std::ifstream file("transactions.csv");
-    if (!file.is_open()) return;
-    
-    std::string line;
-    std::getline(file, line); // Skip header
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string date, category, description, amountStr;
-        
-        std::getline(ss, date, ',');
-        std::getline(ss, category, ',');
-        std::getline(ss, amountStr, ',');
-        std::getline(ss, description);
-        
-        try {
-            float amount = std::stof(amountStr);
-            transactions.push_back({date, category, amount, description});
-        } catch (...) {
-            continue; // Skip invalid lines
-        }
-    }
-    
-    file.close();
-}
-
-void SaveTransactionToCSV(const Transaction& transaction) {
-    std::ifstream fileCheck("transactions.csv");
-    bool fileExists = fileCheck.good();
-    fileCheck.close();
-    
-    std::ofstream file("transactions.csv", std::ios::app);
-    if (!file.is_open()) return;
-    
-    if (!fileExists) {
-        file << "Date,Category,Amount,Description\n";
+// Rows other programs append to the ledger are merged in as they arrive;
+// anything else they do to the file means loading it again, in the
+// background as at startup.
+void ReloadChangedLedger() {
+    LoadStats stats;
+    TailResult result = TailLedgerFile(stats);
+    if (result == TAIL_APPENDED) {
+        importStatus = TextFormat("Loaded %zu rows appended to %s", stats.rowsLoaded, ledgerPath.c_str());
+        if (stats.rowsSkipped > 0) importStatus += TextFormat(" (%zu skipped)", stats.rowsSkipped);
+    } else if (result == TAIL_RELOAD) {
+        if (editingRow >= 0) EndEditTransaction();
+        recentRows.clear(); // their row ids are about to mean other rows
+        tableRows.clear();
+        StopCompaction();
+        ReopenJournal(); // the file may have been replaced under the writer
+        ledgerReady = false;
+        ledgerLoaded = false;
+        ledgerReloading = true;
+        if (idleRendering) DisableEventWaiting();
+        importStatus = TextFormat("%s changed on disk, reloading", ledgerPath.c_str());
+        InitBudgetTracker();
     }
-    
-    file << transaction.date << "," << transaction.category << "," 
-         << std::fixed << std::setprecision(2) << transaction.amount << "," 
-         << transaction.description << "\n";
-    file.close();
 }
 
-void AddTransaction(const Transaction& transaction) {
-    transactions.push_back(transaction);
-    SaveTransactionToCSV(transaction);
+Color GetCategoryColor(const std::string& category) {
+    auto it = categoryColors.find(category);
+    return it != categoryColors.end() ? it->second : GRAY;
 }
 
-std::string GetMonthName(int month) {
-    const std::string monthNames[] = {"January", "February", "March", "April", "May", "June", 
-                                     "July", "August", "September", "October", "November", "December"};
-    return monthNames[month];
+// Bank statements dropped on the window are imported in one batch each.
+void ImportDroppedFiles() {
+    FilePathList files = LoadDroppedFiles();
+    ImportStats total = {0, 0, 0};
+    for (unsigned int i = 0; i < files.count; i++) {
+        ImportStats stats = ImportStatement(files.paths[i]);
+        total.rowsImported += stats.rowsImported;
+        total.rowsDuplicate += stats.rowsDuplicate;
+        total.rowsSkipped += stats.rowsSkipped;
+    }
+    UnloadDroppedFiles(files);
+    importStatus = TextFormat("Imported %zu rows (%zu duplicates, %zu skipped)",
+                              total.rowsImported, total.rowsDuplicate, total.rowsSkipped);
 }
 
-std::vector<Transaction> GetTransactionsForMonth(int month, int year) {
-    std::vector<Transaction> result;
-    std::stringstream prefix;
-    prefix << year << "-" << std::setw(2) << std::setfill('0') << (month + 1);
-    std::string monthPrefix = prefix.str();
+void DrawSummaryCards(int64_t income, int64_t expense) {
+    double totalIncome = ToRupees(income);
+    double totalExpense = ToRupees(expense);
+    double balance = totalIncome - totalExpense;
     
-    for (const auto& transaction : transactions) {
-        if (transaction.date.substr(0, 7) == monthPrefix) {
-            result.push_back(transaction);
-        }
-    }
+    DrawUIText(TextFormat("Dashboard - %s %d", GetMonthName(currentMonth).c_str(), currentYear), 
+               (Vector2){20, 80}, 28, (Color){50, 50, 50, 255});
     
-    return result;
-}
-
-std::map<std::string, float> GetCategorySummary(const std::vector<Transaction>& transactions) {
-    std::map<std::string, float> categorySummary;
+    DrawRectangle(20, 130, 380, 100, (Color){173, 216, 230, 255});
+    DrawRectangle(410, 130, 380, 100, (Color){255, 182, 193, 255});
+    DrawRectangle(800, 130, 380, 100, (Color){144, 238, 144, 255});
     
-    for (const auto& transaction : transactions) {
-        if (transaction.amount < 0) {
-            categorySummary[transaction.category] += -transaction.amount;
-        }
-    }
+    DrawUIText("INCOME", (Vector2){30, 140}, 20, DARKBLUE);
+    DrawUIText(TextFormat("Rs.%.2f", totalIncome), (Vector2){30, 170}, 32, DARKBLUE);
     
-    return categorySummary;
+    DrawUIText("EXPENSES", (Vector2){420, 140}, 20, MAROON);
+    DrawUIText(TextFormat("Rs.%.2f", totalExpense), (Vector2){420, 170}, 32, MAROON);
+    
+    DrawUIText("BALANCE", (Vector2){810, 140}, 20, DARKGREEN);
+    DrawUIText(TextFormat("Rs.%.2f", balance), (Vector2){810, 170}, 32, DARKGREEN);
 }
 
-float GetTotalIncome(const std::vector<Transaction>& transactions) {
-    float total = 0.0f;
-    for (const auto& transaction : transactions) {
-        if (transaction.amount > 0) {
-            total += transaction.amount;
-        }
+// The month's most-spent budgets beside the dashboard title, amber from the
+// first alert threshold and red once over.
+void DrawBudgetBars() {
+    std::vector<std::pair<int, int>> budgets; // percent, category id
+    for (size_t i = 0; i < budgetLimits.size(); i++) {
+        int percent = GetBudgetPercent((int)i, currentMonth, currentYear);
+        if (percent >= 0) budgets.push_back({percent, (int)i});
     }
-    return total;
-}
-
-float GetTotalExpense(const std::vector<Transaction>& transactions) {
-    float total = 0.0f;
-    for (const auto& transaction : transactions) {
-        if (transaction.amount < 0) {
-            total += -transaction.amount;
-        }
+    std::sort(budgets.begin(), budgets.end(), std::greater<std::pair<int, int>>());
+    for (size_t i = 0; i < budgets.size() && i < 3; i++) {
+        int percent = budgets[i].first;
+        float x = 470 + i * 240.0f;
+        Color color = percent >= 100 ? RED : percent >= budgetThresholds[0] ? ORANGE : DARKGREEN;
+        DrawUIText(TextFormat("%s budget: %d%%", categories[budgets[i].second].c_str(), percent),
+                   (Vector2){x, 82}, 16, (Color){50, 50, 50, 255});
+        DrawRectangle((int)x, 104, 220, 8, (Color){220, 220, 220, 255});
+        DrawRectangle((int)x, 104, 220 * std::min(percent, 100) / 100, 8, color);
     }
-    return total;
 }
 
 void DrawDashboard() {
-    std::vector<Transaction> currentMonthTransactions = GetTransactionsForMonth(currentMonth, currentYear);
-    float totalIncome = GetTotalIncome(currentMonthTransactions);
-    float totalExpense = GetTotalExpense(currentMonthTransactions);
-    float balance = totalIncome - totalExpense;
+    if (!ledgerReady) {
+        // Totals so far for the month on screen; the rest needs the full ledger.
+        DrawSummaryCards(loadProgress.focusIncome, loadProgress.focusExpense);
+        DrawLoadingProgress(250);
+        return;
+    }
+    PROFILE_PHASES("Dashboard layout");
     
-    DrawTextEx(customFont, TextFormat("Dashboard - %s %d", GetMonthName(currentMonth).c_str(), currentYear), 
-               (Vector2){20, 80}, 28, 1, (Color){50, 50, 50, 255});
+    // Input first; the panel below is redrawn only if it changed what is shown.
+    // Search box with category and date range filters; any of them switches
+    // the list from recent rows to search results.
+    Rectangle searchBox = {250, 247, 300, 28};
+    Rectangle categoryFilter = {560, 247, 160, 28};
+    Rectangle rangeFilter = {730, 247, 130, 28};
+    Rectangle newerPage = {screenWidth - 190, 248, 30, 26};
+    Rectangle olderPage = {screenWidth - 50, 248, 30, 26};
+    bool searchChanged = false;
     
-    DrawRectangle(20, 130, 380, 100, (Color){173, 216, 230, 255});
-    DrawRectangle(410, 130, 380, 100, (Color){255, 182, 193, 255});
-    DrawRectangle(800, 130, 380, 100, (Color){144, 238, 144, 255});
+    static bool searchFocused = false;
+    static int pageCount = 1; // as of the last redraw
+    if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
+        searchFocused = CheckCollisionPointRec(GetMousePosition(), searchBox);
+    }
+    if (searchFocused) {
+        int key = GetCharPressed();
+        while (key > 0) {
+            int len = strlen(searchInput);
+            if (len < 63 && key >= 32 && key < 127) {
+                searchInput[len] = (char)key;
+                searchInput[len + 1] = '\0';
+                searchChanged = true;
+            }
+            key = GetCharPressed();
+        }
+        if (IsKeyPressed(KEY_BACKSPACE) && strlen(searchInput) > 0) {
+            searchInput[strlen(searchInput) - 1] = '\0';
+            searchChanged = true;
+        }
+    }
+    if (CheckCollisionPointRec(GetMousePosition(), categoryFilter) && IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
+        searchCategory = searchCategory + 1 < (int)categories.size() ? searchCategory + 1 : -1;
+        searchChanged = true;
+    }
+    if (CheckCollisionPointRec(GetMousePosition(), rangeFilter) && IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
+        searchRange = (searchRange + 1) % 3;
+        searchChanged = true;
+    }
+    if (searchChanged) recentPage = 0;
+    
+    if (CheckCollisionPointRec(GetMousePosition(), newerPage) && IsMouseButtonReleased(MOUSE_LEFT_BUTTON) && recentPage > 0) {
+        recentPage--;
+    }
+    if (CheckCollisionPointRec(GetMousePosition(), olderPage) && IsMouseButtonReleased(MOUSE_LEFT_BUTTON) && recentPage + 1 < pageCount) {
+        recentPage++;
+    }
+    // Clicking a row, as drawn last time, opens it for editing.
+    Rectangle recentList = {20, 320, screenWidth - 40, recentRows.size() * 30.0f};
+    if (CheckCollisionPointRec(GetMousePosition(), recentList) && IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
+        BeginEditTransaction(recentRows[(size_t)((GetMousePosition().y - recentList.y) / 30)]);
+        return;
+    }
+    
+    uint64_t key = MixKey(ledgerVersion, currentYear * 12 + currentMonth);
+    key = MixKey(key, HashBytes(searchInput, strlen(searchInput)));
+    key = MixKey(key, ((uint64_t)recentPage << 16) | ((searchCategory + 1) << 4) | (searchRange << 1) | searchFocused);
+    key = MixKey(key, HashBytes((const char*)budgetLimits.data(), budgetLimits.size() * sizeof(int64_t)));
+    PROFILE_NEXT_PHASE("Dashboard draw");
+    if (!BeginPanel(dashboardPanel, bodyBounds, key, RAYWHITE)) {
+        DrawPanel(dashboardPanel, bodyBounds);
+        return;
+    }
     
-    DrawTextEx(customFont, "INCOME", (Vector2){30, 140}, 20, 1, DARKBLUE);
-    DrawTextEx(customFont, TextFormat("Rs.%.2f", totalIncome), (Vector2){30, 170}, 32, 1, DARKBLUE);
+    const MonthSummary& summary = GetMonthSummary(currentMonth, currentYear);
+    DrawSummaryCards(summary.income, summary.expense);
+    DrawBudgetBars();
+    
+    DrawUIText("Recent Transactions", (Vector2){20, 250}, 24, (Color){50, 50, 50, 255});
+    
+    DrawRectangleRec(searchBox, searchFocused ? (Color){220, 220, 220, 255} : (Color){200, 200, 200, 255});
+    if (searchInput[0] != '\0') {
+        DrawUIText(searchInput, (Vector2){258, 252}, 18, BLACK);
+    } else {
+        DrawUIText("Search descriptions", (Vector2){258, 252}, 18, GRAY);
+    }
+    const char* rangeNames[] = {"All time", "This month", "This year"};
+    DrawRectangleRec(categoryFilter, (Color){200, 200, 200, 255});
+    DrawUIText(searchCategory < 0 ? "All categories" : categories[searchCategory].c_str(),
+               (Vector2){568, 252}, 18, BLACK);
+    DrawRectangleRec(rangeFilter, (Color){200, 200, 200, 255});
+    DrawUIText(rangeNames[searchRange], (Vector2){738, 252}, 18, BLACK);
     
-    DrawTextEx(customFont, "EXPENSES", (Vector2){420, 140}, 20, 1, MAROON);
-    DrawTextEx(customFont, TextFormat("Rs.%.2f", totalExpense), (Vector2){420, 170}, 32, 1, MAROON);
+    PROFILE_NEXT_PHASE("Dashboard query");
+    bool searching = searchInput[0] != '\0' || searchCategory >= 0 || searchRange != 0;
+    if (searching) {
+        SearchFilter filter;
+        filter.categoryId = searchCategory;
+        if (searchRange == 1) {
+            filter.firstDate = PackDate(currentYear, currentMonth + 1, 1);
+            filter.lastDate = PackDate(currentYear, currentMonth + 1, 31);
+        } else if (searchRange == 2) {
+            filter.firstDate = PackDate(currentYear, 1, 1);
+            filter.lastDate = PackDate(currentYear, 12, 31);
+        }
+        // One row past the page shows whether an older page exists.
+        SearchTransactions(searchInput, filter, (recentPage + 1) * 10 + 1, searchRows);
+    }
+    pageCount = searching ? recentPage + (searchRows.size() > (size_t)(recentPage + 1) * 10 ? 2 : 1)
+                          : ((int)GetLiveRowCount() + 9) / 10;
+    PROFILE_NEXT_PHASE("Dashboard draw");
     
-    DrawTextEx(customFont, "BALANCE", (Vector2){810, 140}, 20, 1, DARKGREEN);
-    DrawTextEx(customFont, TextFormat("Rs.%.2f", balance), (Vector2){810, 170}, 32, 1, DARKGREEN);
+    DrawRectangleRec(newerPage, (Color){200, 200, 200, 255});
+    DrawUIText("<", (Vector2){screenWidth - 180, 251}, 18, BLACK);
+    DrawUIText(TextFormat("Page %d", recentPage + 1), (Vector2){screenWidth - 150, 251}, 18, BLACK);
+    DrawRectangleRec(olderPage, (Color){200, 200, 200, 255});
+    DrawUIText(">", (Vector2){screenWidth - 40, 251}, 18, BLACK);
     
-    DrawTextEx(customFont, "Recent Transactions", (Vector2){20, 250}, 24, 1, (Color){50, 50, 50, 255});
     DrawLine(20, 280, screenWidth - 20, 280, (Color){200, 200, 200, 255});
     
-    DrawTextEx(customFont, "Date", (Vector2){30, 290}, 18, 1, (Color){50, 50, 50, 255});
-    DrawTextEx(customFont, "Category", (Vector2){200, 290}, 18, 1, (Color){50, 50, 50, 255});
-    DrawTextEx(customFont, "Amount", (Vector2){400, 290}, 18, 1, (Color){50, 50, 50, 255});
-    DrawTextEx(customFont, "Description", (Vector2){550, 290}, 18, 1, (Color){50, 50, 50, 255});
+    DrawUIText("Date", (Vector2){30, 290}, 18, (Color){50, 50, 50, 255});
+    DrawUIText("Category", (Vector2){200, 290}, 18, (Color){50, 50, 50, 255});
+    DrawUIText("Amount", (Vector2){400, 290}, 18, (Color){50, 50, 50, 255});
+    DrawUIText("Description", (Vector2){550, 290}, 18, (Color){50, 50, 50, 255});
     DrawLine(20, 315, screenWidth - 20, 315, (Color){200, 200, 200, 255});
     
-    std::vector<Transaction> sortedTransactions = transactions;
-    std::sort(sortedTransactions.begin(), sortedTransactions.end(), 
-              [](const Transaction& a, const Transaction& b) { return a.date > b.date; });
+    // One page read off the maintained date index; no copy or sort of the ledger.
+    PROFILE_NEXT_PHASE("Dashboard query");
+    if (searching) {
+        size_t first = std::min(searchRows.size(), (size_t)recentPage * 10);
+        recentRows.assign(searchRows.begin() + first, searchRows.begin() + std::min(searchRows.size(), first + 10));
+    } else {
+        GetRecentRows(recentPage, 10, recentRows);
+    }
+    PROFILE_NEXT_PHASE("Dashboard draw");
     
     int y = 325;
     int count = 0;
-    for (const auto& transaction : sortedTransactions) {
+    for (uint32_t row : recentRows) {
         if (count >= 10) break;
+        int64_t amount = transactions.amounts[row];
+        char date[11];
         
-        DrawTextEx(customFont, transaction.date.c_str(), (Vector2){30, y}, 16, 1, (Color){50, 50, 50, 255});
-        DrawTextEx(customFont, transaction.category.c_str(), (Vector2){200, y}, 16, 1, (Color){50, 50, 50, 255});
+        DrawUIText(FormatDate(transactions.dates[row], date), (Vector2){30, y}, 16, (Color){50, 50, 50, 255});
+        DrawUIText(categories[transactions.categoryIds[row]].c_str(), (Vector2){200, y}, 16, (Color){50, 50, 50, 255});
         
-        Color amountColor = transaction.amount >= 0 ? DARKGREEN : MAROON;
-        DrawTextEx(customFont, TextFormat("Rs.%.2f", fabs(transaction.amount)), (Vector2){400, y}, 16, 1, amountColor);
+        Color amountColor = amount >= 0 ? DARKGREEN : MAROON;
+        DrawUIText(TextFormat("Rs.%.2f", fabs(ToRupees(amount))), (Vector2){400, y}, 16, amountColor);
         
-        DrawTextEx(customFont, transaction.description.c_str(), (Vector2){550, y}, 16, 1, (Color){50, 50, 50, 255});
+        DrawUIText(transactions.descriptions.Get(transactions.descriptionIds[row]), (Vector2){550, y}, 16, (Color){50, 50, 50, 255});
         
         y += 30;
         count++;
     }
     
-    std::map<std::string, float> categorySummary = GetCategorySummary(currentMonthTransactions);
-    float totalForPie = totalExpense > 0 ? totalExpense : 1.0f;
-    
-    DrawTextEx(customFont, "Monthly Expense Breakdown", (Vector2){20, 650}, 20, 1, (Color){50, 50, 50, 255});
+    DrawUIText("Monthly Expense Breakdown", (Vector2){20, 650}, 20, (Color){50, 50, 50, 255});
     
     int legendX = 400;
     int legendY = 650;
@@ -337,14 +709,15 @@ void DrawDashboard() {
     int legendSpacing = 25;
     int legendCol = 0;
     
-    for (const auto& category : categories) {
+    for (size_t i = 0; i < categories.size(); i++) {
+        const std::string& category = categories[i];
         if (category == "Income") continue;
         
-        if (categorySummary.find(category) != categorySummary.end() && categorySummary[category] > 0) {
-            Color color = categoryColors[category];
+        if (summary.categoryExpense[i] > 0) {
+            Color color = GetCategoryColor(category);
             DrawRectangle(legendX + legendCol * 180, legendY, legendSize, legendSize, color);
-            DrawTextEx(customFont, TextFormat("%s - Rs.%.2f", category.c_str(), categorySummary[category]), 
-                       (Vector2){legendX + legendCol * 180 + legendSize + 5, legendY}, 16, 1, (Color){50, 50, 50, 255});
+            DrawUIText(TextFormat("%s - Rs.%.2f", category.c_str(), ToRupees(summary.categoryExpense[i])), 
+                       (Vector2){legendX + legendCol * 180 + legendSize + 5, legendY}, 16, (Color){50, 50, 50, 255});
             
             legendY += legendSpacing;
             if (legendY > 650 + 5 * legendSpacing) {
@@ -353,10 +726,19 @@ void DrawDashboard() {
             }
         }
     }
+    
+    EndPanel();
+    DrawPanel(dashboardPanel, bodyBounds);
 }
 
 void DrawAddTransaction() {
-    DrawTextEx(customFont, "Add New Transaction", (Vector2){20, 80}, 28, 1, (Color){50, 50, 50, 255});
+    PROFILE_SCOPE("Add transaction form");
+    DrawUIText(editingRow >= 0 ? "Edit Transaction" : "Add New Transaction", (Vector2){20, 80}, 28,
+               (Color){50, 50, 50, 255});
+    if (!ledgerReady) {
+        DrawLoadingProgress(140);
+        return;
+    }
     
     time_t now = time(0);
     struct tm* ltm = localtime(&now);
@@ -365,14 +747,29 @@ void DrawAddTransaction() {
     int year = 1900 + ltm->tm_year;
     std::string currentDate = TextFormat("%d-%02d-%02d", year, month, day);
     
-    DrawTextEx(customFont, "Date (auto):", (Vector2){30, 140}, 18, 1, (Color){50, 50, 50, 255});
-    DrawTextEx(customFont, currentDate.c_str(), (Vector2){200, 140}, 18, 1, (Color){50, 50, 50, 255});
+    if (editingRow >= 0) {
+        DrawUIText("Date:", (Vector2){30, 140}, 18, (Color){50, 50, 50, 255});
+        Rectangle dateBox = {200, 138, 200, 30};
+        static bool dateFocused = false;
+        if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) dateFocused = CheckCollisionPointRec(GetMousePosition(), dateBox);
+        EditDateInput(editDateInput, dateFocused);
+        DrawRectangleRec(dateBox, dateFocused ? (Color){220, 220, 220, 255} : (Color){200, 200, 200, 255});
+        DrawUIText(editDateInput, (Vector2){210, 143}, 18, BLACK);
+    } else {
+        DrawUIText("Date (auto):", (Vector2){30, 140}, 18, (Color){50, 50, 50, 255});
+        DrawUIText(currentDate.c_str(), (Vector2){200, 140}, 18, (Color){50, 50, 50, 255});
+    }
     
-    DrawTextEx(customFont, "Category:", (Vector2){30, 180}, 18, 1, (Color){50, 50, 50, 255});
+    DrawUIText("Category:", (Vector2){30, 180}, 18, (Color){50, 50, 50, 255});
     Rectangle categoryBox = {200, 180, 200, 30};
     DrawRectangleRec(categoryBox, (Color){200, 200, 200, 255});
-    DrawTextEx(customFont, categories[selectedCategory].c_str(), (Vector2){210, 185}, 18, 1, BLACK);
-    DrawTextEx(customFont, "▼", (Vector2){380, 185}, 18, 1, BLACK);
+    DrawUIText(categories[selectedCategory].c_str(), (Vector2){210, 185}, 18, BLACK);
+    DrawUIText("▼", (Vector2){380, 185}, 18, BLACK);
+    int64_t budgetLimit = GetBudgetLimit(selectedCategory);
+    if (budgetLimit > 0) {
+        DrawUIText(TextFormat("Budget: Rs.%.2f a month", ToRupees(budgetLimit)), (Vector2){420, 185}, 18,
+                   (Color){50, 50, 50, 255});
+    }
     
     if (CheckCollisionPointRec(GetMousePosition(), categoryBox) && IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
         showCategoryDropdown = !showCategoryDropdown;
@@ -384,7 +781,7 @@ void DrawAddTransaction() {
             bool isHovered = CheckCollisionPointRec(GetMousePosition(), option);
             
             DrawRectangleRec(option, isHovered ? (Color){180, 180, 180, 255} : (Color){200, 200, 200, 255});
-            DrawTextEx(customFont, categories[i].c_str(), (Vector2){210, 215 + i * 30}, 18, 1, BLACK);
+            DrawUIText(categories[i].c_str(), (Vector2){210, 215 + i * 30}, 18, BLACK);
             
             if (isHovered && IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
                 selectedCategory = i;
@@ -393,10 +790,10 @@ void DrawAddTransaction() {
         }
     }
     
-    DrawTextEx(customFont, "Amount (Rs.):", (Vector2){30, 220}, 18, 1, (Color){50, 50, 50, 255});
+    DrawUIText("Amount (Rs.):", (Vector2){30, 220}, 18, (Color){50, 50, 50, 255});
     Rectangle amountBox = {200, 220, 200, 30};
     DrawRectangleRec(amountBox, (Color){200, 200, 200, 255});
-    DrawTextEx(customFont, amountInput, (Vector2){210, 225}, 18, 1, BLACK);
+    DrawUIText(amountInput, (Vector2){210, 225}, 18, BLACK);
     
     static bool amountFocused = false;
     if (CheckCollisionPointRec(GetMousePosition(), amountBox) && IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
@@ -426,10 +823,10 @@ void DrawAddTransaction() {
         }
     }
     
-    DrawTextEx(customFont, "Description:", (Vector2){30, 260}, 18, 1, (Color){50, 50, 50, 255});
+    DrawUIText("Description:", (Vector2){30, 260}, 18, (Color){50, 50, 50, 255});
     Rectangle descBox = {200, 260, 400, 30};
     DrawRectangleRec(descBox, (Color){200, 200, 200, 255});
-    DrawTextEx(customFont, descriptionInput, (Vector2){210, 265}, 18, 1, BLACK);
+    DrawUIText(descriptionInput, (Vector2){210, 265}, 18, BLACK);
     
     static bool descFocused = false;
     if (CheckCollisionPointRec(GetMousePosition(), descBox) && IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
@@ -439,12 +836,14 @@ void DrawAddTransaction() {
     }
     
     if (descFocused) {
+        bool edited = false;
         int key = GetCharPressed();
         while (key > 0) {
             int len = strlen(descriptionInput);
             if (len < 127) {
                 descriptionInput[len] = (char)key;
                 descriptionInput[len + 1] = '\0';
+                edited = true;
             }
             key = GetCharPressed();
         }
@@ -453,19 +852,31 @@ void DrawAddTransaction() {
             int len = strlen(descriptionInput);
             if (len > 0) {
                 descriptionInput[len - 1] = '\0';
+                edited = true;
             }
         }
+        
+        // Suggest the category a rule would give this description.
+        if (edited) {
+            int ruleCategory = MatchRules(rules, descriptionInput, strlen(descriptionInput));
+            if (ruleCategory >= 0) selectedCategory = ruleCategory;
+        }
+    }
+    
+    if (editingRow >= 0) {
+        DrawEditButtons();
+        return;
     }
     
     Rectangle addButton = {200, 320, 200, 40};
     bool addButtonHovered = CheckCollisionPointRec(GetMousePosition(), addButton);
     
     DrawRectangleRec(addButton, addButtonHovered ? (Color){34, 139, 34, 255} : DARKGREEN);
-    DrawTextEx(customFont, "Add Transaction", (Vector2){230, 330}, 20, 1, WHITE);
+    DrawUIText("Add Transaction", (Vector2){230, 330}, 20, WHITE);
     
     if (addButtonHovered && IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
         if (strlen(amountInput) > 0) {
-            float amount = std::stof(amountInput);
+            double amount = std::stod(amountInput);
             if (categories[selectedCategory] != "Income") {
                 amount = -fabs(amount);
             } else {
@@ -488,34 +899,124 @@ void DrawAddTransaction() {
             amountInput[0] = '\0';
             descriptionInput[0] = '\0';
             
-            DrawTextEx(customFont, "Transaction added successfully!", (Vector2){200, 380}, 18, 1, GREEN);
+            DrawUIText("Transaction added successfully!", (Vector2){200, 380}, 18, GREEN);
         } else {
-            DrawTextEx(customFont, "Please enter an amount!", (Vector2){200, 380}, 18, 1, RED);
+            DrawUIText("Please enter an amount!", (Vector2){200, 380}, 18, RED);
         }
     }
     
-    DrawTextEx(customFont, "Note: For income, select the 'Income' category and enter a positive amount.", 
-               (Vector2){30, 400}, 16, 1, (Color){50, 50, 50, 255});
-    DrawTextEx(customFont, "For expenses, select the appropriate category and enter the amount.", 
-               (Vector2){30, 425}, 16, 1, (Color){50, 50, 50, 255});
+    Rectangle rulesButton = {420, 320, 180, 40};
+    bool rulesButtonHovered = CheckCollisionPointRec(GetMousePosition(), rulesButton);
+    
+    DrawRectangleRec(rulesButton, rulesButtonHovered ? (Color){90, 90, 90, 255} : (Color){70, 70, 70, 255});
+    DrawUIText("Apply Rules", (Vector2){455, 330}, 20, WHITE);
+    
+    if (rulesButtonHovered && IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
+        size_t changed = 0;
+        importStatus = ApplyRulesToLedger(changed)
+                           ? TextFormat("Rules from %s recategorized %zu rows", rulesPath.c_str(), changed)
+                           : TextFormat("Could not rewrite %s, rules not applied", ledgerPath.c_str());
+    }
+    
+    // The amount as the category's monthly limit; an empty amount removes it.
+    Rectangle budgetButton = {620, 320, 180, 40};
+    bool budgetButtonHovered = CheckCollisionPointRec(GetMousePosition(), budgetButton);
+    
+    DrawRectangleRec(budgetButton, budgetButtonHovered ? (Color){90, 90, 90, 255} : (Color){70, 70, 70, 255});
+    DrawUIText("Set Budget", (Vector2){660, 330}, 20, WHITE);
+    
+    if (budgetButtonHovered && IsMouseButtonReleased(MOUSE_LEFT_BUTTON) && categories[selectedCategory] != "Income") {
+        int64_t limit = 0;
+        ParseAmount(amountInput, strlen(amountInput), limit);
+        SetBudgetLimit(selectedCategory, limit);
+        importStatus = limit > 0 ? TextFormat("%s budget set to Rs.%.2f a month", categories[selectedCategory].c_str(), ToRupees(limit))
+                                 : TextFormat("%s budget removed", categories[selectedCategory].c_str());
+        amountInput[0] = '\0';
+    }
+    
+    DrawUIText("Note: For income, select the 'Income' category and enter a positive amount.", 
+               (Vector2){30, 400}, 16, (Color){50, 50, 50, 255});
+    DrawUIText("For expenses, select the appropriate category and enter the amount.", 
+               (Vector2){30, 425}, 16, (Color){50, 50, 50, 255});
+}
+
+void BeginEditTransaction(uint32_t row) {
+    if (row >= transactions.size() || transactions.IsDeleted(row)) return;
+    char date[11];
+    char amount[24];
+    editingRow = row;
+    editReturnScreen = currentScreen;
+    strcpy(editDateInput, FormatDate(transactions.dates[row], date));
+    selectedCategory = transactions.categoryIds[row];
+    int64_t paise = transactions.amounts[row];
+    FormatAmount(paise < 0 ? -paise : paise, amount);
+    snprintf(amountInput, sizeof(amountInput), "%s", amount);
+    snprintf(descriptionInput, sizeof(descriptionInput), "%s", transactions.descriptions.Get(transactions.descriptionIds[row]));
+    showCategoryDropdown = false;
+    currentScreen = ADD_TRANSACTION;
+}
+
+void EndEditTransaction() {
+    editingRow = -1;
+    amountInput[0] = '\0';
+    descriptionInput[0] = '\0';
+}
+
+// Save Changes, Delete and Cancel in place of the Add screen's buttons.
+void DrawEditButtons() {
+    const Rectangle buttons[] = {{200, 320, 200, 40}, {420, 320, 180, 40}, {620, 320, 180, 40}};
+    const char* labels[] = {"Save Changes", "Delete", "Cancel"};
+    const float labelX[] = {240, 480, 675};
+    const Color colors[] = {DARKGREEN, MAROON, (Color){70, 70, 70, 255}};
+    const Color hoverColors[] = {(Color){34, 139, 34, 255}, RED, (Color){90, 90, 90, 255}};
+    int clicked = -1;
+    for (int i = 0; i < 3; i++) {
+        bool hovered = CheckCollisionPointRec(GetMousePosition(), buttons[i]);
+        DrawRectangleRec(buttons[i], hovered ? hoverColors[i] : colors[i]);
+        DrawUIText(labels[i], (Vector2){labelX[i], 330}, 20, WHITE);
+        if (hovered && IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) clicked = i;
+    }
+    if (clicked < 0) return;
+    
+    uint32_t row = (uint32_t)editingRow;
+    if (clicked == 0) {
+        int packedDate;
+        int64_t paise;
+        if (!ParseDate(editDateInput, strlen(editDateInput), packedDate)) {
+            importStatus = "Please enter the date as YYYY-MM-DD";
+            return;
+        }
+        if (!ParseAmount(amountInput, strlen(amountInput), paise)) {
+            importStatus = "Please enter an amount";
+            return;
+        }
+        double amount = fabs(ToRupees(paise));
+        Transaction changed = {
+            editDateInput,
+            categories[selectedCategory],
+            categories[selectedCategory] != "Income" ? -amount : amount,
+            strlen(descriptionInput) > 0 ? descriptionInput : "No description"
+        };
+        importStatus = UpdateTransaction(row, changed) ? "Transaction updated" : "That transaction no longer exists";
+    } else if (clicked == 1) {
+        importStatus = DeleteTransaction(row) ? "Transaction deleted" : "That transaction no longer exists";
+    }
+    EndEditTransaction();
+    currentScreen = editReturnScreen;
 }
 
 void DrawMonthlySummary() {
-    DrawTextEx(customFont, TextFormat("Monthly Summary - %s %d", GetMonthName(currentMonth).c_str(), currentYear), 
-               (Vector2){20, 80}, 28, 1, (Color){50, 50, 50, 255});
+    if (!ledgerReady) {
+        DrawUIText(TextFormat("Monthly Summary - %s %d", GetMonthName(currentMonth).c_str(), currentYear), 
+                   (Vector2){20, 80}, 28, (Color){50, 50, 50, 255});
+        DrawLoadingProgress(140);
+        return;
+    }
+    PROFILE_PHASES("Summary layout");
     
     Rectangle prevMonth = {20, 130, 30, 30};
     Rectangle nextMonth = {220, 130, 30, 30};
     
-    DrawRectangleRec(prevMonth, (Color){200, 200, 200, 255});
-    DrawTextEx(customFont, "<", (Vector2){30, 135}, 18, 1, BLACK);
-    
-    DrawTextEx(customFont, TextFormat("%s %d", GetMonthName(currentMonth).c_str(), currentYear), 
-               (Vector2){60, 135}, 18, 1, BLACK);
-    
-    DrawRectangleRec(nextMonth, (Color){200, 200, 200, 255});
-    DrawTextEx(customFont, ">", (Vector2){230, 135}, 18, 1, BLACK);
-    
     if (CheckCollisionPointRec(GetMousePosition(), prevMonth) && IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
         currentMonth--;
         if (currentMonth < 0) {
@@ -532,42 +1033,63 @@ void DrawMonthlySummary() {
         }
     }
     
-    std::vector<Transaction> monthTransactions = GetTransactionsForMonth(currentMonth, currentYear);
-    float totalIncome = GetTotalIncome(monthTransactions);
-    float totalExpense = GetTotalExpense(monthTransactions);
-    float balance = totalIncome - totalExpense;
+    // The pie and breakdown only change with the ledger or the month.
+    PROFILE_NEXT_PHASE("Summary draw");
+    if (!BeginPanel(summaryPanel, bodyBounds, MixKey(ledgerVersion, currentYear * 12 + currentMonth), RAYWHITE)) {
+        DrawPanel(summaryPanel, bodyBounds);
+        return;
+    }
+    
+    DrawUIText(TextFormat("Monthly Summary - %s %d", GetMonthName(currentMonth).c_str(), currentYear), 
+               (Vector2){20, 80}, 28, (Color){50, 50, 50, 255});
+    
+    DrawRectangleRec(prevMonth, (Color){200, 200, 200, 255});
+    DrawUIText("<", (Vector2){30, 135}, 18, BLACK);
+    
+    DrawUIText(TextFormat("%s %d", GetMonthName(currentMonth).c_str(), currentYear), 
+               (Vector2){60, 135}, 18, BLACK);
+    
+    DrawRectangleRec(nextMonth, (Color){200, 200, 200, 255});
+    DrawUIText(">", (Vector2){230, 135}, 18, BLACK);
     
-    DrawTextEx(customFont, "Income:", (Vector2){20, 180}, 18, 1, (Color){50, 50, 50, 255});
-    DrawTextEx(customFont, TextFormat("Rs.%.2f", totalIncome), (Vector2){200, 180}, 18, 1, DARKGREEN);
+    PROFILE_NEXT_PHASE("Summary query");
+    const MonthSummary& summary = GetMonthSummary(currentMonth, currentYear);
+    double totalIncome = ToRupees(summary.income);
+    double totalExpense = ToRupees(summary.expense);
+    double balance = totalIncome - totalExpense;
+    PROFILE_NEXT_PHASE("Summary draw");
     
-    DrawTextEx(customFont, "Expenses:", (Vector2){20, 210}, 18, 1, (Color){50, 50, 50, 255});
-    DrawTextEx(customFont, TextFormat("Rs.%.2f", totalExpense), (Vector2){200, 210}, 18, 1, MAROON);
+    DrawUIText("Income:", (Vector2){20, 180}, 18, (Color){50, 50, 50, 255});
+    DrawUIText(TextFormat("Rs.%.2f", totalIncome), (Vector2){200, 180}, 18, DARKGREEN);
     
-    DrawTextEx(customFont, "Balance:", (Vector2){20, 240}, 18, 1, (Color){50, 50, 50, 255});
-    DrawTextEx(customFont, TextFormat("Rs.%.2f", balance), (Vector2){200, 240}, 18, 1, 
+    DrawUIText("Expenses:", (Vector2){20, 210}, 18, (Color){50, 50, 50, 255});
+    DrawUIText(TextFormat("Rs.%.2f", totalExpense), (Vector2){200, 210}, 18, MAROON);
+    
+    DrawUIText("Balance:", (Vector2){20, 240}, 18, (Color){50, 50, 50, 255});
+    DrawUIText(TextFormat("Rs.%.2f", balance), (Vector2){200, 240}, 18, 
                balance >= 0 ? DARKGREEN : MAROON);
     
-    DrawTextEx(customFont, "Expense Breakdown:", (Vector2){20, 280}, 18, 1, (Color){50, 50, 50, 255});
+    DrawUIText("Expense Breakdown:", (Vector2){20, 280}, 18, (Color){50, 50, 50, 255});
     
-    std::map<std::string, float> categorySummary = GetCategorySummary(monthTransactions);
     int y = 310;
     
-    for (const auto& category : categories) {
+    for (size_t i = 0; i < categories.size(); i++) {
+        const std::string& category = categories[i];
         if (category == "Income") continue;
         
-        if (categorySummary.find(category) != categorySummary.end() && categorySummary[category] > 0) {
-            DrawRectangle(20, y, 15, 15, categoryColors[category]);
-            DrawTextEx(customFont, category.c_str(), (Vector2){45, y}, 18, 1, (Color){50, 50, 50, 255});
-            DrawTextEx(customFont, TextFormat("Rs.%.2f", categorySummary[category]), (Vector2){200, y}, 18, 1, (Color){50, 50, 50, 255});
+        if (summary.categoryExpense[i] > 0) {
+            DrawRectangle(20, y, 15, 15, GetCategoryColor(category));
+            DrawUIText(category.c_str(), (Vector2){45, y}, 18, (Color){50, 50, 50, 255});
+            DrawUIText(TextFormat("Rs.%.2f", ToRupees(summary.categoryExpense[i])), (Vector2){200, y}, 18, (Color){50, 50, 50, 255});
             
-            float percentage = (categorySummary[category] / totalExpense) * 100.0f;
-            DrawTextEx(customFont, TextFormat("%.1f%%", percentage), (Vector2){300, y}, 18, 1, (Color){50, 50, 50, 255});
+            float percentage = (float)summary.categoryExpense[i] / summary.expense * 100.0f;
+            DrawUIText(TextFormat("%.1f%%", percentage), (Vector2){300, y}, 18, (Color){50, 50, 50, 255});
             
             y += 30;
         }
     }
     
-    DrawTextEx(customFont, "Expense Distribution", (Vector2){600, 180}, 24, 1, (Color){50, 50, 50, 255});
+    DrawUIText("Expense Distribution", (Vector2){600, 180}, 24, (Color){50, 50, 50, 255});
     
     int centerX = 700;
     int centerY = 350;
@@ -576,11 +1098,12 @@ void DrawMonthlySummary() {
     if (totalExpense > 0) {
         float startAngle = 0.0f;
         
-        for (const auto& category : categories) {
+        for (size_t i = 0; i < categories.size(); i++) {
+            const std::string& category = categories[i];
             if (category == "Income") continue;
             
-            if (categorySummary.find(category) != categorySummary.end() && categorySummary[category] > 0) {
-                float percentage = categorySummary[category] / totalExpense;
+            if (summary.categoryExpense[i] > 0) {
+                float percentage = (float)summary.categoryExpense[i] / summary.expense;
                 float endAngle = startAngle + percentage * 2.0f * pi;
                 
                 DrawCircleSector(Vector2{(float)centerX, (float)centerY}, 
@@ -588,15 +1111,15 @@ void DrawMonthlySummary() {
                                 startAngle * RAD2DEG, 
                                 endAngle * RAD2DEG, 
                                 32, 
-                                categoryColors[category]);
+                                GetCategoryColor(category));
                 
                 if (percentage > 0.05f) {
                     float labelAngle = startAngle + (endAngle - startAngle) / 2.0f;
                     int labelX = centerX + (radius * 0.7f) * cos(labelAngle);
                     int labelY = centerY + (radius * 0.7f) * sin(labelAngle);
                     
-                    DrawTextEx(customFont, TextFormat("%.1f%%", percentage * 100.0f), 
-                               (Vector2){labelX - 20, labelY}, 18, 1, WHITE);
+                    DrawUIText(TextFormat("%.1f%%", percentage * 100.0f), 
+                               (Vector2){labelX - 20, labelY}, 18, WHITE);
                 }
                 
                 startAngle = endAngle;
@@ -604,7 +1127,660 @@ void DrawMonthlySummary() {
         }
     } else {
         DrawCircleLines(centerX, centerY, radius, (Color){200, 200, 200, 255});
-        DrawTextEx(customFont, "No expenses for this month", (Vector2){centerX - 120, centerY - 10}, 
-                   18, 1, GRAY);
+        DrawUIText("No expenses for this month", (Vector2){centerX - 120, centerY - 10}, 
+                   18, GRAY);
+    }
+    
+    EndPanel();
+    DrawPanel(summaryPanel, bodyBounds);
+}
+
+// Edits a yyyy-mm-dd box; returns true when the text changed.
+bool EditDateInput(char* input, bool focused) {
+    if (!focused) return false;
+    bool edited = false;
+    int key = GetCharPressed();
+    while (key > 0) {
+        int len = strlen(input);
+        if (len < 10 && ((key >= '0' && key <= '9') || key == '-')) {
+            input[len] = (char)key;
+            input[len + 1] = '\0';
+            edited = true;
+        }
+        key = GetCharPressed();
+    }
+    if (IsKeyPressed(KEY_BACKSPACE) && strlen(input) > 0) {
+        input[strlen(input) - 1] = '\0';
+        edited = true;
+    }
+    return edited;
+}
+
+void DrawRangeSummary() {
+    if (!ledgerReady) {
+        DrawUIText("Range Summary", (Vector2){20, 80}, 28, (Color){50, 50, 50, 255});
+        DrawLoadingProgress(140);
+        return;
+    }
+    PROFILE_PHASES("Ranges layout");
+    
+    time_t now = time(0);
+    struct tm* ltm = localtime(&now);
+    int year = 1900 + ltm->tm_year;
+    int month = 1 + ltm->tm_mon;
+    int today = PackDate(year, month, ltm->tm_mday);
+    
+    int hoveredPreset = -1;
+    for (int i = 0; i < 5; i++) {
+        Rectangle button = {20.0f + i * 160, 130, 150, 34};
+        if (!CheckCollisionPointRec(GetMousePosition(), button)) continue;
+        hoveredPreset = i;
+        if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) rangePreset = i;
+    }
+    
+    int firstDate = 0;
+    int lastDate = today;
+    if (rangePreset == 0) {
+        firstDate = PackDate(year, month, 1);
+    } else if (rangePreset == 1) {
+        firstDate = PackDate(year, 1, 1);
+    } else if (rangePreset == 2) {
+        int firstMonth = year * 12 + month - 1 - 11; // this month and the eleven before it
+        firstDate = PackDate(firstMonth / 12, firstMonth % 12 + 1, 1);
+    } else if (rangePreset == 3) {
+        lastDate = 99991231;
+    }
+    
+    // The boxes show the preset's range; typing in either makes it a custom range.
+    Rectangle fromBox = {80, 180, 150, 30};
+    Rectangle toBox = {290, 180, 150, 30};
+    static bool fromFocused = false;
+    static bool toFocused = false;
+    if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
+        fromFocused = CheckCollisionPointRec(GetMousePosition(), fromBox);
+        toFocused = CheckCollisionPointRec(GetMousePosition(), toBox);
+    }
+    if (rangePreset != 4) {
+        char date[11];
+        strcpy(rangeFromInput, firstDate > 0 ? FormatDate(firstDate, date) : "");
+        strcpy(rangeToInput, lastDate < 99991231 ? FormatDate(lastDate, date) : "");
+    }
+    if (EditDateInput(rangeFromInput, fromFocused) || EditDateInput(rangeToInput, toFocused)) rangePreset = 4;
+    
+    bool valid = true;
+    if (rangePreset == 4) {
+        firstDate = 0;
+        lastDate = 99991231;
+        if (rangeFromInput[0] != '\0') valid = ParseDate(rangeFromInput, strlen(rangeFromInput), firstDate);
+        if (rangeToInput[0] != '\0') valid = valid && ParseDate(rangeToInput, strlen(rangeToInput), lastDate);
+    }
+    
+    uint64_t key = MixKey(ledgerVersion, today);
+    key = MixKey(key, HashBytes(rangeFromInput, strlen(rangeFromInput)));
+    key = MixKey(key, HashBytes(rangeToInput, strlen(rangeToInput)));
+    key = MixKey(key, (rangePreset << 8) | ((hoveredPreset + 1) << 2) | (fromFocused << 1) | toFocused);
+    PROFILE_NEXT_PHASE("Ranges draw");
+    if (!BeginPanel(rangePanel, bodyBounds, key, RAYWHITE)) {
+        DrawPanel(rangePanel, bodyBounds);
+        return;
+    }
+    
+    DrawUIText("Range Summary", (Vector2){20, 80}, 28, (Color){50, 50, 50, 255});
+    const char* presetNames[] = {"This month", "Year to date", "Last 12 months", "All time", "Custom"};
+    for (int i = 0; i < 5; i++) {
+        Rectangle button = {20.0f + i * 160, 130, 150, 34};
+        DrawRectangleRec(button, i == rangePreset ? DARKGRAY : i == hoveredPreset ? (Color){180, 180, 180, 255} : (Color){200, 200, 200, 255});
+        DrawUIText(presetNames[i], (Vector2){30.0f + i * 160, 138}, 18, i == rangePreset ? WHITE : BLACK);
+    }
+    
+    DrawUIText("From:", (Vector2){20, 185}, 18, (Color){50, 50, 50, 255});
+    DrawRectangleRec(fromBox, fromFocused ? (Color){220, 220, 220, 255} : (Color){200, 200, 200, 255});
+    DrawUIText(rangeFromInput[0] ? rangeFromInput : "start", (Vector2){88, 185}, 18, rangeFromInput[0] ? BLACK : GRAY);
+    DrawUIText("To:", (Vector2){250, 185}, 18, (Color){50, 50, 50, 255});
+    DrawRectangleRec(toBox, toFocused ? (Color){220, 220, 220, 255} : (Color){200, 200, 200, 255});
+    DrawUIText(rangeToInput[0] ? rangeToInput : "end", (Vector2){298, 185}, 18, rangeToInput[0] ? BLACK : GRAY);
+    if (!valid) {
+        DrawUIText("Enter dates as YYYY-MM-DD", (Vector2){460, 185}, 18, MAROON);
+    }
+    
+    // Both ranges come from the day rollups, so years of history cost the
+    // same as a single day.
+    static MonthSummary summary;
+    static MonthSummary previous;
+    PROFILE_NEXT_PHASE("Ranges query");
+    bool compare = valid && firstDate > 0 && lastDate < 99991231;
+    if (valid) GetRangeSummary(firstDate, lastDate, summary);
+    if (compare) GetRangeSummary(firstDate - 10000, lastDate - 10000, previous);
+    PROFILE_NEXT_PHASE("Ranges draw");
+    if (valid) DrawRangeTotals(summary, previous, compare);
+    
+    EndPanel();
+    DrawPanel(rangePanel, bodyBounds);
+}
+
+void DrawRangeTotals(const MonthSummary& summary, const MonthSummary& previous, bool compare) {
+    DrawUIText("This range", (Vector2){200, 230}, 18, (Color){50, 50, 50, 255});
+    if (compare) {
+        DrawUIText("Year before", (Vector2){400, 230}, 18, (Color){50, 50, 50, 255});
+        DrawUIText("Change", (Vector2){600, 230}, 18, (Color){50, 50, 50, 255});
+    }
+    DrawLine(20, 255, screenWidth - 20, 255, (Color){200, 200, 200, 255});
+    
+    const char* rowNames[] = {"Income:", "Expenses:", "Balance:"};
+    int64_t values[] = {summary.income, summary.expense, summary.income - summary.expense};
+    int64_t previousValues[] = {previous.income, previous.expense, previous.income - previous.expense};
+    for (int i = 0; i < 3; i++) {
+        float y = 265.0f + i * 30;
+        Color color = i == 0 ? DARKGREEN : i == 1 ? MAROON : values[2] >= 0 ? DARKGREEN : MAROON;
+        DrawUIText(rowNames[i], (Vector2){20, y}, 18, (Color){50, 50, 50, 255});
+        DrawUIText(TextFormat("Rs.%.2f", ToRupees(values[i])), (Vector2){200, y}, 18, color);
+        if (!compare) continue;
+        DrawUIText(TextFormat("Rs.%.2f", ToRupees(previousValues[i])), (Vector2){400, y}, 18, GRAY);
+        if (previousValues[i] != 0) {
+            double change = (double)(values[i] - previousValues[i]) / llabs(previousValues[i]) * 100.0;
+            DrawUIText(TextFormat("%+.1f%%", change), (Vector2){600, y}, 18, (Color){50, 50, 50, 255});
+        }
+    }
+    
+    DrawUIText("Expense Breakdown:", (Vector2){20, 365}, 18, (Color){50, 50, 50, 255});
+    
+    int64_t largest = 1;
+    for (size_t i = 0; i < categories.size(); i++) {
+        largest = std::max(largest, std::max(summary.categoryExpense[i], compare ? previous.categoryExpense[i] : 0));
+    }
+    
+    int y = 395;
+    for (size_t i = 0; i < categories.size() && y < screenHeight - 20; i++) {
+        const std::string& category = categories[i];
+        if (category == "Income") continue;
+        int64_t expense = summary.categoryExpense[i];
+        int64_t before = compare ? previous.categoryExpense[i] : 0;
+        if (expense == 0 && before == 0) continue;
+        
+        DrawRectangle(20, y, 15, 15, GetCategoryColor(category));
+        DrawUIText(category.c_str(), (Vector2){45, y}, 18, (Color){50, 50, 50, 255});
+        DrawUIText(TextFormat("Rs.%.2f", ToRupees(expense)), (Vector2){200, y}, 18, (Color){50, 50, 50, 255});
+        if (compare) {
+            DrawUIText(TextFormat("Rs.%.2f", ToRupees(before)), (Vector2){400, y}, 18, GRAY);
+        }
+        
+        // This range as a bar, the year before as a thin line beneath it.
+        DrawRectangle(760, y, (int)(420 * expense / largest), 12, GetCategoryColor(category));
+        if (compare) DrawRectangle(760, y + 14, (int)(420 * before / largest), 3, GRAY);
+        
+        y += 26;
+    }
+}
+
+// Every row of the ledger, sorted by any column. Only the visible rows are
+// read, as one window of the column's maintained order (table.h), so
+// scrolling and re-sorting cost the same at any ledger size.
+void DrawLedgerTable() {
+    if (!ledgerReady) {
+        DrawUIText("Ledger", (Vector2){20, 80}, 28, (Color){50, 50, 50, 255});
+        DrawLoadingProgress(140);
+        return;
+    }
+    PROFILE_PHASES("Ledger layout");
+    
+    const int tableTop = 165;
+    const int rowHeight = 24;
+    const size_t visibleRows = (screenHeight - 15 - tableTop) / rowHeight;
+    size_t rowCount = GetLiveRowCount();
+    size_t lastFirstRow = rowCount > visibleRows ? rowCount - visibleRows : 0;
+    
+    // Clicking a column header sorts by it; clicking it again reverses it.
+    const char* columnNames[] = {"Date", "Category", "Amount", "Description"};
+    const float columnX[] = {30, 200, 400, 600};
+    int hoveredColumn = -1;
+    for (int i = 0; i < 4; i++) {
+        Rectangle header = {columnX[i] - 10, 128, i < 3 ? columnX[i + 1] - columnX[i] : screenWidth - 650.0f, 30};
+        if (!CheckCollisionPointRec(GetMousePosition(), header)) continue;
+        hoveredColumn = i;
+        if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
+            if (tableSort == i) {
+                tableDescending = !tableDescending;
+            } else {
+                tableSort = (TableColumn)i;
+                tableDescending = i == COLUMN_DATE || i == COLUMN_AMOUNT; // newest and largest first
+            }
+            tableFirstRow = 0;
+        }
+    }
+    
+    // Wheel, keys or the scrollbar thumb move the window.
+    Rectangle track = {screenWidth - 32, (float)tableTop, 12, (float)(visibleRows * rowHeight)};
+    float thumbHeight = rowCount > visibleRows ? std::max(24.0f, track.height * visibleRows / rowCount) : track.height;
+    static bool draggingThumb = false;
+    double first = (double)tableFirstRow - GetMouseWheelMove() * 3;
+    if (IsKeyPressed(KEY_DOWN)) first += 1;
+    if (IsKeyPressed(KEY_UP)) first -= 1;
+    if (IsKeyPressed(KEY_PAGE_DOWN)) first += visibleRows;
+    if (IsKeyPressed(KEY_PAGE_UP)) first -= visibleRows;
+    if (IsKeyPressed(KEY_HOME)) first = 0;
+    if (IsKeyPressed(KEY_END)) first = (double)lastFirstRow;
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(GetMousePosition(), track)) draggingThumb = true;
+    if (!IsMouseButtonDown(MOUSE_LEFT_BUTTON)) draggingThumb = false;
+    if (draggingThumb && track.height > thumbHeight) {
+        first = (GetMousePosition().y - track.y - thumbHeight / 2) / (track.height - thumbHeight) * lastFirstRow;
+    }
+    tableFirstRow = (size_t)std::min(std::max(first, 0.0), (double)lastFirstRow);
+    
+    // Clicking a row, as drawn last time, opens it for editing.
+    Rectangle rowArea = {20, (float)tableTop, track.x - 20, (float)(tableRows.size() * rowHeight)};
+    if (!draggingThumb && CheckCollisionPointRec(GetMousePosition(), rowArea) && IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
+        BeginEditTransaction(tableRows[(size_t)((GetMousePosition().y - rowArea.y) / rowHeight)]);
+        return;
+    }
+    
+    uint64_t key = MixKey(ledgerVersion, tableFirstRow);
+    key = MixKey(key, (tableSort << 8) | ((hoveredColumn + 1) << 2) | (tableDescending << 1) | draggingThumb);
+    PROFILE_NEXT_PHASE("Ledger draw");
+    if (!BeginPanel(ledgerPanel, bodyBounds, key, RAYWHITE)) {
+        DrawPanel(ledgerPanel, bodyBounds);
+        return;
     }
-}
\ No newline at end of file
+    
+    DrawUIText("Ledger", (Vector2){20, 80}, 28, (Color){50, 50, 50, 255});
+    if (rowCount > 0) {
+        DrawUIText(TextFormat("Rows %zu-%zu of %zu", tableFirstRow + 1, std::min(rowCount, tableFirstRow + visibleRows), rowCount),
+                   (Vector2){screenWidth - 300, 88}, 18, GRAY);
+    }
+    
+    for (int i = 0; i < 4; i++) {
+        const char* name = i == tableSort ? TextFormat("%s %s", columnNames[i], tableDescending ? "v" : "^") : columnNames[i];
+        DrawUIText(name, (Vector2){columnX[i], 133}, 18, i == hoveredColumn ? BLACK : (Color){50, 50, 50, 255});
+    }
+    DrawLine(20, 160, screenWidth - 40, 160, (Color){200, 200, 200, 255});
+    
+    PROFILE_NEXT_PHASE("Ledger query");
+    GetTableRows(tableSort, tableDescending, tableFirstRow, visibleRows, tableRows);
+    PROFILE_NEXT_PHASE("Ledger draw");
+    int y = tableTop;
+    for (size_t i = 0; i < tableRows.size(); i++) {
+        uint32_t row = tableRows[i];
+        int64_t amount = transactions.amounts[row];
+        char date[11];
+        
+        if ((tableFirstRow + i) % 2 == 1) DrawRectangle(20, y, screenWidth - 60, rowHeight, (Color){240, 240, 240, 255});
+        DrawUIText(FormatDate(transactions.dates[row], date), (Vector2){30, y + 4.0f}, 16, (Color){50, 50, 50, 255});
+        DrawUIText(categories[transactions.categoryIds[row]].c_str(), (Vector2){200, y + 4.0f}, 16, (Color){50, 50, 50, 255});
+        Color amountColor = amount >= 0 ? DARKGREEN : MAROON;
+        DrawUIText(TextFormat("Rs.%.2f", fabs(ToRupees(amount))), (Vector2){400, y + 4.0f}, 16, amountColor);
+        DrawUIText(transactions.descriptions.Get(transactions.descriptionIds[row]), (Vector2){600, y + 4.0f}, 16, (Color){50, 50, 50, 255});
+        y += rowHeight;
+    }
+    
+    DrawRectangleRec(track, (Color){220, 220, 220, 255});
+    float thumbY = track.y + (lastFirstRow > 0 ? (track.height - thumbHeight) * tableFirstRow / lastFirstRow : 0);
+    DrawRectangle((int)track.x, (int)thumbY, (int)track.width, (int)thumbHeight, draggingThumb ? DARKGRAY : GRAY);
+    
+    EndPanel();
+    DrawPanel(ledgerPanel, bodyBounds);
+}
+
+// Income, expense, balance and any category's expense over the whole
+// history, from the trend pyramid (trend.h). The wheel zooms around the
+// pointer and dragging pans; the bucket size follows the zoom unless one
+// is picked. Each series is at most two points per pixel, so the cost of a
+// frame does not grow with the years of history.
+void DrawTrendChart() {
+    if (!ledgerReady) {
+        DrawUIText("Trends", (Vector2){20, 80}, 28, (Color){50, 50, 50, 255});
+        DrawLoadingProgress(140);
+        return;
+    }
+    PROFILE_PHASES("Trends layout");
+    UpdateTrendPyramid();
+    const Rectangle plot = {100, 195, screenWidth - 130, 360};
+    int dataFirstDay = 0;
+    int dataLastDay = 0;
+    bool hasData = GetTrendExtent(dataFirstDay, dataLastDay);
+    
+    // Bucket size and series buttons above the plot, a chip per category below it.
+    const char* levelNames[] = {"Auto", "Day", "Week", "Month", "Year"};
+    const char* seriesNames[] = {"Income", "Expense", "Balance"};
+    auto levelButton = [](int i) { return (Rectangle){20.0f + i * 90, 130, 80, 30}; };
+    auto seriesButton = [](int i) { return (Rectangle){500.0f + i * 110, 130, 100, 30}; };
+    auto chipButton = [](int i) { return (Rectangle){20.0f + (i % 10) * 116, 600.0f + (i / 10) * 40, 106, 30}; };
+    const Rectangle wholeButton = {screenWidth - 160, 130, 130, 30};
+    std::vector<int> chipCategories;
+    for (size_t i = 0; i < categories.size() && chipCategories.size() < 20 && TREND_CATEGORY + i < 64; i++) {
+        if (categories[i] != "Income") chipCategories.push_back((int)i);
+    }
+    Vector2 mouse = GetMousePosition();
+    bool clicked = IsMouseButtonReleased(MOUSE_LEFT_BUTTON);
+    int hoveredButton = -1;
+    for (int i = 0; i < 5; i++) {
+        if (!CheckCollisionPointRec(mouse, levelButton(i))) continue;
+        hoveredButton = i;
+        if (clicked) trendLevel = i - 1;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (!CheckCollisionPointRec(mouse, seriesButton(i))) continue;
+        hoveredButton = 5 + i;
+        if (clicked) trendSeriesShown ^= 1ull << i;
+    }
+    for (size_t i = 0; i < chipCategories.size(); i++) {
+        if (!CheckCollisionPointRec(mouse, chipButton((int)i))) continue;
+        hoveredButton = 8 + (int)i;
+        if (clicked) trendSeriesShown ^= 1ull << (TREND_CATEGORY + chipCategories[i]);
+    }
+    if (CheckCollisionPointRec(mouse, wholeButton)) {
+        hoveredButton = 100;
+        if (clicked) trendLastDay = trendFirstDay; // refit below
+    }
+    
+    bool overPlot = hasData && CheckCollisionPointRec(mouse, plot);
+    static bool dragging = false;
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) dragging = overPlot;
+    if (!IsMouseButtonDown(MOUSE_LEFT_BUTTON)) dragging = false;
+    if (hasData) {
+        double dataSpan = dataLastDay + 1.0 - dataFirstDay;
+        if (trendLastDay <= trendFirstDay || IsKeyPressed(KEY_HOME)) {
+            trendFirstDay = dataFirstDay;
+            trendLastDay = dataLastDay + 1.0;
+        }
+        double span = std::min(trendLastDay - trendFirstDay, dataSpan);
+        float wheel = GetMouseWheelMove();
+        if (overPlot && wheel != 0) {
+            double pointerDay = trendFirstDay + (mouse.x - plot.x) / plot.width * span;
+            double zoomed = std::min(std::max(span * pow(0.8, wheel), std::min(14.0, dataSpan)), dataSpan);
+            trendFirstDay = pointerDay - (pointerDay - trendFirstDay) * zoomed / span;
+            span = zoomed;
+        }
+        if (dragging) trendFirstDay -= GetMouseDelta().x / plot.width * span;
+        trendFirstDay = std::min(std::max(trendFirstDay, (double)dataFirstDay), dataLastDay + 1.0 - span);
+        trendLastDay = trendFirstDay + span;
+    }
+    int firstDay = (int)floor(trendFirstDay);
+    int lastDay = (int)ceil(trendLastDay);
+    TrendLevel level = trendLevel >= 0 ? (TrendLevel)trendLevel : PickTrendLevel(firstDay, lastDay, (int)plot.width);
+    
+    uint64_t viewBits[2];
+    memcpy(viewBits, &trendFirstDay, sizeof(double));
+    memcpy(viewBits + 1, &trendLastDay, sizeof(double));
+    uint64_t key = MixKey(MixKey(MixKey(ledgerVersion, viewBits[0]), viewBits[1]), trendSeriesShown);
+    key = MixKey(key, ((uint64_t)(overPlot ? (int)mouse.x + 1 : 0) << 24) | ((trendLevel + 1) << 16) | (hoveredButton + 1));
+    PROFILE_NEXT_PHASE("Trends draw");
+    if (!BeginPanel(trendPanel, bodyBounds, key, RAYWHITE)) {
+        DrawPanel(trendPanel, bodyBounds);
+        return;
+    }
+    
+    DrawUIText("Trends", (Vector2){20, 80}, 28, (Color){50, 50, 50, 255});
+    for (int i = 0; i < 5; i++) {
+        bool selected = trendLevel == i - 1;
+        Rectangle button = levelButton(i);
+        DrawRectangleRec(button, selected ? DARKGRAY : i == hoveredButton ? (Color){180, 180, 180, 255} : (Color){200, 200, 200, 255});
+        DrawUIText(levelNames[i], (Vector2){button.x + 10, button.y + 6}, 18, selected ? WHITE : BLACK);
+    }
+    const Color seriesColors[] = {DARKGREEN, MAROON, DARKBLUE};
+    for (int i = 0; i < 3; i++) {
+        bool shown = (trendSeriesShown >> i) & 1;
+        Rectangle button = seriesButton(i);
+        DrawRectangleRec(button, shown ? seriesColors[i] : 5 + i == hoveredButton ? (Color){180, 180, 180, 255} : (Color){200, 200, 200, 255});
+        DrawUIText(seriesNames[i], (Vector2){button.x + 10, button.y + 6}, 18, shown ? WHITE : BLACK);
+    }
+    DrawRectangleRec(wholeButton, hoveredButton == 100 ? (Color){180, 180, 180, 255} : (Color){200, 200, 200, 255});
+    DrawUIText("Whole history", (Vector2){wholeButton.x + 10, wholeButton.y + 6}, 18, BLACK);
+    for (size_t i = 0; i < chipCategories.size(); i++) {
+        int series = TREND_CATEGORY + chipCategories[i];
+        bool shown = (trendSeriesShown >> series) & 1;
+        Rectangle chip = chipButton((int)i);
+        Color color = GetCategoryColor(categories[chipCategories[i]]);
+        DrawRectangleRec(chip, shown ? color : 8 + (int)i == hoveredButton ? (Color){180, 180, 180, 255} : (Color){220, 220, 220, 255});
+        DrawRectangle((int)chip.x + 6, (int)chip.y + 9, 12, 12, color);
+        DrawUIText(categories[chipCategories[i]].c_str(), (Vector2){chip.x + 24, chip.y + 7}, 16, shown ? WHITE : BLACK);
+    }
+    if (!hasData) {
+        DrawUIText("No dated transactions yet", (Vector2){plot.x, plot.y}, 20, GRAY);
+        EndPanel();
+        DrawPanel(trendPanel, bodyBounds);
+        return;
+    }
+    
+    PROFILE_NEXT_PHASE("Trends query");
+    static std::vector<std::vector<TrendPoint>> seriesPoints(64);
+    double low = 0;
+    double high = 0;
+    for (int series = 0; series < 64; series++) {
+        seriesPoints[series].clear();
+        if (!((trendSeriesShown >> series) & 1)) continue;
+        GetTrendPoints(level, series, firstDay, lastDay, (size_t)plot.width * 2, seriesPoints[series]);
+        for (const TrendPoint& point : seriesPoints[series]) {
+            low = std::min(low, (double)point.value);
+            high = std::max(high, (double)point.value);
+        }
+    }
+    if (high - low < 100) high = low + 100;
+    double padding = (high - low) * 0.05;
+    high += padding;
+    if (low < 0) low -= padding;
+    
+    PROFILE_NEXT_PHASE("Trends draw");
+    DrawTrendAxes(plot, trendFirstDay, trendLastDay, low, high);
+    double span = trendLastDay - trendFirstDay;
+    auto project = [&](const TrendPoint& point) {
+        return (Vector2){(float)(plot.x + (point.day - trendFirstDay) / span * plot.width),
+                         (float)(plot.y + plot.height - (point.value - low) / (high - low) * plot.height)};
+    };
+    float right = plot.x + plot.width;
+    for (int series = 0; series < 64; series++) {
+        const std::vector<TrendPoint>& points = seriesPoints[series];
+        Color color = series < TREND_CATEGORY ? seriesColors[series] : GetCategoryColor(categories[series - TREND_CATEGORY]);
+        for (size_t i = 1; i < points.size(); i++) {
+            // Clipped to the plot: the first and last points lie past its edges.
+            Vector2 from = project(points[i - 1]);
+            Vector2 to = project(points[i]);
+            if (to.x < plot.x || from.x > right || to.x <= from.x) continue;
+            if (from.x < plot.x) {
+                from.y += (to.y - from.y) * (plot.x - from.x) / (to.x - from.x);
+                from.x = plot.x;
+            }
+            if (to.x > right) {
+                to.y = from.y + (to.y - from.y) * (right - from.x) / (to.x - from.x);
+                to.x = right;
+            }
+            DrawLineEx(from, to, 2, color);
+        }
+    }
+    
+    // Under the pointer: the bucket it is over and each series' total there.
+    const char* levelUnits[] = {"day", "week", "month", "year"};
+    float textX = plot.x;
+    if (!overPlot) {
+        DrawUIText(TextFormat("Totals per %s", levelUnits[level]), (Vector2){textX, 168}, 18, GRAY);
+    } else {
+        DrawLine((int)mouse.x, (int)plot.y, (int)mouse.x, (int)(plot.y + plot.height), GRAY);
+        double pointerDay = trendFirstDay + (mouse.x - plot.x) / plot.width * span;
+        bool labelled = false;
+        for (int series = 0; series < 64; series++) {
+            const std::vector<TrendPoint>& points = seriesPoints[series];
+            auto after = std::upper_bound(points.begin(), points.end(), pointerDay,
+                                          [](double day, const TrendPoint& point) { return day < point.day; });
+            if (after == points.begin()) continue;
+            const TrendPoint& point = *(after - 1);
+            if (!labelled) {
+                char date[11];
+                int packed = CivilFromDays(point.day);
+                const char* bucket = level == TREND_DAY ? FormatDate(packed, date)
+                                   : level == TREND_WEEK ? TextFormat("Week of %s", FormatDate(packed, date))
+                                   : level == TREND_MONTH ? TextFormat("%s %d", GetMonthName(packed / 100 % 100 - 1).c_str(), packed / 10000)
+                                   : TextFormat("%d", packed / 10000);
+                DrawUIText(bucket, (Vector2){textX, 168}, 18, (Color){50, 50, 50, 255});
+                textX += MeasureUIText(bucket, 18).x + 20;
+                labelled = true;
+            }
+            const char* name = series < TREND_CATEGORY ? seriesNames[series] : categories[series - TREND_CATEGORY].c_str();
+            const char* value = TextFormat("%s Rs.%.2f", name, ToRupees(point.value));
+            Color color = series < TREND_CATEGORY ? seriesColors[series] : GetCategoryColor(categories[series - TREND_CATEGORY]);
+            DrawUIText(value, (Vector2){textX, 168}, 18, color);
+            textX += MeasureUIText(value, 18).x + 16;
+            if (textX > screenWidth - 100) break;
+        }
+    }
+    
+    EndPanel();
+    DrawPanel(trendPanel, bodyBounds);
+}
+
+// Gridlines and labels for the trend plot: amounts on the left in rupees
+// (K, L and Cr for thousands, lakhs and crores), dates along the bottom at
+// the finest step that leaves room for each label.
+void DrawTrendAxes(Rectangle plot, double firstDay, double lastDay, double low, double high) {
+    const Color grid = {225, 225, 225, 255};
+    const Color text = {50, 50, 50, 255};
+    float bottom = plot.y + plot.height;
+    for (int i = 0; i <= 4; i++) {
+        double rupees = (low + (high - low) * i / 4) / 100.0;
+        float y = bottom - plot.height * i / 4;
+        DrawLine((int)plot.x, (int)y, (int)(plot.x + plot.width), (int)y, grid);
+        const char* label = fabs(rupees) >= 1e7 ? TextFormat("%.1fCr", rupees / 1e7)
+                          : fabs(rupees) >= 1e5 ? TextFormat("%.1fL", rupees / 1e5)
+                          : fabs(rupees) >= 1e3 ? TextFormat("%.1fK", rupees / 1e3)
+                          : TextFormat("%.0f", rupees);
+        DrawUIText(label, (Vector2){plot.x - 10 - MeasureUIText(label, 14).x, y - 7}, 14, text);
+    }
+    if (low < 0) {
+        float zero = (float)(bottom + low / (high - low) * plot.height);
+        DrawLine((int)plot.x, (int)zero, (int)(plot.x + plot.width), (int)zero, GRAY);
+    }
+    DrawLine((int)plot.x, (int)bottom, (int)(plot.x + plot.width), (int)bottom, GRAY);
+    
+    double pixelsPerDay = plot.width / (lastDay - firstDay);
+    auto drawTick = [&](int day, const char* label) {
+        float x = (float)(plot.x + (day - firstDay) * pixelsPerDay);
+        if (x < plot.x || x > plot.x + plot.width) return;
+        DrawLine((int)x, (int)plot.y, (int)x, (int)bottom, grid);
+        DrawLine((int)x, (int)bottom, (int)x, (int)bottom + 5, GRAY);
+        DrawUIText(label, (Vector2){x - MeasureUIText(label, 14).x / 2, bottom + 8}, 14, text);
+    };
+    if (pixelsPerDay * 7 >= 80) {
+        // Days, or weeks from Monday (1970-01-05 was one).
+        int step = pixelsPerDay >= 80 ? 1 : 7;
+        int day = (int)ceil(firstDay);
+        if (step == 7) day += ((4 - day) % 7 + 7) % 7;
+        for (; day <= lastDay; day += step) {
+            int packed = CivilFromDays(day);
+            drawTick(day, TextFormat("%d %.3s", packed % 100, GetMonthName(packed / 100 % 100 - 1).c_str()));
+        }
+        return;
+    }
+    const int monthSteps[] = {1, 3, 6, 12, 24, 60, 120};
+    int step = 120;
+    for (int candidate : monthSteps) {
+        if (candidate * 30.44 * pixelsPerDay >= 80) {
+            step = candidate;
+            break;
+        }
+    }
+    int firstDate = CivilFromDays((int)floor(firstDay));
+    int month = (firstDate / 10000 * 12 + firstDate / 100 % 100 - 1 + step - 1) / step * step;
+    for (;; month += step) {
+        int day = DaysFromCivil(month / 12, month % 12 + 1, 1);
+        if (day > lastDay) break;
+        drawTick(day, step >= 12 ? TextFormat("%d", month / 12)
+                                 : TextFormat("%.3s %d", GetMonthName(month % 12).c_str(), month / 12));
+    }
+}
+
+void DrawLoadingProgress(int y) {
+    size_t total = loadProgress.bytesTotal;
+    float progress = total > 0 ? (float)loadProgress.bytesDone / total : 0.0f;
+    const char* status = loadProgress.focusExact ? "Loading ledger... (this month is complete)"
+                                                 : "Loading ledger...";
+    
+    DrawUIText(status, (Vector2){20, y}, 24, (Color){50, 50, 50, 255});
+    DrawRectangle(20, y + 40, 600, 20, (Color){200, 200, 200, 255});
+    DrawRectangle(20, y + 40, (int)(600 * progress), 20, DARKGREEN);
+    DrawUIText(TextFormat("%.0f%%", progress * 100.0f), (Vector2){630, y + 40}, 18, (Color){50, 50, 50, 255});
+}
+
+uint64_t MixKey(uint64_t key, uint64_t value) {
+    return key ^ (value + 0x9e3779b97f4a7c15ULL + (key << 6) + (key >> 2));
+}
+
+// Starts drawing into `panel` if its key changed, in screen coordinates;
+// returns false, with nothing to do but DrawPanel, if it is still current.
+bool BeginPanel(CachedPanel& panel, Rectangle bounds, uint64_t key, Color background) {
+    if (panel.valid && panel.key == key) return false;
+    FlushUIText(); // queued screen text belongs to the backbuffer, not this texture
+    if (panel.target.id == 0) panel.target = LoadRenderTexture((int)bounds.width, (int)bounds.height);
+    panel.key = key;
+    panel.valid = true;
+    
+    Camera2D camera = {};
+    camera.offset = (Vector2){-bounds.x, -bounds.y};
+    camera.zoom = 1.0f;
+    BeginTextureMode(panel.target);
+    ClearBackground(background);
+    BeginMode2D(camera);
+    return true;
+}
+
+void EndPanel() {
+    FlushUIText();
+    EndMode2D();
+    EndTextureMode();
+}
+
+void DrawPanel(const CachedPanel& panel, Rectangle bounds) {
+    // Render textures are stored bottom-up, hence the negative source height.
+    Rectangle source = {0, 0, bounds.width, -bounds.height};
+    FlushUIText(); // text drawn before the panel stays under it
+    DrawTextureRec(panel.target.texture, source, (Vector2){bounds.x, bounds.y}, WHITE);
+}
+
+#ifdef BUDGET_PROFILE
+// Frame times of the last maxProfileFrames frames as percentiles and a
+// histogram, then every scope's totals, largest first.
+void DrawProfilerOverlay() {
+    static std::vector<double> frameTimes;
+    static std::vector<ProfileTotal> totals;
+    GetProfileFrameTimes(frameTimes);
+    GetProfileTotals(totals);
+    
+    Rectangle overlay = {screenWidth - 470, 70, 450, 420};
+    DrawRectangleRec(overlay, (Color){30, 30, 30, 220});
+    float x = overlay.x + 10;
+    float y = overlay.y + 10;
+    
+    const int buckets = 40;
+    const double bucketMs = 0.5; // the last bucket also counts anything slower
+    int counts[buckets] = {};
+    int largest = 1;
+    for (double ms : frameTimes) {
+        int bucket = std::min(buckets - 1, (int)(ms / bucketMs));
+        largest = std::max(largest, ++counts[bucket]);
+    }
+    std::sort(frameTimes.begin(), frameTimes.end());
+    double p50 = frameTimes.empty() ? 0.0 : frameTimes[frameTimes.size() / 2];
+    double p99 = frameTimes.empty() ? 0.0 : frameTimes[std::min(frameTimes.size() - 1, frameTimes.size() * 99 / 100)];
+    DrawUIText(TextFormat("Frame p50 %.2f ms   p99 %.2f ms   (%zu frames)", p50, p99, frameTimes.size()),
+               (Vector2){x, y}, 16, WHITE);
+    y += 24;
+    for (int i = 0; i < buckets; i++) {
+        int height = 60 * counts[i] / largest;
+        DrawRectangle((int)x + i * 10, (int)y + 60 - height, 8, height, i * bucketMs < 16.7 ? SKYBLUE : ORANGE);
+    }
+    DrawUIText("0", (Vector2){x, y + 62}, 14, LIGHTGRAY);
+    DrawUIText(TextFormat("%.0f+ ms", buckets * bucketMs), (Vector2){x + buckets * 10 - 40, y + 62}, 14, LIGHTGRAY);
+    y += 86;
+    
+    std::sort(totals.begin(), totals.end(), [](const ProfileTotal& a, const ProfileTotal& b) { return a.totalMs > b.totalMs; });
+    const char* headings[] = {"Scope (ms)", "calls", "last", "mean", "max"};
+    const float columnX[] = {0, 170, 240, 310, 380};
+    for (int i = 0; i < 5; i++) DrawUIText(headings[i], (Vector2){x + columnX[i], y}, 14, LIGHTGRAY);
+    y += 18;
+    for (const ProfileTotal& total : totals) {
+        if (y > overlay.y + overlay.height - 18) break;
+        DrawUIText(total.name, (Vector2){x, y}, 14, WHITE);
+        DrawUIText(TextFormat("%zu", total.calls), (Vector2){x + columnX[1], y}, 14, WHITE);
+        DrawUIText(TextFormat("%.3f", total.lastMs), (Vector2){x + columnX[2], y}, 14, WHITE);
+        DrawUIText(TextFormat("%.3f", total.totalMs / total.calls), (Vector2){x + columnX[3], y}, 14, WHITE);
+        DrawUIText(TextFormat("%.3f", total.maxMs), (Vector2){x + columnX[4], y}, 14, WHITE);
+        y += 18;
+    }
+}
+#endif
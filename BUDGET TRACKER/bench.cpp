@@ -0,0 +1,1183 @@
+// Ledger benchmark: generates synthetic ledgers and measures the data path
+// without opening a window.
+//
+//   bench                     run the default sizes (10k .. 50M rows)
+//   bench 10000 1000000       run only the given row counts
+//
+// Exits non-zero if a SIMD aggregation kernel or the day rollups disagree
+// with the scalar kernel, a failed journal write is not retried (or a short
+// one lands twice), a snapshot does not load back to the same ledger, a
+// statement import keeps or drops the wrong rows, the rule automaton
+// disagrees with a rule-by-rule scan, applying rules drops lines the loader
+// skips, a search returns rows a full scan would not, a table sort order is
+// out of order, a report's category amounts do not add up to the range's
+// expenses, the budget alerts miss a month over its limit, an edited
+// ledger's indexes, reload or compaction disagree with a scan, rows tailed
+// from the CSV differ from a full reload, a snapshot claims rows the store
+// never held, the trend pyramid's buckets disagree with the rollups, or a
+// date or amount parses wrongly. Each check runs apart from the timing it
+// sits next to and is named in the summary when it fails.
+
+#include "ledger.h"
+#include "kernels.h"
+#include "journal.h"
+#include "snapshot.h"
+#include "import.h"
+#include "rules.h"
+#include "search.h"
+#include "rollup.h"
+#include "table.h"
+#include "profile.h"
+#include "report.h"
+#include "budget.h"
+#include "watch.h"
+#include "trend.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cinttypes>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <csignal>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char* benchPath = "bench_transactions.csv";
+const char* statementPath = "bench_statement.csv";
+const char* benchRulesPath = "bench_rules.txt";
+// Lines GenerateLedger writes that the loader skips; every rewrite of the
+// ledger must keep them.
+const char* benchSkippedLines = "2014-02-30,Food,-1.00,No such day\nCarried forward from the old book\n";
+const size_t benchSkippedCount = 2;
+size_t benchRows = 0; // the run a failed check belongs to; 0 before the first
+std::vector<std::string> failedChecks;
+
+// Records a check that found mismatches; returns the marker for its line.
+const char* NoteMismatches(const char* check, size_t mismatches) {
+    if (mismatches == 0) return "";
+    std::string name = check;
+    if (benchRows > 0) name += " (" + std::to_string(benchRows) + " rows)";
+    failedChecks.push_back(name);
+    return "  MISMATCH";
+}
+
+double Now() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+std::atomic<double> watchSignalTime(0.0); // when the ledger watcher last saw a change
+void RecordWatchSignal() {
+    watchSignalTime = Now();
+}
+
+// A directory where the journal expects its file makes every write fail.
+void SetDirectory(const char* path, bool exists) {
+#ifdef _WIN32
+    if (exists) CreateDirectoryA(path, nullptr);
+    else RemoveDirectoryA(path);
+#else
+    if (exists) mkdir(path, 0755);
+    else rmdir(path);
+#endif
+}
+
+size_t GetPeakRSS() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+// Small deterministic generator so every run sees the same ledger.
+uint64_t rngState = 0x9E3779B97F4A7C15ull;
+uint32_t NextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return (uint32_t)(rngState >> 32);
+}
+
+const char* benchDescriptions[] = {
+    "Groceries", "Rent", "Electricity", "Gas", "Movie night", "Monthly Salary", "Dinner",
+    "Bus pass", "Internet bill", "Pharmacy", "Tuition fee", "Online order", "SIP investment",
+    "Coffee", "Taxi", "Water bill", "Gym membership", "Books", "Clothes", "Doctor visit"
+};
+
+// Reference order for the ledger table, compared straight from the columns.
+bool TableRowLessByScan(TableColumn column, uint32_t a, uint32_t b) {
+    int order = 0;
+    if (column == COLUMN_CATEGORY) {
+        order = categories[transactions.categoryIds[a]].compare(categories[transactions.categoryIds[b]]);
+    } else if (column == COLUMN_AMOUNT) {
+        order = (transactions.amounts[a] > transactions.amounts[b]) - (transactions.amounts[a] < transactions.amounts[b]);
+    } else if (column == COLUMN_DESCRIPTION && transactions.descriptionIds[a] != transactions.descriptionIds[b]) {
+        const char* textA = transactions.descriptions.Get(transactions.descriptionIds[a]);
+        const char* textB = transactions.descriptions.Get(transactions.descriptionIds[b]);
+        size_t i = 0;
+        while (textA[i] != '\0' && tolower((unsigned char)textA[i]) == tolower((unsigned char)textB[i])) i++;
+        order = tolower((unsigned char)textA[i]) - tolower((unsigned char)textB[i]);
+        if (order == 0) order = strcmp(textA, textB);
+    }
+    if (order != 0) return order < 0;
+    int dateA = transactions.dates[a];
+    int dateB = transactions.dates[b];
+    return dateA < dateB || (dateA == dateB && a < b);
+}
+
+// Rows a full scan matches: every term occurs in the description, case
+// ignored. Used to check SearchTransactions.
+size_t CountMatchesByScan(const std::vector<std::string>& terms, const SearchFilter& filter,
+                          std::vector<uint8_t>& matched) {
+    std::vector<int> byDescription(transactions.descriptions.Count(), -1);
+    matched.assign(transactions.size(), 0);
+    size_t count = 0;
+    for (uint32_t row = 0; row < transactions.size(); row++) {
+        if (transactions.IsDeleted(row)) continue;
+        int& match = byDescription[transactions.descriptionIds[row]];
+        if (match < 0) {
+            std::string text = transactions.descriptions.Get(transactions.descriptionIds[row]);
+            for (char& c : text) c = (char)tolower((unsigned char)c);
+            match = 1;
+            for (const std::string& term : terms) {
+                if (text.find(term) == std::string::npos) match = 0;
+            }
+        }
+        int date = transactions.dates[row];
+        if (match && date >= filter.firstDate && date <= filter.lastDate &&
+            (filter.categoryId < 0 || transactions.categoryIds[row] == filter.categoryId)) {
+            matched[row] = 1;
+            count++;
+        }
+    }
+    return count;
+}
+
+// Every table order must visit each live row once, in order.
+size_t CountTableOrderMismatches() {
+    size_t mismatches = 0;
+    std::vector<uint32_t> window;
+    std::vector<uint8_t> visitedRows;
+    for (int column = COLUMN_DATE; column <= COLUMN_DESCRIPTION; column++) {
+        visitedRows.assign(transactions.size(), 0);
+        size_t visited = 0;
+        uint32_t previous = 0;
+        for (size_t skip = 0; skip < transactions.size(); skip += 4096) {
+            GetTableRows((TableColumn)column, false, skip, 4096, window);
+            for (uint32_t row : window) {
+                if (visitedRows[row]++ || transactions.IsDeleted(row) ||
+                    (visited > 0 && !TableRowLessByScan((TableColumn)column, previous, row))) {
+                    mismatches++;
+                }
+                previous = row;
+                visited++;
+            }
+        }
+        if (visited != GetLiveRowCount()) mismatches++;
+    }
+    return mismatches;
+}
+
+// Writes `rows` transactions spread evenly over 2005-01..2024-12 in date
+// order, the way an append-only ledger grows, with benchSkippedLines
+// halfway through.
+size_t GenerateLedger(const char* path, size_t rows) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return 0;
+    fputs("Date,Category,Amount,Description\n", file);
+
+    const int firstYear = 2005;
+    const int months = 20 * 12;
+    const size_t descriptionCount = sizeof(benchDescriptions) / sizeof(benchDescriptions[0]);
+    size_t bytes = 0;
+    char line[256];
+
+    for (size_t i = 0; i < rows; i++) {
+        if (i == rows / 2) {
+            fputs(benchSkippedLines, file);
+            bytes += strlen(benchSkippedLines);
+        }
+        int monthIndex = (int)((i * months) / rows);
+        int year = firstYear + monthIndex / 12;
+        int month = 1 + monthIndex % 12;
+        int day = 1 + NextRandom() % 28;
+
+        size_t category = NextRandom() % categories.size();
+        bool income = categories[category] == "Income";
+        float amount = (float)(NextRandom() % 500000) / 100.0f;
+        if (!income) amount = -amount;
+
+        int length;
+        if (NextRandom() % 8 == 0) {
+            length = snprintf(line, sizeof(line), "%d-%02d-%02d,%s,%.2f,Payment ref %u\n", year, month, day,
+                              categories[category].c_str(), amount, NextRandom());
+        } else {
+            length = snprintf(line, sizeof(line), "%d-%02d-%02d,%s,%.2f,%s\n", year, month, day,
+                              categories[category].c_str(), amount,
+                              benchDescriptions[NextRandom() % descriptionCount]);
+        }
+        fwrite(line, 1, length, file);
+        bytes += length;
+    }
+
+    fclose(file);
+    return bytes;
+}
+
+// Writes a bank export of `rows` rows: the most recent half of the loaded
+// ledger again, then as many new rows dated after it. Amounts use thousands
+// separators and debit/credit columns, dates DD/MM/YYYY.
+size_t GenerateStatement(const char* path, size_t rows) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return 0;
+    fputs("Account Statement,XXXX1234\n\n", file);
+    fputs("Txn Date,Narration,Ref No,Withdrawal Amt,Deposit Amt,Closing Balance\n", file);
+
+    size_t repeated = std::min(rows / 2, transactions.size());
+    const size_t descriptionCount = sizeof(benchDescriptions) / sizeof(benchDescriptions[0]);
+    char amount[32];
+    for (size_t i = 0; i < rows; i++) {
+        int date;
+        int64_t paise;
+        const char* description;
+        char reference[32];
+        if (i < repeated) {
+            uint32_t row = (uint32_t)(transactions.size() - repeated + i);
+            date = transactions.dates[row];
+            paise = transactions.amounts[row];
+            description = transactions.descriptions.Get(transactions.descriptionIds[row]);
+        } else {
+            date = PackDate(2025 + (int)(i % 5), 1 + NextRandom() % 12, 1 + NextRandom() % 28);
+            paise = (int64_t)(NextRandom() % 500000) - 400000;
+            snprintf(reference, sizeof(reference), "UPI/%u/%s", NextRandom(),
+                     benchDescriptions[NextRandom() % descriptionCount]);
+            description = reference;
+        }
+        int64_t magnitude = paise < 0 ? -paise : paise;
+        int64_t rupees = magnitude / 100;
+        if (rupees >= 1000) {
+            snprintf(amount, sizeof(amount), "\"%lld,%03lld.%02lld\"", (long long)(rupees / 1000),
+                     (long long)(rupees % 1000), (long long)(magnitude % 100));
+        } else {
+            snprintf(amount, sizeof(amount), "%lld.%02lld", (long long)rupees, (long long)(magnitude % 100));
+        }
+        fprintf(file, "%02d/%02d/%04d,\"%s\",%zu,%s,%s,0.00\n", date % 100, date / 100 % 100, date / 10000,
+                description, i, paise < 0 ? amount : "", paise < 0 ? "" : amount);
+    }
+    long bytes = ftell(file);
+    fclose(file);
+    return bytes > 0 ? (size_t)bytes : 0;
+}
+
+struct BenchRule {
+    std::string kind;
+    std::string pattern;
+    std::string category;
+};
+
+// A few rules that match the generated descriptions, behind thousands of
+// payment-reference keywords that mostly do not.
+std::vector<BenchRule> GenerateRules(const char* path, size_t count) {
+    std::vector<BenchRule> generated = {
+        {"keyword", "groceries", "Food"}, {"keyword", "coffee", "Food"}, {"prefix", "rent", "Housing"},
+        {"keyword", "taxi", "Transportation"}, {"keyword", " bill", "Utilities"},
+        {"regex", "^online order$", "Shopping"}};
+    while (generated.size() < count) {
+        char pattern[32];
+        bool prefix = NextRandom() % 4 == 0;
+        snprintf(pattern, sizeof(pattern), prefix ? "payment ref %u" : "ref %u", NextRandom() % 100000);
+        generated.push_back({prefix ? "prefix" : "keyword", pattern, categories[NextRandom() % categories.size()]});
+    }
+    FILE* file = fopen(path, "wb");
+    if (!file) return {};
+    fputs("# generated by bench\n", file);
+    for (const auto& rule : generated) {
+        fprintf(file, "%s %s => %s\n", rule.kind.c_str(), rule.pattern.c_str(), rule.category.c_str());
+    }
+    fclose(file);
+    return generated;
+}
+
+// Reference matcher: every rule in order, plain string search.
+int MatchRulesByScan(const std::vector<BenchRule>& generated, const std::vector<std::regex>& regexes,
+                     const char* text) {
+    std::string lower = text;
+    for (char& c : lower) c = (char)tolower((unsigned char)c);
+    size_t regexIndex = 0;
+    for (const auto& rule : generated) {
+        bool matched;
+        if (rule.kind == "keyword") matched = lower.find(rule.pattern) != std::string::npos;
+        else if (rule.kind == "prefix") matched = lower.compare(0, rule.pattern.size(), rule.pattern) == 0;
+        else matched = std::regex_search(text, regexes[regexIndex++]);
+        if (matched) return GetCategoryId(rule.category);
+    }
+    return -1;
+}
+
+// Field parsing against the forms ledgers written by hand or by older
+// versions hold; an impossible date, and an amount std::stof would not
+// read, must be turned away.
+size_t CountParseMismatches() {
+    struct DateCase {
+        const char* text;
+        int expected; // 0 if it must be rejected
+    };
+    const DateCase dates[] = {
+        {"2024-01-06", 20240106}, {"2024-1-6", 20240106}, {"2024-01-6", 20240106}, {"2024-12-31", 20241231},
+        {"2024-02-29", 20240229}, {"2023-02-29", 0}, {"2024-02-31", 0}, {"2024-04-31", 0},
+        {"2024-13-01", 0}, {"2024-00-10", 0}, {"24-01-06", 0}, {"2024-001-06", 0}, {"2024-01-06x", 0}, {"", 0},
+    };
+    size_t mismatches = 0;
+    for (const DateCase& date : dates) {
+        int packed = 0;
+        bool parsed = ParseDate(date.text, strlen(date.text), packed);
+        if (parsed != (date.expected != 0) || (parsed && packed != date.expected)) {
+            printf("  parse date \"%s\" gave %d  MISMATCH\n", date.text, parsed ? packed : 0);
+            mismatches++;
+        }
+    }
+    struct AmountCase {
+        const char* text;
+        int64_t expected; // paise
+        bool valid;
+    };
+    const AmountCase amounts[] = {
+        {"-20.00", -2000, true}, {" 12.5 ", 1250, true}, {"+7", 700, true}, {".5", 50, true}, {"0.005", 1, true},
+        {"-3e1", -3000, true}, {"1.5E2", 15000, true}, {"12.5abc", 1250, true}, {"\t42", 4200, true},
+        {"abc", 0, false}, {"", 0, false}, {"-", 0, false}, {".", 0, false}, {"inf", 0, false}, {"nan", 0, false},
+    };
+    for (const AmountCase& amount : amounts) {
+        int64_t paise = 0;
+        bool parsed = ParseAmount(amount.text, strlen(amount.text), paise);
+        if (parsed != amount.valid || (parsed && paise != amount.expected)) {
+            printf("  parse amount \"%s\" gave %" PRId64 "  MISMATCH\n", amount.text, parsed ? paise : 0);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+bool BenchDateLess(uint32_t a, uint32_t b) {
+    int dateA = transactions.dates[a];
+    int dateB = transactions.dates[b];
+    return dateA < dateB || (dateA == dateB && a < b);
+}
+
+// The whole ledger's totals must come out as they were before a reload.
+bool SameLedgerTotals(const MonthSummary& before) {
+    MonthSummary after = {};
+    SumDateRange(0, 99991231, after);
+    return memcmp(&before, &after, sizeof(MonthSummary)) == 0;
+}
+
+// What is left of `order` after `removedRows` came out must still read
+// back in date order, every other row once.
+size_t CountRemovedOrderMismatches(const RowOrder& order, const std::vector<uint8_t>& removedRows) {
+    std::vector<uint32_t> remaining;
+    order.GetFirst(0, order.size(), remaining);
+    size_t mismatches = remaining.size() + std::count(removedRows.begin(), removedRows.end(), 1) != transactions.size();
+    for (size_t i = 0; i < remaining.size(); i++) {
+        if (removedRows[remaining[i]] || (i > 0 && !BenchDateLess(remaining[i - 1], remaining[i]))) mismatches++;
+    }
+    return mismatches;
+}
+
+// SumDateRange over five years against the scalar kernel, and the day
+// rollups over random ranges against SumDateRange.
+size_t CountRollupMismatches(int ranges) {
+    MonthSummary expected = {};
+    MonthSummary totals = {};
+    size_t mismatches = 0;
+    SumDateRange(PackDate(2010, 1, 1), PackDate(2014, 12, 31), totals);
+    AggregateScalar(transactions.dates.data(), transactions.amounts.data(), transactions.categoryIds.data(),
+                    transactions.size(), PackDate(2010, 1, 1), PackDate(2014, 12, 31), expected);
+    if (memcmp(&expected, &totals, sizeof(MonthSummary)) != 0) mismatches++;
+    for (int range = 0; range < ranges; range++) {
+        int firstYear = 2005 + NextRandom() % 20;
+        int lastYear = firstYear + NextRandom() % (2025 - firstYear);
+        int firstDate = PackDate(firstYear, 1 + NextRandom() % 12, 1 + NextRandom() % 31);
+        int lastDate = PackDate(lastYear, 1 + NextRandom() % 12, 1 + NextRandom() % 31);
+        GetRangeSummary(firstDate, lastDate, totals);
+        SumDateRange(firstDate, lastDate, expected);
+        if (memcmp(&expected, &totals, sizeof(MonthSummary)) != 0) mismatches++;
+    }
+    return mismatches;
+}
+
+// Every year and some months and weeks of the trend pyramid against the
+// rollups, and the daily series cut down to fit a 2000-point plot without
+// losing its ends.
+size_t CountTrendMismatches() {
+    size_t mismatches = 0;
+    std::vector<TrendPoint> points;
+    MonthSummary totals = {};
+    int first = 0;
+    int last = 0;
+    GetTrendExtent(first, last);
+    GetTrendPoints(TREND_YEAR, TREND_EXPENSE, first, last, SIZE_MAX, points);
+    for (const TrendPoint& point : points) {
+        int year = CivilFromDays(point.day) / 10000;
+        GetRangeSummary(PackDate(year, 1, 1), PackDate(year, 12, 31), totals);
+        if (point.value != totals.expense) mismatches++;
+    }
+    GetTrendPoints(TREND_MONTH, TREND_BALANCE, first, last, SIZE_MAX, points);
+    for (size_t i = 0; i < points.size(); i += 7) {
+        int date = CivilFromDays(points[i].day);
+        const MonthSummary& summary = GetMonthSummary(date / 100 % 100 - 1, date / 10000);
+        if (points[i].value != summary.income - summary.expense) mismatches++;
+    }
+    GetTrendPoints(TREND_WEEK, TREND_CATEGORY, first, last, SIZE_MAX, points);
+    for (size_t i = 0; i < points.size(); i += 53) {
+        GetRangeSummary(CivilFromDays(points[i].day), CivilFromDays(points[i].day + 6), totals);
+        if (points[i].value != totals.categoryExpense[0]) mismatches++;
+    }
+    for (int series = TREND_INCOME; series < TREND_CATEGORY + 3; series++) {
+        GetTrendPoints(TREND_DAY, series, first, last, 2000, points);
+        if (points.size() > 2000 || points.front().day > first || points.back().day != last) mismatches++;
+    }
+    return mismatches;
+}
+
+// A failed write keeps its batch, which lands once the file can be
+// written; until then a reader of the file is told it is on the way. A
+// write cut short, here by a file size limit standing in for a full disk,
+// must leave none of its batch behind, so the retry lands it once.
+size_t CountJournalRetryMismatches(double& retryTime) {
+    const char* journalPath = "bench_journal.csv";
+    size_t mismatches = 0;
+    std::vector<JournalWrite> journalWrites;
+    TakeJournalWrites(journalWrites); // batches from before
+    journalWrites.clear();
+    SetDirectory(journalPath, true);
+    StartJournal(journalPath, FSYNC_NEVER, 1000);
+    std::string line;
+    AppendCSVRow(line, 0);
+    JournalAppend(line);
+    if (FlushJournal() || !JournalWriteFailed()) mismatches++;
+    if (TakeJournalWrites(journalWrites) || !journalWrites.empty()) mismatches++;
+    SetDirectory(journalPath, false);
+    double retryStart = Now();
+    while (JournalWriteFailed() && Now() - retryStart < 5.0) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (!FlushJournal() || !TakeJournalWrites(journalWrites) || journalWrites.size() != 1) mismatches++;
+    retryTime = Now() - retryStart;
+    StopJournal();
+    MappedFile written;
+    if (!OpenMappedFile(journalPath, written) || written.size != strlen(csvHeader) + line.size()) mismatches++;
+    CloseMappedFile(written);
+    remove(journalPath);
+
+#ifndef _WIN32
+    AppendToLedgerFile(journalPath, line, false);
+    size_t heldBytes = strlen(csvHeader) + line.size();
+    struct rlimit savedLimit;
+    getrlimit(RLIMIT_FSIZE, &savedLimit);
+    struct rlimit shortLimit = savedLimit;
+    shortLimit.rlim_cur = heldBytes + line.size() / 2;
+    signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &shortLimit);
+    StartJournal(journalPath, FSYNC_NEVER, 1000);
+    JournalAppend(line + line);
+    if (FlushJournal() || !JournalWriteFailed()) mismatches++;
+    MappedFile cut;
+    if (!OpenMappedFile(journalPath, cut) || cut.size != heldBytes) mismatches++;
+    CloseMappedFile(cut);
+    setrlimit(RLIMIT_FSIZE, &savedLimit);
+    retryStart = Now();
+    while (JournalWriteFailed() && Now() - retryStart < 5.0) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (!FlushJournal()) mismatches++;
+    StopJournal();
+    TakeJournalWrites(journalWrites);
+    MappedFile whole;
+    if (!OpenMappedFile(journalPath, whole) || whole.size != heldBytes + 2 * line.size()) mismatches++;
+    CloseMappedFile(whole);
+    remove(journalPath);
+#endif
+    return mismatches;
+}
+
+// The automaton against every rule in order for the first descriptions,
+// then the same run from the app, which rewrites the CSV: it must change
+// as many rows, and the lines the loader skips must still be in the file.
+// `before` holds the categories from before CategorizeRows.
+size_t CountRuleMismatches(const std::vector<BenchRule>& generated, size_t recategorized, std::vector<uint8_t>& before) {
+    std::vector<std::regex> regexes;
+    for (const auto& rule : generated) {
+        if (rule.kind == "regex") regexes.emplace_back(rule.pattern, std::regex::icase);
+    }
+    size_t mismatches = 0;
+    for (uint32_t id = 0; id < transactions.descriptions.Count() && id < 20000; id++) {
+        const char* text = transactions.descriptions.Get(id);
+        if (MatchRules(rules, text, strlen(text)) != MatchRulesByScan(generated, regexes, text)) mismatches++;
+    }
+    transactions.categoryIds.swap(before);
+    std::string savedRulesPath = rulesPath;
+    rulesPath = benchRulesPath;
+    size_t applied = 0;
+    bool rewritten = ApplyRulesToLedger(applied);
+    rulesPath = savedRulesPath;
+    std::string keptLines;
+    MappedFile csv;
+    if (OpenMappedFile(benchPath, csv) && csv.data) {
+        const char* body = (const char*)memchr(csv.data, '\n', csv.size);
+        if (body) keptLines = CollectSkippedLines(body + 1, csv.data + csv.size);
+        CloseMappedFile(csv);
+    }
+    if (!rewritten || applied != recategorized || keptLines != benchSkippedLines) mismatches++;
+    return mismatches;
+}
+
+// Each query against a full scan: at most `limit` rows, each one a match,
+// none twice. Without a limit nothing stops early, so the rows must also
+// be the first of an unlimited search.
+size_t CountSearchMismatches(const std::vector<std::vector<std::string>>& queries, const SearchFilter& filter,
+                             size_t limit) {
+    size_t mismatches = 0;
+    std::vector<uint32_t> found;
+    std::vector<uint32_t> every;
+    std::vector<uint8_t> matched;
+    for (const auto& terms : queries) {
+        std::string query;
+        for (const std::string& term : terms) query += term + " ";
+        SearchTransactions(query, filter, limit, found);
+        SearchTransactions(query, filter, SIZE_MAX, every);
+        if (every.size() < found.size() || !std::equal(found.begin(), found.end(), every.begin())) mismatches++;
+        if (found.size() != std::min(limit, CountMatchesByScan(terms, filter, matched))) mismatches++;
+        for (uint32_t row : found) {
+            if (!matched[row]) mismatches++;
+            matched[row] = 0; // a row returned twice fails the second time
+        }
+    }
+    return mismatches;
+}
+
+// The report's category amounts must add up to the range's non-income
+// expenses.
+size_t CountReportMismatches(const std::string& report, int firstDate, int lastDate) {
+    MonthSummary totals = {};
+    GetRangeSummary(firstDate, lastDate, totals);
+    int64_t expectedExpense = totals.expense;
+    for (size_t i = 0; i < categories.size(); i++) {
+        if (categories[i] == "Income") expectedExpense -= totals.categoryExpense[i];
+    }
+    std::istringstream lines(report);
+    std::string line;
+    std::getline(lines, line); // header
+    int64_t expense = 0;
+    while (std::getline(lines, line)) {
+        size_t field = 0;
+        for (int comma = 0; comma < 5; comma++) field = line.find(',', field) + 1; // the amount column
+        expense += llround(strtod(line.c_str() + field, nullptr) * 100.0);
+    }
+    return expense != expectedExpense;
+}
+
+// Alerts AddRowsToBudgets(0) must raise: one for every month at the first
+// threshold of a limit.
+size_t CountExpectedBudgetAlerts() {
+    size_t alerts = 0;
+    for (int monthIndex = 2000 * 12; monthIndex < 2100 * 12; monthIndex++) { // the bench's inserts go past 2024
+        const MonthSummary& summary = GetMonthSummary(monthIndex % 12, monthIndex / 12);
+        for (size_t i = 0; i < categories.size(); i++) {
+            if (budgetLimits[i] > 0 && summary.categoryExpense[i] * 100 >= budgetLimits[i] * budgetThresholds[0]) {
+                alerts++;
+            }
+        }
+    }
+    return alerts;
+}
+
+// After edits in place, every index against a scan: the table orders, some
+// months through the rollups and the summaries, and search.
+size_t CountEditedIndexMismatches(const std::vector<std::vector<std::string>>& searchQueries) {
+    size_t mismatches = CountTableOrderMismatches();
+    MonthSummary expected = {};
+    MonthSummary totals = {};
+    for (int query = 0; query < 24; query++) {
+        int monthIndex = (2005 + NextRandom() % 20) * 12 + NextRandom() % 12;
+        int firstDate = PackDate(monthIndex / 12, monthIndex % 12 + 1, 1);
+        SumDateRange(firstDate, firstDate + 99, expected);
+        GetRangeSummary(firstDate, firstDate + 99, totals);
+        const MonthSummary& summary = GetMonthSummary(monthIndex % 12, monthIndex / 12);
+        if (memcmp(&expected, &totals, sizeof(MonthSummary)) != 0 ||
+            memcmp(&expected, &summary, sizeof(MonthSummary)) != 0) {
+            mismatches++;
+        }
+    }
+    return mismatches + CountSearchMismatches(searchQueries, SearchFilter(), transactions.size());
+}
+
+// Reloads the CSV: it must hold the rows the store does, with the same
+// totals, and skip only benchSkippedLines.
+size_t CountReloadMismatches(double& reloadTime) {
+    size_t liveRows = GetLiveRowCount();
+    MonthSummary before = {};
+    SumDateRange(0, 99991231, before);
+    double start = Now();
+    LoadStats reloaded = LoadTransactionsFromCSV();
+    reloadTime = Now() - start;
+    return reloaded.rowsSkipped != benchSkippedCount || GetLiveRowCount() != liveRows || !SameLedgerTotals(before);
+}
+
+// Rows landing before ours, an edit record from elsewhere or a truncated
+// file must ask for a full reload without touching the store.
+size_t CountTailReloadMismatches() {
+    size_t mismatches = 0;
+    LoadStats tailed;
+    StartJournal(benchPath, FSYNC_NEVER, 1000);
+    StartLedgerTail();
+    AppendToLedgerFile(benchPath, "2024-06-01,Food,-1.00,Appended before ours\n", false);
+    AddTransaction({"2024-06-02", "Food", -2.0f, "Ours after theirs"});
+    FlushJournal(); // the tail only reads once our batch is in the file
+    if (TailLedgerFile(tailed) != TAIL_RELOAD) mismatches++;
+    StopJournal();
+    LoadTransactionsFromCSV();
+    StartLedgerTail();
+    size_t heldRows = transactions.size();
+    AppendToLedgerFile(benchPath, "2024-06-03,Food,-3.00,Before their edit\n#delete,0\n", false);
+    if (TailLedgerFile(tailed) != TAIL_RELOAD || transactions.size() != heldRows || transactions.IsDeleted(0)) {
+        mismatches++;
+    }
+    LoadTransactionsFromCSV();
+    StartLedgerTail();
+    FILE* truncated = fopen(benchPath, "wb");
+    if (truncated) {
+        fputs(csvHeader, truncated);
+        fclose(truncated);
+    }
+    if (TailLedgerFile(tailed) != TAIL_RELOAD) mismatches++;
+    return mismatches;
+}
+
+// A snapshot covers what the store holds, its own rows included; rows
+// appended elsewhere since, and a line still being written, are left to
+// the next load. Starts from an empty ledger file.
+size_t CountSnapshotPrefixMismatches() {
+    AppendToLedgerFile(benchPath, "2024-07-01,Food,-3.00,Loaded\n", false);
+    LoadTransactionsFromCSV();
+    StartLedgerTail();
+    AddTransaction({"2024-07-02", "Food", -4.0f, "Ours"});
+    AppendToLedgerFile(benchPath, "2024-07-03,Food,-5.00,Not tailed\n2024-07-04,Fo", false);
+    bool saved = SaveSnapshot();
+    AppendToLedgerFile(benchPath, "od,-6.00,Finished later\n", false);
+    LoadStats stats = {0, 0};
+    bool exact = saved && LoadSnapshot(stats) && transactions.size() == 4 && stats.rowsSkipped == 0;
+    remove(GetSnapshotPath().c_str());
+    return !exact;
+}
+
+void RunBenchmark(size_t rows) {
+    printf("== %zu rows ==\n", rows);
+    benchRows = rows;
+
+    double start = Now();
+    size_t bytes = GenerateLedger(benchPath, rows);
+    if (bytes == 0) {
+        printf("  could not write %s\n", benchPath);
+        return;
+    }
+    printf("  generate        %10.3f s   (%.1f MB)\n", Now() - start, bytes / 1e6);
+
+    ledgerPath = benchPath;
+    start = Now();
+    LoadStats stats = LoadTransactionsFromCSV();
+    double loadTime = Now() - start;
+    printf("  load            %10.3f s   %10.0f rows/s   %8.1f MB/s   (%zu rows, %zu skipped)\n",
+           loadTime, stats.rowsLoaded / loadTime, bytes / loadTime / 1e6, stats.rowsLoaded, stats.rowsSkipped);
+
+    // What one frame of DrawMonthlySummary asks for, for every month in the ledger.
+    start = Now();
+    int queries = 0;
+    double checksum = 0.0;
+    for (int year = 2005; year < 2025; year++) {
+        for (int month = 0; month < 12; month++) {
+            std::vector<Transaction> monthTransactions = GetTransactionsForMonth(month, year);
+            checksum += GetTotalIncome(monthTransactions) - GetTotalExpense(monthTransactions);
+            checksum += GetCategorySummary(monthTransactions).size();
+            queries++;
+        }
+    }
+    double queryTime = Now() - start;
+    printf("  month query     %10.3f ms/query   (%d queries, checksum %.0f)\n",
+           queryTime * 1000.0 / queries, queries, checksum);
+
+    // Month and year lookups through the date index.
+    start = Now();
+    size_t indexedRows = 0;
+    for (int year = 2005; year < 2025; year++) {
+        for (int month = 0; month < 12; month++) {
+            indexedRows += GetRowsForMonth(month, year).size();
+        }
+        indexedRows += GetRowsInDateRange(PackDate(year, 1, 1), PackDate(year, 12, 31)).size();
+    }
+    double indexTime = Now() - start;
+    printf("  date index      %10.3f us/query   (%d queries, %zu rows covered)\n",
+           indexTime * 1e6 / (queries + 20), queries + 20, indexedRows);
+
+    // The dashboard's "Recent Transactions" page, near the top and deep in history.
+    static std::vector<uint32_t> recentRows;
+    start = Now();
+    const int recentRepeats = 10000;
+    for (int repeat = 0; repeat < recentRepeats; repeat++) {
+        GetRecentRows(repeat % 2 == 0 ? 0 : rows / 20, 10, recentRows);
+    }
+    double recentTime = Now() - start;
+    printf("  recent page     %10.3f us/query   (%d queries)\n", recentTime * 1e6 / recentRepeats, recentRepeats);
+
+    // Rebuild a date order one insert at a time, in file order. Rows are
+    // out of date order within each month, so most inserts are back-dated.
+    RowOrder order = {BenchDateLess, {}, {}, {}};
+    start = Now();
+    for (uint32_t row = 0; row < transactions.size(); row++) {
+        order.Insert(row);
+    }
+    double insertTime = Now() - start;
+    printf("  index insert    %10.3f us/row     (%zu rows)\n", insertTime * 1e6 / transactions.size(),
+           transactions.size());
+
+    // Take a random tenth of them out again, as edits and deletes do.
+    std::vector<uint8_t> removedRows(transactions.size(), 0);
+    size_t removeCount = transactions.size() / 10;
+    start = Now();
+    for (size_t i = 0; i < removeCount; i++) {
+        uint32_t row = NextRandom() % transactions.size();
+        if (!removedRows[row]) order.Remove(row);
+        removedRows[row] = 1;
+    }
+    double removeTime = Now() - start;
+    printf("  index remove    %10.3f us/row     (%zu rows)%s\n", removeTime * 1e6 / removeCount, removeCount,
+           NoteMismatches("index remove", CountRemovedOrderMismatches(order, removedRows)));
+
+    // The same figures from the maintained month summaries.
+    start = Now();
+    const int summaryRepeats = 1000;
+    for (int repeat = 0; repeat < summaryRepeats; repeat++) {
+        for (int year = 2005; year < 2025; year++) {
+            for (int month = 0; month < 12; month++) {
+                const MonthSummary& summary = GetMonthSummary(month, year);
+                checksum += ToRupees(summary.income - summary.expense);
+            }
+        }
+    }
+    double summaryTime = Now() - start;
+    printf("  month summary   %10.3f us/query   (%d queries)\n",
+           summaryTime * 1e6 / (queries * summaryRepeats), queries * summaryRepeats);
+
+    // Whole-ledger aggregation with every kernel this CPU runs, each
+    // checked bit-for-bit against the scalar one.
+    static MonthSummary expected;
+    static MonthSummary totals;
+    const AggregateKernel kernels[] = {AggregateScalar, AggregateSSE42, AggregateAVX2};
+    const size_t columnBytes = sizeof(int) + sizeof(int64_t) + sizeof(uint8_t);
+    for (AggregateKernel kernel : kernels) {
+        if (!IsKernelSupported(kernel)) continue;
+        totals = MonthSummary();
+        start = Now();
+        kernel(transactions.dates.data(), transactions.amounts.data(), transactions.categoryIds.data(),
+               transactions.size(), 0, 99991231, totals);
+        double aggregateTime = Now() - start;
+        if (kernel == AggregateScalar) expected = totals;
+        std::string check = std::string("aggregate ") + GetAggregateKernelName(kernel);
+        printf("  aggregate %-6s%10.3f ms      %10.0f rows/s   %8.1f GB/s   (income %.2f, expense %.2f)%s\n",
+               GetAggregateKernelName(kernel), aggregateTime * 1000.0, transactions.size() / aggregateTime,
+               transactions.size() * columnBytes / aggregateTime / 1e9, ToRupees(totals.income),
+               ToRupees(totals.expense),
+               NoteMismatches(check.c_str(), memcmp(&expected, &totals, sizeof(MonthSummary)) != 0));
+    }
+
+    // A five-year rollup through SumDateRange.
+    start = Now();
+    SumDateRange(PackDate(2010, 1, 1), PackDate(2014, 12, 31), totals);
+    double rangeTime = Now() - start;
+    printf("  5-year range    %10.3f ms      (%s, balance %.2f)\n", rangeTime * 1000.0,
+           GetAggregateKernelName(GetAggregateKernel()), ToRupees(totals.income - totals.expense));
+
+    // Arbitrary ranges from the day rollups.
+    const int rollupQueries = 10000;
+    double rollupTime = 0.0;
+    for (int query = 0; query < rollupQueries; query++) {
+        int firstYear = 2005 + NextRandom() % 20;
+        int lastYear = firstYear + NextRandom() % (2025 - firstYear);
+        int firstDate = PackDate(firstYear, 1 + NextRandom() % 12, 1 + NextRandom() % 31);
+        int lastDate = PackDate(lastYear, 1 + NextRandom() % 12, 1 + NextRandom() % 31);
+        start = Now();
+        GetRangeSummary(firstDate, lastDate, totals);
+        rollupTime += Now() - start;
+    }
+    printf("  range rollup    %10.3f us/query   (%d queries, %.1f MB)%s\n", rollupTime * 1e6 / rollupQueries,
+           rollupQueries, GetDayRollupMemoryUsage() / 1e6, NoteMismatches("range rollup", CountRollupMismatches(20)));
+
+    // The trend pyramid, and the chart's per-frame queries over the whole
+    // history timed for a 1000-pixel plot.
+    start = Now();
+    UpdateTrendPyramid();
+    double pyramidTime = Now() - start;
+    std::vector<TrendPoint> trendPoints;
+    int trendFirst = 0;
+    int trendLast = 0;
+    GetTrendExtent(trendFirst, trendLast);
+    const int trendFrames = 100;
+    TrendLevel trendLevel = PickTrendLevel(trendFirst, trendLast, 1000);
+    start = Now();
+    for (int frame = 0; frame < trendFrames; frame++) {
+        for (int series = TREND_INCOME; series < TREND_CATEGORY + 3; series++) {
+            GetTrendPoints(trendLevel, series, trendFirst, trendLast, 2000, trendPoints);
+        }
+    }
+    double autoTime = (Now() - start) / trendFrames;
+    start = Now();
+    for (int frame = 0; frame < trendFrames; frame++) {
+        for (int series = TREND_INCOME; series < TREND_CATEGORY + 3; series++) {
+            GetTrendPoints(TREND_DAY, series, trendFirst, trendLast, 2000, trendPoints);
+        }
+    }
+    double dailyTime = (Now() - start) / trendFrames;
+    const char* levelNames[] = {"day", "week", "month", "year"};
+    printf("  trend pyramid   %10.3f ms      (%.1f KB; 6 series: %.3f ms/frame by %s, %.3f ms/frame daily LTTB)%s\n",
+           pyramidTime * 1000.0, GetTrendMemoryUsage() / 1e3, autoTime * 1000.0, levelNames[trendLevel],
+           dailyTime * 1000.0, NoteMismatches("trend pyramid", CountTrendMismatches()));
+
+    // Persisting rows: the old open/append/close per row against the journal,
+    // which queues lines and lets the writer thread batch them.
+    const char* journalPath = "bench_journal.csv";
+    size_t syncRows = std::min<size_t>(transactions.size(), 2000);
+    std::string line;
+    start = Now();
+    for (uint32_t row = 0; row < syncRows; row++) {
+        line.clear();
+        AppendCSVRow(line, row);
+        AppendToLedgerFile(journalPath, line, false);
+    }
+    double syncTime = Now() - start;
+    remove(journalPath);
+
+    StartJournal(journalPath, FSYNC_INTERVAL, 1000);
+    start = Now();
+    for (uint32_t row = 0; row < transactions.size(); row++) {
+        line.clear();
+        AppendCSVRow(line, row);
+        JournalAppend(line);
+    }
+    double enqueueTime = Now() - start;
+    FlushJournal();
+    double drainTime = Now() - start;
+    StopJournal();
+    remove(journalPath);
+    double retryTime = 0.0;
+    size_t journalMismatches = CountJournalRetryMismatches(retryTime);
+    printf("  save per row    %10.3f us/row     (open/append/close, %zu rows)\n", syncTime * 1e6 / syncRows, syncRows);
+    printf("  journal append  %10.3f us/row     (%.3f s until written, failed write retried in %.3f s)%s\n",
+           enqueueTime * 1e6 / transactions.size(), drainTime, retryTime,
+           NoteMismatches("journal retry", journalMismatches));
+
+    // Startup from the binary snapshot instead of the CSV text; it must load
+    // back to the same ledger.
+    MonthSummary before = {};
+    SumDateRange(0, 99991231, before);
+    size_t rowsBefore = transactions.size();
+    start = Now();
+    bool saved = SaveSnapshot();
+    double saveTime = Now() - start;
+    start = Now();
+    LoadStats snapshotStats = {0, 0};
+    bool loaded = saved && LoadSnapshot(snapshotStats);
+    double snapshotTime = Now() - start;
+    bool snapshotExact = loaded && transactions.size() == rowsBefore && SameLedgerTotals(before);
+    printf("  snapshot save   %10.3f s\n", saveTime);
+    printf("  snapshot load   %10.3f s   %10.1fx faster than CSV%s\n", snapshotTime, loadTime / snapshotTime,
+           NoteMismatches("snapshot load", !snapshotExact));
+    remove(GetSnapshotPath().c_str());
+
+    // Bulk import of a bank export half made of rows the ledger already has;
+    // exactly that half must be found duplicate.
+    size_t statementRows = std::min<size_t>(rows, 1000000);
+    size_t statementBytes = GenerateStatement(statementPath, statementRows);
+    start = Now();
+    ImportStats imported = ImportStatement(statementPath);
+    double importTime = Now() - start;
+    remove(statementPath);
+    size_t expectedDuplicates = std::min(statementRows / 2, rowsBefore);
+    bool importExact = imported.rowsDuplicate == expectedDuplicates &&
+                       imported.rowsImported == statementRows - expectedDuplicates && imported.rowsSkipped == 0;
+    printf("  import          %10.3f s   %10.0f rows/s   %8.1f MB/s   (%zu imported, %zu duplicates, %zu skipped)%s\n",
+           importTime, statementRows / importTime, statementBytes / importTime / 1e6, imported.rowsImported,
+           imported.rowsDuplicate, imported.rowsSkipped, NoteMismatches("import", !importExact));
+
+    // Recategorizing the whole ledger after a rule edit.
+    std::vector<BenchRule> generated = GenerateRules(benchRulesPath, 5000);
+    start = Now();
+    LoadStats ruleStats = LoadRules(benchRulesPath, rules);
+    double compileTime = Now() - start;
+    std::vector<uint8_t> importedCategories = transactions.categoryIds;
+    start = Now();
+    size_t recategorized = CategorizeRows(rules, 0, (uint32_t)transactions.size());
+    RebuildMonthSummaries();
+    double categorizeTime = Now() - start;
+    size_t ruleMismatches = CountRuleMismatches(generated, recategorized, importedCategories);
+    remove(benchRulesPath);
+    printf("  rules compile   %10.3f ms      (%zu rules, %zu automaton states)\n", compileTime * 1000.0,
+           ruleStats.rowsLoaded, rules.depth.size());
+    printf("  recategorize    %10.3f s   %10.0f rows/s   (%zu rows changed)%s\n", categorizeTime,
+           transactions.size() / categorizeTime, recategorized, NoteMismatches("rules", ruleMismatches));
+    rules = RuleSet();
+
+    // Search box queries, with and without a filter.
+    start = Now();
+    BuildSearchIndex();
+    double searchBuildTime = Now() - start;
+    const std::vector<std::vector<std::string>> searchQueries = {
+        {"groceries"}, {"bill"}, {"payment", "ref"}, {"ref", "424"}, {"gym", "mem"}, {"xyzzy"}
+    };
+    SearchFilter filters[2];
+    filters[1].categoryId = GetCategoryId("Food");
+    filters[1].firstDate = 20150101;
+    filters[1].lastDate = 20191231;
+    const size_t searchLimit = 50;
+    const int searchRepeats = 20;
+    std::vector<double> searchLatency;
+    std::vector<uint32_t> found;
+    for (const auto& terms : searchQueries) {
+        std::string query;
+        for (const std::string& term : terms) query += term + " ";
+        for (const SearchFilter& filter : filters) {
+            for (int i = 0; i < searchRepeats; i++) {
+                start = Now();
+                SearchTransactions(query, filter, searchLimit, found);
+                searchLatency.push_back(Now() - start);
+            }
+        }
+    }
+    size_t searchMismatches = 0;
+    for (const SearchFilter& filter : filters) searchMismatches += CountSearchMismatches(searchQueries, filter, searchLimit);
+    printf("  search index    %10.3f s   %10.1f MB\n", searchBuildTime, GetSearchIndexMemoryUsage() / 1e6);
+    double searchTime = 0.0;
+    for (double latency : searchLatency) searchTime += latency;
+    std::sort(searchLatency.begin(), searchLatency.end());
+    printf("  search          %10.3f us/query   (%zu queries, top %zu, p99 %.3f us, max %.3f us)%s\n",
+           searchTime * 1e6 / searchLatency.size(), searchLatency.size(), searchLimit,
+           searchLatency[searchLatency.size() * 99 / 100] * 1e6, searchLatency.back() * 1e6,
+           NoteMismatches("search", searchMismatches));
+
+    // The ledger table's sort orders, kept current through the import above.
+    size_t tableMismatches = CountTableOrderMismatches();
+    std::vector<uint32_t> window;
+    start = Now();
+    ResetTableOrders();
+    BuildTableOrders();
+    double tableBuildTime = Now() - start;
+    // A screenful of rows at a random scroll position, as the table draws it.
+    const int windowReads = 20000;
+    start = Now();
+    for (int i = 0; i < windowReads; i++) {
+        GetTableRows((TableColumn)(i % 4), i % 8 >= 4, NextRandom() % transactions.size(), 22, window);
+    }
+    double windowTime = Now() - start;
+    printf("  table orders    %10.3f s   %10.1f MB%s\n", tableBuildTime, GetTableOrderMemoryUsage() / 1e6,
+           NoteMismatches("table orders", tableMismatches));
+    printf("  table window    %10.3f us/window   (%d windows of 22 rows)\n", windowTime * 1e6 / windowReads,
+           windowReads);
+
+    // The twenty-year report as 2.exe --report writes it.
+    std::ostringstream reportText;
+    start = Now();
+    WriteReport(2005 * 12, 2024 * 12 + 11, REPORT_CSV, reportText);
+    double reportTime = Now() - start;
+    std::ostringstream jsonText;
+    WriteReport(2005 * 12, 2024 * 12 + 11, REPORT_JSON, jsonText);
+    std::string report = reportText.str();
+    printf("  report          %10.3f ms      (240 months, %zu rows, %.1f KB CSV, %.1f KB JSON)%s\n", reportTime * 1000.0,
+           (size_t)std::count(report.begin(), report.end(), '\n') - 1, report.size() / 1e3, jsonText.str().size() / 1e3,
+           NoteMismatches("report", CountReportMismatches(report, 20050101, 20241231)));
+
+    // Budget alerts for the whole ledger as if it had just been imported.
+    // Limits are a month's average spending in the category, so about half
+    // the months cross them.
+    MonthSummary reportTotals = {};
+    GetRangeSummary(20050101, 20241231, reportTotals);
+    budgetLimits.assign(categories.size(), 0);
+    for (size_t i = 0; i < categories.size(); i++) {
+        if (categories[i] == "Income") continue;
+        budgetLimits[i] = std::max<int64_t>(1, reportTotals.categoryExpense[i] / 240);
+    }
+    budgetAlerts.clear();
+    start = Now();
+    AddRowsToBudgets(0);
+    double budgetTime = Now() - start;
+    printf("  budget alerts   %10.3f s   %10.0f rows/s   (%zu alerts)%s\n", budgetTime, transactions.size() / budgetTime,
+           budgetAlerts.size(), NoteMismatches("budget alerts", budgetAlerts.size() != CountExpectedBudgetAlerts()));
+    budgetLimits.clear();
+    budgetAlerts.clear();
+
+    // Edits and deletes in place, each one record appended to the CSV; then
+    // every index is checked against a scan and the CSV reloaded.
+    const size_t editCount = std::min<size_t>(rows / 10, 20000);
+    StartJournal(benchPath, FSYNC_INTERVAL, 1000);
+    start = Now();
+    for (size_t i = 0; i < editCount; i++) {
+        uint32_t row = NextRandom() % transactions.size();
+        if (i % 2 == 1) {
+            DeleteTransaction(row);
+            continue;
+        }
+        Transaction edited = GetTransaction(row);
+        char date[11];
+        edited.date = FormatDate(PackDate(2005 + NextRandom() % 20, 1 + NextRandom() % 12, 1 + NextRandom() % 28), date);
+        edited.category = categories[NextRandom() % categories.size()];
+        edited.amount = ((int)(NextRandom() % 500000) - 400000) / 100.0;
+        if (i % 10 == 0) edited.description = "Edited " + std::to_string(i);
+        UpdateTransaction(row, edited);
+    }
+    double editTime = Now() - start;
+    FlushJournal();
+    size_t editMismatches = CountEditedIndexMismatches(searchQueries);
+    StopJournal();
+    double reloadTime = 0.0;
+    editMismatches += CountReloadMismatches(reloadTime);
+    printf("  edit or delete  %10.3f us/row     (%zu rows)%s\n", editTime * 1e6 / editCount, editCount,
+           NoteMismatches("edit or delete", editMismatches));
+
+    // The compaction that drops the dead lines. One edit and one delete
+    // land while it writes; they must carry over into the compacted file as
+    // its only records, and an edit after it must name the row's new file
+    // row id.
+    StartJournal(benchPath, FSYNC_INTERVAL, 1000);
+    double savedRatio = compactionRatio;
+    compactionRatio = 1e-9; // whatever the ledger's size; compactionMinLines still holds
+    start = Now();
+    size_t deadLines = transactions.recordLines + transactions.deletedCount;
+    CompactLedgerIfNeeded();
+    double compactStartTime = Now() - start;
+    uint32_t editedRow = 0;
+    while (transactions.IsDeleted(editedRow)) editedRow++;
+    Transaction moved = GetTransaction(editedRow);
+    moved.amount -= 1;
+    UpdateTransaction(editedRow, moved);
+    uint32_t deletedRow = (uint32_t)transactions.size() - 1;
+    while (transactions.IsDeleted(deletedRow)) deletedRow--;
+    DeleteTransaction(deletedRow);
+    while (transactions.recordLines > 2 && Now() - start < 60.0) {
+        CompactLedgerIfNeeded();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double compactTime = Now() - start;
+    moved.amount -= 1;
+    UpdateTransaction(editedRow, moved);
+    compactionRatio = savedRatio;
+    StopCompaction();
+    StopJournal();
+    size_t compactMismatches = CountReloadMismatches(reloadTime);
+    if (transactions.recordLines != 3 || transactions.deletedCount != 1) compactMismatches++;
+    printf("  compaction      %10.3f s   (%zu dead lines dropped, %.3f ms to start)%s\n", compactTime, deadLines,
+           compactStartTime * 1000.0, NoteMismatches("compaction", compactMismatches));
+
+    // Rows another program appends while the app runs, merged by tailing
+    // the CSV. Every other batch follows one of our own journal rows, and
+    // the rest time the watcher. The result must match a full reload.
+    const size_t tailBatches = std::min<size_t>(rows / 100, 200);
+    const int tailBatchRows = 100;
+    std::vector<double> watchLatency;
+    size_t tailMismatches = 0;
+    double tailTime = 0;
+    LoadStats tailed;
+    StartJournal(benchPath, FSYNC_NEVER, 1000);
+    StartLedgerWatch(benchPath, RecordWatchSignal);
+    StartLedgerTail();
+    for (size_t batch = 0; batch < tailBatches; batch++) {
+        if (batch % 2 == 0) {
+            AddTransaction({"2024-12-31", "Food", -12.5f, "Tail bench own row"});
+            FlushJournal();
+        }
+        std::string lines;
+        for (int i = 0; i < tailBatchRows; i++) {
+            char appendedLine[96];
+            snprintf(appendedLine, sizeof(appendedLine), "2024-%02u-%02u,Shopping,-%u.%02u,Appended elsewhere %u\n",
+                     1 + NextRandom() % 12, 1 + NextRandom() % 28, NextRandom() % 5000, NextRandom() % 100,
+                     NextRandom() % 1000);
+            lines += appendedLine;
+        }
+        double appended = Now();
+        AppendToLedgerFile(benchPath, lines, false);
+        if (batch % 2 == 1) {
+            while (watchSignalTime < appended && Now() - appended < 2.0) std::this_thread::yield();
+            if (watchSignalTime >= appended) watchLatency.push_back(watchSignalTime - appended);
+        }
+        LedgerFileChanged();
+        start = Now();
+        TailResult result = TailLedgerFile(tailed);
+        tailTime += Now() - start;
+        if (result != TAIL_APPENDED || tailed.rowsLoaded != (size_t)tailBatchRows) tailMismatches++;
+    }
+    StopLedgerWatch();
+    StopJournal();
+    tailMismatches += CountTableOrderMismatches();
+    tailMismatches += CountReloadMismatches(reloadTime);
+    tailMismatches += CountTailReloadMismatches();
+    std::sort(watchLatency.begin(), watchLatency.end());
+    double medianLatency = watchLatency.empty() ? 0.0 : watchLatency[watchLatency.size() / 2];
+    printf("  tail append     %10.3f ms/batch   (%zu batches of %d rows, full reload %.3f s, watch latency %.3f ms)%s\n",
+           tailBatches ? tailTime * 1000.0 / tailBatches : 0.0, tailBatches, tailBatchRows, reloadTime,
+           medianLatency * 1000.0, NoteMismatches("tail append", tailMismatches));
+
+    size_t ledgerBytes = GetLedgerMemoryUsage();
+    printf("  ledger memory   %10.1f MB      %10.1f bytes/row   (%zu distinct descriptions)\n",
+           ledgerBytes / 1e6, (double)ledgerBytes / rows, transactions.descriptions.Count());
+    printf("  peak RSS        %10.1f MB\n", GetPeakRSS() / 1e6);
+
+    size_t prefixMismatches = CountSnapshotPrefixMismatches();
+    printf("  snapshot prefix %10zu rows      (2 held, 2 appended elsewhere parsed on load)%s\n", transactions.size(),
+           NoteMismatches("snapshot prefix", prefixMismatches));
+
+    transactions = TransactionStore();
+    remove(benchPath);
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; i++) {
+        sizes.push_back(strtoull(argv[i], nullptr, 10));
+    }
+    if (sizes.empty()) {
+        sizes = {10000, 100000, 1000000, 10000000, 50000000};
+    }
+
+    NoteMismatches("parse", CountParseMismatches());
+    for (size_t rows : sizes) {
+        if (rows > 0) RunBenchmark(rows);
+    }
+#ifdef BUDGET_PROFILE
+    WriteProfileTrace("bench_profile.json"); // built with -DBUDGET_PROFILE: every load, save and index build
+#endif
+    if (!failedChecks.empty()) {
+        printf("mismatches in %zu of the checks:", failedChecks.size());
+        for (const std::string& check : failedChecks) printf("\n  %s", check.c_str());
+        printf("\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "budget.h"
+#include "profile.h"
+#include <fstream>
+#include <unordered_map>
+
+std::vector<int64_t> budgetLimits;
+std::vector<BudgetAlert> budgetAlerts;
+std::string budgetsPath = "budgets.csv";
+
+LoadStats LoadBudgets(const std::string& path) {
+    LoadStats stats = {0, 0};
+    budgetLimits.clear();
+    std::ifstream file(path);
+    std::string line;
+    bool header = true;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (header) {
+            header = false;
+            if (line.compare(0, 8, "Category") == 0) continue;
+        }
+        if (line.empty()) continue;
+        size_t comma = line.rfind(',');
+        int64_t limit = 0;
+        if (comma == std::string::npos || comma == 0 ||
+            !ParseAmount(line.data() + comma + 1, line.size() - comma - 1, limit) || limit <= 0) {
+            stats.rowsSkipped++;
+            continue;
+        }
+        int categoryId = GetCategoryId(line.substr(0, comma));
+        if (budgetLimits.size() <= (size_t)categoryId) budgetLimits.resize(categoryId + 1, 0);
+        budgetLimits[categoryId] = limit;
+        stats.rowsLoaded++;
+    }
+    return stats;
+}
+
+bool SaveBudgets() {
+    std::ofstream file(budgetsPath, std::ios::trunc);
+    if (!file) return false;
+    file << "Category,Limit\n";
+    char amount[24];
+    for (size_t i = 0; i < budgetLimits.size(); i++) {
+        if (budgetLimits[i] > 0) file << categories[i] << ',' << FormatAmount(budgetLimits[i], amount) << '\n';
+    }
+    return (bool)file;
+}
+
+void SetBudgetLimit(int categoryId, int64_t limit) {
+    if (budgetLimits.size() <= (size_t)categoryId) budgetLimits.resize(categoryId + 1, 0);
+    budgetLimits[categoryId] = limit > 0 ? limit : 0;
+    SaveBudgets();
+}
+
+int64_t GetBudgetLimit(int categoryId) {
+    return (size_t)categoryId < budgetLimits.size() ? budgetLimits[categoryId] : 0;
+}
+
+int GetBudgetPercent(int categoryId, int month, int year) {
+    int64_t limit = GetBudgetLimit(categoryId);
+    if (limit <= 0) return -1;
+    return (int)(GetMonthSummary(month, year).categoryExpense[categoryId] * 100 / limit);
+}
+
+// Highest threshold `spent` has reached, or 0.
+int GetBudgetThreshold(int64_t spent, int64_t limit) {
+    int reached = 0;
+    for (int threshold : budgetThresholds) {
+        if (spent * 100 >= limit * threshold) reached = threshold;
+    }
+    return reached;
+}
+
+// Adds a row's spending, times `sign`, to its budgeted category and month.
+void AddSpending(std::unordered_map<int, int64_t>& added, int packedDate, int categoryId, int64_t amount, int sign) {
+    if (packedDate == 0 || amount >= 0 || GetBudgetLimit(categoryId) <= 0) return;
+    int monthIndex = packedDate / 10000 * 12 + packedDate / 100 % 100 - 1;
+    added[monthIndex * maxCategories + categoryId] += -amount * sign;
+}
+
+// `added` is what just changed in each budgeted category and month; the
+// summaries already include it, so the difference is the spending before.
+void QueueBudgetAlerts(const std::unordered_map<int, int64_t>& added) {
+    for (const auto& entry : added) {
+        int monthIndex = entry.first / maxCategories;
+        int categoryId = entry.first % maxCategories;
+        int64_t limit = budgetLimits[categoryId];
+        int64_t spent = GetMonthSummary(monthIndex % 12, monthIndex / 12).categoryExpense[categoryId];
+        int threshold = GetBudgetThreshold(spent, limit);
+        if (threshold > GetBudgetThreshold(spent - entry.second, limit)) {
+            budgetAlerts.push_back({categoryId, monthIndex, threshold, spent, limit});
+        }
+    }
+}
+
+void AddRowsToBudgets(uint32_t firstRow) {
+    if (budgetLimits.empty()) return;
+    PROFILE_SCOPE("Budget alerts");
+    std::unordered_map<int, int64_t> added; // key: monthIndex * maxCategories + categoryId
+    for (uint32_t row = firstRow; row < transactions.size(); row++) {
+        AddSpending(added, transactions.dates[row], transactions.categoryIds[row], transactions.amounts[row], 1);
+    }
+    QueueBudgetAlerts(added);
+}
+
+void UpdateRowInBudgets(uint32_t row, int oldDate, int oldCategoryId, int64_t oldAmount) {
+    if (budgetLimits.empty()) return;
+    std::unordered_map<int, int64_t> added;
+    AddSpending(added, oldDate, oldCategoryId, oldAmount, -1);
+    AddSpending(added, transactions.dates[row], transactions.categoryIds[row], transactions.amounts[row], 1);
+    QueueBudgetAlerts(added);
+}
+
+std::string FormatBudgetAlert(const BudgetAlert& alert) {
+    // Short enough for the header's status line.
+    char spent[24];
+    char limit[24];
+    FormatAmount(alert.spent, spent);
+    FormatAmount(alert.limit, limit);
+    std::string month = GetMonthName(alert.monthIndex % 12).substr(0, 3) + " " + std::to_string(alert.monthIndex / 12);
+    std::string state = alert.threshold >= 100 ? " over " : " at " + std::to_string(alert.threshold) + "% of ";
+    return categories[alert.categoryId] + state + month + " budget: Rs." + spent + " of Rs." + limit;
+}
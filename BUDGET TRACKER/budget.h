@@ -0,0 +1,48 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+// Monthly spending limits per category, kept in budgets.csv next to the
+// ledger:
+//
+//   Category,Limit
+//   Food,5000.00
+//
+// Spending is read from the month summaries, which every added or imported
+// row already updates, so checking a limit costs one lookup. When rows are
+// added, AddRowsToBudgets compares each touched category's spending before
+// and after them and queues an alert for every threshold crossed: O(1) for
+// AddTransaction and one pass over the new rows for an import; an edit is
+// checked the same way, and a delete can only lower spending. A reload
+// rebuilds the summaries in one pass, so there is no other state to rebuild.
+
+#include "ledger.h"
+
+const int budgetThresholdCount = 2;
+const int budgetThresholds[budgetThresholdCount] = {80, 100}; // percent of the limit
+
+struct BudgetAlert {
+    int categoryId;
+    int monthIndex; // year * 12 + month
+    int threshold;  // the highest one crossed
+    int64_t spent;
+    int64_t limit;
+};
+
+extern std::vector<int64_t> budgetLimits;     // paise by category id, 0 for none
+extern std::vector<BudgetAlert> budgetAlerts; // crossed since the caller last cleared it
+extern std::string budgetsPath;               // defaults to "budgets.csv"
+
+// Replaces the limits with `path`'s; malformed lines are skipped. Run on
+// the UI thread, as unknown category names are added to `categories`.
+LoadStats LoadBudgets(const std::string& path);
+bool SaveBudgets();
+void SetBudgetLimit(int categoryId, int64_t limit); // 0 removes it; saves the file
+int64_t GetBudgetLimit(int categoryId);
+// Percent of the limit spent in a month, or -1 if the category has none.
+int GetBudgetPercent(int categoryId, int month, int year);
+void AddRowsToBudgets(uint32_t firstRow); // rows firstRow.. were just added to the summaries
+// A row was just edited in the summaries; alerts for thresholds its new values cross.
+void UpdateRowInBudgets(uint32_t row, int oldDate, int oldCategoryId, int64_t oldAmount);
+std::string FormatBudgetAlert(const BudgetAlert& alert);
+
+#endif
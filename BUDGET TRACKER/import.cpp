@@ -0,0 +1,431 @@
+#include "import.h"
+#include "journal.h"
+#include "rules.h"
+#include "profile.h"
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+
+struct StatementColumns {
+    char separator = ',';
+    int count = 0; // fields in the header row
+    int date = -1;
+    int description = -1;
+    int category = -1;
+    int amount = -1;
+    int debit = -1;
+    int credit = -1;
+};
+
+struct StatementChunk {
+    std::vector<int> dates;
+    std::vector<int64_t> amounts;
+    std::vector<uint8_t> categoryIds;        // local to categoryNames
+    std::vector<uint32_t> descriptionIds;    // local to descriptions
+    std::vector<uint64_t> keys;              // RowKey of each row
+    std::vector<uint64_t> descriptionHashes; // by local description id
+    StringTable categoryNames;
+    StringTable descriptions;
+    size_t skipped = 0;
+};
+
+const int maxStatementFields = 32;
+
+// Identity of a row for deduplication; category is left out because the
+// bank does not know it.
+uint64_t RowKey(int date, int64_t paise, uint64_t descriptionHash) {
+    uint64_t key = descriptionHash ^ ((uint64_t)(uint32_t)date * 0x9e3779b97f4a7c15ull);
+    key = (key ^ (key >> 31)) * 0xbf58476d1ce4e5b9ull;
+    key ^= (uint64_t)paise * 0x94d049bb133111ebull;
+    key = (key ^ (key >> 29)) * 0xbf58476d1ce4e5b9ull;
+    return key ^ (key >> 32);
+}
+
+// Splits one line into fields. Quoted fields may contain the separator;
+// the quotes are kept and removed by TrimField.
+int SplitFields(const char* line, const char* lineEnd, char separator,
+                const char** starts, const char** ends) {
+    int count = 0;
+    const char* p = line;
+    while (count < maxStatementFields) {
+        starts[count] = p;
+        bool quoted = false;
+        while (p < lineEnd && (quoted || *p != separator)) {
+            if (*p == '"') quoted = !quoted;
+            p++;
+        }
+        ends[count++] = p;
+        if (p >= lineEnd) break;
+        p++;
+    }
+    return count;
+}
+
+void TrimField(const char*& start, const char*& end) {
+    while (start < end && isspace((unsigned char)*start)) start++;
+    while (end > start && isspace((unsigned char)end[-1])) end--;
+    if (end - start >= 2 && *start == '"' && end[-1] == '"') {
+        start++;
+        end--;
+    }
+}
+
+bool HeaderHas(const std::string& name, const char* const* words) {
+    for (; *words; words++) {
+        if (name.find(*words) != std::string::npos) return true;
+    }
+    return false;
+}
+
+bool DetectColumns(const char* line, const char* lineEnd, StatementColumns& columns) {
+    const char candidates[] = {',', ';', '\t'};
+    size_t best = 0;
+    for (char separator : candidates) {
+        size_t count = std::count(line, lineEnd, separator);
+        if (count > best) {
+            best = count;
+            columns.separator = separator;
+        }
+    }
+    if (best == 0) return false;
+
+    const char* starts[maxStatementFields];
+    const char* ends[maxStatementFields];
+    columns.count = SplitFields(line, lineEnd, columns.separator, starts, ends);
+    static const char* const debitWords[] = {"debit", "withdrawal", "paid out", nullptr};
+    static const char* const creditWords[] = {"credit", "deposit", "paid in", nullptr};
+    static const char* const descriptionWords[] = {"description", "narration", "particulars", "details",
+                                                   "remarks", "memo", "payee", nullptr};
+    for (int i = 0; i < columns.count; i++) {
+        TrimField(starts[i], ends[i]);
+        std::string name(starts[i], ends[i]);
+        for (char& c : name) c = (char)tolower((unsigned char)c);
+
+        if (name.find("balance") != std::string::npos) continue;
+        if ((HeaderHas(name, debitWords) || name == "dr") && columns.debit < 0) columns.debit = i;
+        else if ((HeaderHas(name, creditWords) || name == "cr") && columns.credit < 0) columns.credit = i;
+        else if (name.find("amount") != std::string::npos && columns.amount < 0) columns.amount = i;
+        else if (name.find("date") != std::string::npos && columns.date < 0) columns.date = i;
+        else if (HeaderHas(name, descriptionWords) && columns.description < 0) columns.description = i;
+        else if (name == "category" && columns.category < 0) columns.category = i;
+    }
+    return columns.date >= 0 && (columns.amount >= 0 || columns.debit >= 0 || columns.credit >= 0);
+}
+
+// YYYY-MM-DD, DD/MM/YYYY, DD-MM-YY, DD-Mon-YYYY and the like; anything
+// after the date (a time of day) is ignored.
+bool ParseStatementDate(const char* text, const char* end, int& packedDate) {
+    static const char* const monthNames[] = {"jan", "feb", "mar", "apr", "may", "jun",
+                                             "jul", "aug", "sep", "oct", "nov", "dec"};
+    int parts[3];
+    int digitCounts[3];
+    const char* p = text;
+    for (int part = 0; part < 3; part++) {
+        if (part > 0) {
+            if (p >= end || (*p != '-' && *p != '/' && *p != '.' && *p != ' ')) return false;
+            p++;
+        }
+        int value = 0;
+        int digits = 0;
+        while (p < end && (unsigned)(*p - '0') <= 9 && digits < 4) {
+            value = value * 10 + (*p++ - '0');
+            digits++;
+        }
+        if (digits == 0 && part == 1 && end - p >= 3) {
+            for (int month = 0; month < 12; month++) {
+                if (tolower((unsigned char)p[0]) == monthNames[month][0] &&
+                    tolower((unsigned char)p[1]) == monthNames[month][1] &&
+                    tolower((unsigned char)p[2]) == monthNames[month][2]) {
+                    value = month + 1;
+                    digits = 2;
+                }
+            }
+            if (digits == 0) return false;
+            p += 3;
+            while (p < end && isalpha((unsigned char)*p)) p++;
+        }
+        if (digits == 0) return false;
+        parts[part] = value;
+        digitCounts[part] = digits;
+    }
+
+    int year, month, day;
+    if (digitCounts[0] == 4) {
+        year = parts[0];
+        month = parts[1];
+        day = parts[2];
+    } else {
+        day = parts[0];
+        month = parts[1];
+        year = digitCounts[2] <= 2 ? 2000 + parts[2] : parts[2];
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31) return false;
+    packedDate = PackDate(year, month, day);
+    return true;
+}
+
+// Bank amounts: "1,234.50", "(1,234.50)", "1234.50 Dr", "INR 12.00".
+bool ParseStatementAmount(const char* text, const char* end, int64_t& paise) {
+    char digits[32];
+    size_t length = 0;
+    size_t lastComma = SIZE_MAX; // position in digits
+    bool negative = false;
+    for (const char* p = text; p < end; p++) {
+        char c = *p;
+        if ((unsigned)(c - '0') <= 9 || c == '.') {
+            if (length + 1 >= sizeof(digits)) return false;
+            digits[length++] = c;
+        } else if (c == ',') {
+            lastComma = length;
+        } else if (c == '-' || c == '(') {
+            negative = true;
+        } else if ((c == 'D' || c == 'd') && p + 1 < end && (p[1] == 'R' || p[1] == 'r')) {
+            negative = true;
+        }
+    }
+    // Thousands groups always have three digits, so "12,5" or "12,50" with
+    // no point uses a decimal comma.
+    if (lastComma != SIZE_MAX && length - lastComma <= 2 && memchr(digits, '.', length) == nullptr) {
+        memmove(digits + lastComma + 1, digits + lastComma, length - lastComma);
+        digits[lastComma] = '.';
+        length++;
+    }
+    if (length == 0 || !ParseAmount(digits, length, paise)) return false;
+    if (negative) paise = -paise;
+    return true;
+}
+
+void ParseStatementChunk(const char* begin, const char* end, const StatementColumns& columns,
+                         StatementChunk& chunk) {
+    const char* starts[maxStatementFields];
+    const char* ends[maxStatementFields];
+    std::string description;
+    uint32_t incomeId = chunk.categoryNames.Intern("Income", 6);
+    uint32_t otherId = chunk.categoryNames.Intern("Other", 5);
+    const char* line = begin;
+    while (line < end) {
+        const char* newline = (const char*)memchr(line, '\n', end - line);
+        const char* lineEnd = newline ? newline : end;
+        const char* next = newline ? newline + 1 : end;
+        if (lineEnd > line && lineEnd[-1] == '\r') lineEnd--;
+        if (lineEnd == line) {
+            line = next;
+            continue;
+        }
+
+        int fieldCount = SplitFields(line, lineEnd, columns.separator, starts, ends);
+        auto field = [&](int index, const char*& start, const char*& stop) {
+            if (index < 0 || index >= fieldCount) return false;
+            start = starts[index];
+            stop = ends[index];
+            TrimField(start, stop);
+            return start < stop;
+        };
+
+        const char* start;
+        const char* stop;
+        int packedDate;
+        int64_t paise = 0;
+        bool valid = field(columns.date, start, stop) && ParseStatementDate(start, stop, packedDate);
+        if (valid && columns.amount >= 0) {
+            valid = field(columns.amount, start, stop) && ParseStatementAmount(start, stop, paise);
+        } else if (valid) {
+            int64_t debit = 0;
+            int64_t credit = 0;
+            bool hasDebit = field(columns.debit, start, stop) && ParseStatementAmount(start, stop, debit);
+            bool hasCredit = field(columns.credit, start, stop) && ParseStatementAmount(start, stop, credit);
+            valid = hasDebit || hasCredit;
+            paise = (credit < 0 ? -credit : credit) - (debit < 0 ? -debit : debit);
+        }
+        if (!valid) {
+            chunk.skipped++;
+            line = next;
+            continue;
+        }
+
+        // The last column takes the rest of the line, as the ledger's own
+        // description does, so unquoted commas survive.
+        description.clear();
+        if (columns.description == columns.count - 1 && columns.description < fieldCount) {
+            start = starts[columns.description];
+            stop = lineEnd;
+            TrimField(start, stop);
+            description.assign(start, stop);
+        } else if (field(columns.description, start, stop)) {
+            description.assign(start, stop);
+        }
+        for (size_t i = 0; i < description.size(); i++) {
+            if (description[i] == '"' && i + 1 < description.size() && description[i + 1] == '"') {
+                description.erase(i, 1);
+            }
+        }
+        if (description.empty()) description = "No description";
+
+        uint32_t categoryId;
+        if (field(columns.category, start, stop)) {
+            categoryId = chunk.categoryNames.Intern(start, stop - start);
+        } else {
+            categoryId = paise > 0 ? incomeId : otherId;
+        }
+        if (categoryId >= (uint32_t)maxCategories) categoryId = otherId;
+
+        uint32_t descriptionId = chunk.descriptions.Intern(description.data(), description.size());
+        if (descriptionId == chunk.descriptionHashes.size()) {
+            chunk.descriptionHashes.push_back(HashBytes(description.data(), description.size()));
+        }
+        chunk.dates.push_back(packedDate);
+        chunk.amounts.push_back(paise);
+        chunk.categoryIds.push_back((uint8_t)categoryId);
+        chunk.descriptionIds.push_back(descriptionId);
+        chunk.keys.push_back(RowKey(packedDate, paise, chunk.descriptionHashes[descriptionId]));
+        line = next;
+    }
+}
+
+// Counts of the ledger's rows by RowKey, open-addressed. Only rows dated
+// within the statement's range are added, so the table stays small however
+// large the ledger is.
+struct KeyCounts {
+    std::vector<uint64_t> keys; // 0 = empty
+    std::vector<uint32_t> counts;
+
+    void Reserve(size_t rows) {
+        size_t size = 16;
+        while (size < rows * 2) size *= 2;
+        keys.assign(size, 0);
+        counts.assign(size, 0);
+    }
+    size_t Find(uint64_t key) const {
+        size_t mask = keys.size() - 1;
+        size_t slot = key & mask;
+        while (keys[slot] != 0 && keys[slot] != key) slot = (slot + 1) & mask;
+        return slot;
+    }
+    void Add(uint64_t key) {
+        size_t slot = Find(key | 1);
+        keys[slot] = key | 1;
+        counts[slot]++;
+    }
+    // Uses up one matching ledger row, so a statement that really has two
+    // identical rows keeps the one the ledger does not have yet.
+    bool Take(uint64_t key) {
+        size_t slot = Find(key | 1);
+        if (keys[slot] == 0 || counts[slot] == 0) return false;
+        counts[slot]--;
+        return true;
+    }
+};
+
+ImportStats ImportStatementText(const char* begin, const char* end) {
+    ImportStats stats = {0, 0, 0};
+
+    // The header may follow a few lines of account details.
+    StatementColumns columns;
+    const char* body = nullptr;
+    const char* line = begin;
+    for (int i = 0; i < 50 && line < end && !body; i++) {
+        const char* newline = (const char*)memchr(line, '\n', end - line);
+        const char* lineEnd = newline ? newline : end;
+        columns = StatementColumns();
+        if (DetectColumns(line, lineEnd, columns)) body = newline ? newline + 1 : end;
+        line = newline ? newline + 1 : end;
+    }
+    if (!body) return stats;
+
+    std::vector<const char*> bounds = SplitIntoLineChunks(body, end);
+    std::vector<StatementChunk> chunks(bounds.size() - 1);
+    RunParallel(chunks.size(), [&](size_t i) {
+        ParseStatementChunk(bounds[i], bounds[i + 1], columns, chunks[i]);
+    });
+
+    int firstDate = 99991231;
+    int lastDate = 0;
+    size_t parsedRows = 0;
+    for (const auto& chunk : chunks) {
+        stats.rowsSkipped += chunk.skipped;
+        parsedRows += chunk.dates.size();
+        for (int date : chunk.dates) {
+            firstDate = std::min(firstDate, date);
+            lastDate = std::max(lastDate, date);
+        }
+    }
+    if (parsedRows == 0) return stats;
+
+    KeyCounts existing;
+    RowSpan overlap = GetRowsInDateRange(firstDate, lastDate);
+    existing.Reserve(overlap.size());
+    std::vector<uint64_t> descriptionHashes(transactions.descriptions.Count(), 0); // 0 = not hashed yet
+    for (uint32_t row : overlap) {
+        uint64_t& hash = descriptionHashes[transactions.descriptionIds[row]];
+        if (hash == 0) {
+            const char* text = transactions.descriptions.Get(transactions.descriptionIds[row]);
+            hash = HashBytes(text, strlen(text));
+        }
+        existing.Add(RowKey(transactions.dates[row], transactions.amounts[row], hash));
+    }
+
+    uint32_t firstRow = (uint32_t)transactions.size();
+    for (auto& chunk : chunks) {
+        std::vector<uint8_t> categoryMap(chunk.categoryNames.Count());
+        for (uint32_t id = 0; id < categoryMap.size(); id++) {
+            categoryMap[id] = (uint8_t)GetCategoryId(chunk.categoryNames.Get(id));
+        }
+        std::vector<uint32_t> descriptionMap(chunk.descriptions.Count(), UINT32_MAX);
+        for (size_t i = 0; i < chunk.dates.size(); i++) {
+            if (existing.Take(chunk.keys[i])) {
+                stats.rowsDuplicate++;
+                continue;
+            }
+            uint32_t& descriptionId = descriptionMap[chunk.descriptionIds[i]];
+            if (descriptionId == UINT32_MAX) {
+                const char* text = chunk.descriptions.Get(chunk.descriptionIds[i]);
+                descriptionId = transactions.descriptions.Intern(text, strlen(text));
+            }
+            transactions.dates.push_back(chunk.dates[i]);
+            transactions.categoryIds.push_back(categoryMap[chunk.categoryIds[i]]);
+            transactions.amounts.push_back(chunk.amounts[i]);
+            transactions.descriptionIds.push_back(descriptionId);
+        }
+        chunk = StatementChunk();
+    }
+    uint32_t lastRow = (uint32_t)transactions.size();
+    stats.rowsImported = lastRow - firstRow;
+    if (stats.rowsImported == 0) return stats;
+    if (columns.category < 0) {
+        CategorizeRows(rules, firstRow, lastRow); // the bank only told us credit or debit
+    }
+    AddRowsToIndexes(firstRow);
+
+    // Formatted in parallel, committed as one append.
+    const uint32_t rowsPerPart = 65536;
+    std::vector<std::string> parts((stats.rowsImported + rowsPerPart - 1) / rowsPerPart);
+    RunParallel(parts.size(), [&](size_t part) {
+        uint32_t first = firstRow + (uint32_t)part * rowsPerPart;
+        uint32_t last = std::min(lastRow, first + rowsPerPart);
+        parts[part].reserve((size_t)(last - first) * 48);
+        for (uint32_t row = first; row < last; row++) {
+            AppendCSVRow(parts[part], row);
+        }
+    });
+    std::string lines;
+    size_t bytes = 0;
+    for (const auto& part : parts) bytes += part.size();
+    lines.reserve(bytes);
+    for (const auto& part : parts) lines += part;
+    if (!JournalAppend(lines)) {
+        AppendToLedgerFile(ledgerPath, lines, true, true);
+    }
+    return stats;
+}
+
+ImportStats ImportStatement(const std::string& path) {
+    PROFILE_SCOPE("Import statement");
+    ImportStats stats = {0, 0, 0};
+    MappedFile mapped;
+    if (!OpenMappedFile(path, mapped)) return stats;
+    if (mapped.data) {
+        stats = ImportStatementText(mapped.data, mapped.data + mapped.size);
+    }
+    CloseMappedFile(mapped);
+    return stats;
+}
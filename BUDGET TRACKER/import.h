@@ -0,0 +1,29 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+// Bulk import of bank statement exports. The file is parsed on every core,
+// each row is normalized to the ledger's date, category, amount and
+// description, rows the ledger already has are dropped by a hash of
+// (date, amount, description), and the rest are added to the store and
+// written to the CSV with a single append.
+//
+// Columns come from the header row, which may follow a few lines of account
+// details: a date column, a description (or narration, particulars, ...)
+// column, and either one amount column or separate debit and credit
+// columns. A category column is used when present, so files in the
+// ledger's own format import as well; otherwise rows are categorized by
+// the loaded rules (rules.h), falling back to Income for credits and Other
+// for debits.
+
+#include "ledger.h"
+
+struct ImportStats {
+    size_t rowsImported;
+    size_t rowsDuplicate; // already in the ledger
+    size_t rowsSkipped;   // no usable date or amount
+};
+
+ImportStats ImportStatement(const std::string& path);
+ImportStats ImportStatementText(const char* begin, const char* end);
+
+#endif
@@ -0,0 +1,358 @@
+#include "journal.h"
+#include "profile.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+const char* csvHeader = "Date,Category,Amount,Description\r\n";
+const char* csvNewline = "\r\n";
+#else
+const char* csvHeader = "Date,Category,Amount,Description\n";
+const char* csvNewline = "\n";
+#endif
+
+// An append-mode file handle that stays open across batches.
+struct AppendFile {
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    bool IsOpen() const { return handle != INVALID_HANDLE_VALUE; }
+#else
+    int fd = -1;
+    bool IsOpen() const { return fd >= 0; }
+#endif
+};
+
+bool WriteAppendFile(AppendFile& file, const char* data, size_t length) {
+    while (length > 0) {
+#ifdef _WIN32
+        DWORD written = 0;
+        DWORD chunk = length > (1u << 30) ? (1u << 30) : (DWORD)length;
+        if (!WriteFile(file.handle, data, chunk, &written, nullptr)) return false;
+#else
+        ssize_t written = write(file.fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+#endif
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+bool OpenAppendFile(const std::string& path, AppendFile& file) {
+#ifdef _WIN32
+    // LockFileEx needs read or write access; FILE_APPEND_DATA alone is neither.
+    file.handle = CreateFileA(path.c_str(), FILE_APPEND_DATA | GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+    file.fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+#endif
+    return file.IsOpen();
+}
+
+// Advisory lock held around each append, so another writer that takes it
+// too (a second instance, or a script run under flock) never interleaves a
+// partial line with ours. Windows locks are mandatory, so there a byte far
+// past any real file size stands in for the whole file.
+void LockAppendFile(AppendFile& file, bool locked) {
+#ifdef _WIN32
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = 0xFFFFFFFE;
+    overlapped.OffsetHigh = 0x7FFFFFFF;
+    if (locked) {
+        LockFileEx(file.handle, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped);
+    } else {
+        UnlockFileEx(file.handle, 0, 1, 0, &overlapped);
+    }
+#else
+    while (flock(file.fd, locked ? LOCK_EX : LOCK_UN) != 0 && errno == EINTR) {
+    }
+#endif
+}
+
+// Cuts the file back to `size` bytes, dropping what a failed write left.
+bool TruncateAppendFile(AppendFile& file, long long size) {
+#ifdef _WIN32
+    // The append handle cannot move the end of the file; a second one can.
+    HANDLE writable = ReOpenFile(file.handle, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0);
+    if (writable == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER end;
+    end.QuadPart = size;
+    bool ok = SetFilePointerEx(writable, end, nullptr, FILE_BEGIN) && SetEndOfFile(writable);
+    CloseHandle(writable);
+    return ok;
+#else
+    while (ftruncate(file.fd, size) != 0) {
+        if (errno != EINTR) return false;
+    }
+    return true;
+#endif
+}
+
+// Appends `lines` under the lock, after the header if the file is empty.
+// `offset` and `length` receive where in the file the bytes went. A write
+// cut short (the disk filling up) is cut back out before the lock goes, so
+// the retry does not land part of the batch twice.
+bool WriteLedgerBatch(AppendFile& file, const std::string& lines, uint64_t& offset, uint64_t& length) {
+    LockAppendFile(file, true);
+    long long size = 0;
+    bool sized = false;
+#ifdef _WIN32
+    LARGE_INTEGER fileSize;
+    sized = GetFileSizeEx(file.handle, &fileSize) != 0;
+    if (sized) size = fileSize.QuadPart;
+#else
+    struct stat info;
+    sized = fstat(file.fd, &info) == 0;
+    if (sized) size = info.st_size;
+#endif
+    bool ok = true;
+    length = 0;
+    if (size == 0) {
+        length = strlen(csvHeader);
+        ok = WriteAppendFile(file, csvHeader, length);
+    }
+    ok = ok && WriteAppendFile(file, lines.data(), lines.size());
+    if (!ok && sized) TruncateAppendFile(file, size);
+    LockAppendFile(file, false);
+    offset = (uint64_t)size;
+    length += lines.size();
+    return ok;
+}
+
+void SyncAppendFile(AppendFile& file) {
+#ifdef _WIN32
+    FlushFileBuffers(file.handle);
+#else
+    fsync(file.fd);
+#endif
+}
+
+void CloseAppendFile(AppendFile& file) {
+#ifdef _WIN32
+    if (file.IsOpen()) CloseHandle(file.handle);
+    file.handle = INVALID_HANDLE_VALUE;
+#else
+    if (file.IsOpen()) close(file.fd);
+    file.fd = -1;
+#endif
+}
+
+// Writer state. `queued` is filled by JournalAppend under the mutex; the
+// writer swaps it with its own empty buffer, so appends never wait on I/O.
+std::mutex journalMutex;
+std::condition_variable journalWake;
+std::condition_variable journalDrained;
+std::thread journalThread;
+std::string journalPath;
+std::string queued;
+FsyncPolicy journalPolicy = FSYNC_INTERVAL;
+int journalIntervalMs = 1000;
+unsigned long long queuedBatches = 0;  // bumped by every JournalAppend
+unsigned long long writtenBatches = 0; // queuedBatches value at the last completed write
+bool journalRunning = false;
+bool journalStopping = false;
+bool journalFailed = false; // the last write failed; its batch is kept and retried
+bool journalWriting = false; // the writer holds a batch not yet in the file
+const int journalRetryMs = 1000;
+std::vector<JournalWrite> journalWrites; // since the last TakeJournalWrites
+
+void RecordJournalWrite(const JournalWrite& written) {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    journalWrites.push_back(written);
+}
+
+bool AppendToLedgerFile(const std::string& path, const std::string& lines, bool sync, bool own) {
+    AppendFile file;
+    if (!OpenAppendFile(path, file)) return false;
+    JournalWrite written = {0, 0};
+    bool ok = WriteLedgerBatch(file, lines, written.offset, written.length);
+    if (ok && sync) SyncAppendFile(file);
+    CloseAppendFile(file);
+    if (ok && own) RecordJournalWrite(written);
+    return ok;
+}
+
+void JournalWriterLoop() {
+    using Clock = std::chrono::steady_clock;
+    AppendFile file;
+    std::string writing;
+    bool unsynced = false;
+    Clock::time_point lastSync = Clock::now();
+
+    std::unique_lock<std::mutex> lock(journalMutex);
+    for (;;) {
+        if (queued.empty() && !journalStopping) {
+            if (!writing.empty()) {
+                journalWake.wait_for(lock, std::chrono::milliseconds(journalRetryMs));
+            } else if (unsynced && journalPolicy == FSYNC_INTERVAL) {
+                journalWake.wait_until(lock, lastSync + std::chrono::milliseconds(journalIntervalMs));
+            } else {
+                journalWake.wait(lock);
+            }
+        }
+
+        bool stopping = journalStopping;
+        unsigned long long batch = queuedBatches;
+        if (writing.empty()) {
+            writing.swap(queued);
+        } else {
+            writing += queued; // after the batch whose write failed
+            queued.clear();
+        }
+        journalWriting = !writing.empty();
+        lock.unlock();
+
+        JournalWrite written = {0, 0};
+        bool failed = false;
+        if (!writing.empty()) {
+            PROFILE_SCOPE("Journal write");
+            if (!file.IsOpen()) OpenAppendFile(journalPath, file);
+            if (file.IsOpen() && WriteLedgerBatch(file, writing, written.offset, written.length)) {
+                unsynced = true;
+                writing.clear();
+                lock.lock(); // readers of the file need not wait for the fsync
+                journalWrites.push_back(written);
+                journalWriting = false;
+                lock.unlock();
+            } else {
+                failed = true;
+                CloseAppendFile(file); // opened again for the retry
+            }
+        }
+        bool syncDue = journalPolicy == FSYNC_EVERY_COMMIT || stopping ||
+                       (journalPolicy == FSYNC_INTERVAL &&
+                        Clock::now() - lastSync >= std::chrono::milliseconds(journalIntervalMs));
+        if (unsynced && syncDue && journalPolicy != FSYNC_NEVER && file.IsOpen()) {
+            PROFILE_SCOPE("Journal fsync");
+            SyncAppendFile(file);
+            unsynced = false;
+            lastSync = Clock::now();
+        }
+
+        lock.lock();
+        if (!failed) writtenBatches = batch;
+        journalFailed = failed;
+        journalDrained.notify_all();
+        if (stopping && (queued.empty() || failed)) break; // a last failure at exit gives up
+    }
+    journalWriting = false;
+    lock.unlock();
+    CloseAppendFile(file);
+}
+
+void StartJournal(const std::string& path, FsyncPolicy policy, int intervalMs) {
+    StopJournal();
+    std::lock_guard<std::mutex> lock(journalMutex);
+    journalPath = path;
+    journalPolicy = policy;
+    journalIntervalMs = intervalMs > 0 ? intervalMs : 1;
+    journalStopping = false;
+    journalRunning = true;
+    journalThread = std::thread(JournalWriterLoop);
+}
+
+bool JournalAppend(const std::string& lines) {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if (!journalRunning) return false;
+    queued += lines;
+    queuedBatches++;
+    journalWake.notify_one();
+    return true;
+}
+
+bool FlushJournal() {
+    std::unique_lock<std::mutex> lock(journalMutex);
+    if (!journalRunning) return !journalFailed;
+    unsigned long long target = queuedBatches;
+    journalWake.notify_one();
+    journalDrained.wait(lock, [target]() { return writtenBatches >= target || journalFailed; });
+    return writtenBatches >= target;
+}
+
+void StopJournal() {
+    {
+        std::lock_guard<std::mutex> lock(journalMutex);
+        if (!journalRunning) return;
+        journalStopping = true;
+        journalWake.notify_one();
+    }
+    journalThread.join();
+    std::lock_guard<std::mutex> lock(journalMutex);
+    journalRunning = false;
+    journalStopping = false;
+}
+
+void ReopenJournal() {
+    // The writer keeps its handle open, which would still point at the
+    // replaced file; a fresh writer opens the path again on its first batch.
+    if (!IsJournalRunning()) return;
+    StopJournal();
+    StartJournal(journalPath, journalPolicy, journalIntervalMs);
+}
+
+bool TakeJournalWrites(std::vector<JournalWrite>& writes) {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    writes.insert(writes.end(), journalWrites.begin(), journalWrites.end());
+    journalWrites.clear();
+    return !journalRunning || (queued.empty() && !journalWriting);
+}
+
+AppendFile lockedLedger; // held by LockLedgerFile
+
+bool LockLedgerFile(const std::string& path) {
+    if (!OpenAppendFile(path, lockedLedger)) return false;
+    LockAppendFile(lockedLedger, true);
+    return true;
+}
+
+void UnlockLedgerFile() {
+    if (!lockedLedger.IsOpen()) return;
+    LockAppendFile(lockedLedger, false);
+    CloseAppendFile(lockedLedger);
+}
+
+bool JournalWriteFailed() {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    return journalFailed;
+}
+
+bool IsJournalRunning() {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    return journalRunning;
+}
+
+bool ParseFsyncPolicy(const char* text, FsyncPolicy& policy, int& intervalMs) {
+    if (strcmp(text, "commit") == 0) {
+        policy = FSYNC_EVERY_COMMIT;
+        return true;
+    }
+    if (strcmp(text, "never") == 0) {
+        policy = FSYNC_NEVER;
+        return true;
+    }
+    char* end = nullptr;
+    long value = strtol(text, &end, 10);
+    if (end == text || value <= 0 || (strcmp(end, "ms") != 0 && *end != '\0')) return false;
+    policy = FSYNC_INTERVAL;
+    intervalMs = (int)value;
+    return true;
+}
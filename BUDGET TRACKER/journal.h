@@ -0,0 +1,60 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+// Append journal for transactions.csv. Callers queue complete CSV lines and
+// return immediately; a writer thread takes everything queued so far and
+// appends it with a single write, so a burst of rows costs one write (and
+// at most one fsync) instead of an open/append/close per row. Every append
+// holds an advisory lock on the file (flock, or LockFileEx on Windows), so
+// other writers that take it never split one of our lines or we theirs.
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+enum FsyncPolicy {
+    FSYNC_EVERY_COMMIT, // fsync after every batch write
+    FSYNC_INTERVAL,     // fsync at most every intervalMs
+    FSYNC_NEVER         // leave it to the OS
+};
+
+extern const char* csvHeader;  // "Date,Category,Amount,Description" + newline
+extern const char* csvNewline; // what text-mode ofstream wrote on this platform
+
+void StartJournal(const std::string& path, FsyncPolicy policy, int intervalMs);
+bool JournalAppend(const std::string& lines); // false if no journal is running
+// Waits until everything queued so far has been written; false, without
+// waiting further, if a write failed.
+bool FlushJournal();
+void StopJournal();  // drain the queue, sync and join the writer
+void ReopenJournal(); // restart with the same settings after the ledger file was replaced
+bool IsJournalRunning();
+// The last write failed. Whatever part of the batch reached the file is
+// cut back out; the writer keeps the batch and retries it every second,
+// and gives it up only when stopped.
+bool JournalWriteFailed();
+
+struct JournalWrite {
+    uint64_t offset; // where in the ledger file the batch went
+    uint64_t length;
+};
+// Adds the writer's batches since the last call to `writes`, in file
+// order, so a reader of the file can tell its own rows from rows other
+// programs appended. Returns false, without waiting, while a queued batch
+// has yet to reach the file. Batches are reported once written, before
+// any fsync.
+bool TakeJournalWrites(std::vector<JournalWrite>& writes);
+// Holds the append lock on `path` until UnlockLedgerFile, so the file can be
+// replaced without losing a line another program is appending. The writer
+// takes the same lock, so flush the journal first and queue nothing meanwhile.
+bool LockLedgerFile(const std::string& path);
+void UnlockLedgerFile();
+
+bool ParseFsyncPolicy(const char* text, FsyncPolicy& policy, int& intervalMs); // "commit", "never" or "<N>ms"
+
+// Appends to `path` synchronously, writing the header first if the file is
+// new or empty. Used when no journal is running; `own` lines are rows the
+// store holds, and TakeJournalWrites reports them like the writer's.
+bool AppendToLedgerFile(const std::string& path, const std::string& lines, bool sync, bool own = false);
+
+#endif
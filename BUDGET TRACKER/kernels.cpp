@@ -0,0 +1,137 @@
+#include "kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+void AggregateScalar(const int* dates, const int64_t* amounts, const uint8_t* categoryIds,
+                     size_t count, int firstDate, int lastDate, MonthSummary& totals) {
+    int64_t income = 0;
+    int64_t expense = 0;
+    for (size_t i = 0; i < count; i++) {
+        int64_t amount = (dates[i] >= firstDate && dates[i] <= lastDate) ? amounts[i] : 0;
+        int64_t spent = amount < 0 ? -amount : 0;
+        income += amount > 0 ? amount : 0;
+        expense += spent;
+        totals.categoryExpense[categoryIds[i]] += spent;
+    }
+    totals.income += income;
+    totals.expense += expense;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+__attribute__((target("sse4.2")))
+void AggregateSSE42(const int* dates, const int64_t* amounts, const uint8_t* categoryIds,
+                    size_t count, int firstDate, int lastDate, MonthSummary& totals) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i before = _mm_set1_epi32(firstDate);
+    const __m128i after = _mm_set1_epi32(lastDate);
+    __m128i income = zero;
+    __m128i expense = zero;
+    alignas(16) int64_t spent[2];
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128i date = _mm_loadl_epi64((const __m128i*)(dates + i));
+        __m128i outside = _mm_or_si128(_mm_cmplt_epi32(date, before), _mm_cmpgt_epi32(date, after));
+        __m128i amount = _mm_andnot_si128(_mm_cvtepi32_epi64(outside), _mm_loadu_si128((const __m128i*)(amounts + i)));
+
+        __m128i positive = _mm_cmpgt_epi64(amount, zero);
+        __m128i negative = _mm_cmpgt_epi64(zero, amount);
+        __m128i outgoing = _mm_and_si128(_mm_sub_epi64(zero, amount), negative);
+        income = _mm_add_epi64(income, _mm_and_si128(amount, positive));
+        expense = _mm_add_epi64(expense, outgoing);
+
+        _mm_store_si128((__m128i*)spent, outgoing);
+        totals.categoryExpense[categoryIds[i]] += spent[0];
+        totals.categoryExpense[categoryIds[i + 1]] += spent[1];
+    }
+
+    alignas(16) int64_t lanes[2];
+    _mm_store_si128((__m128i*)lanes, income);
+    totals.income += lanes[0] + lanes[1];
+    _mm_store_si128((__m128i*)lanes, expense);
+    totals.expense += lanes[0] + lanes[1];
+
+    AggregateScalar(dates + i, amounts + i, categoryIds + i, count - i, firstDate, lastDate, totals);
+}
+
+__attribute__((target("avx2")))
+void AggregateAVX2(const int* dates, const int64_t* amounts, const uint8_t* categoryIds,
+                   size_t count, int firstDate, int lastDate, MonthSummary& totals) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m128i before = _mm_set1_epi32(firstDate);
+    const __m128i after = _mm_set1_epi32(lastDate);
+    __m256i income = zero;
+    __m256i expense = zero;
+    alignas(32) int64_t spent[4];
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i date = _mm_loadu_si128((const __m128i*)(dates + i));
+        __m128i outside = _mm_or_si128(_mm_cmplt_epi32(date, before), _mm_cmpgt_epi32(date, after));
+        __m256i amount = _mm256_andnot_si256(_mm256_cvtepi32_epi64(outside),
+                                             _mm256_loadu_si256((const __m256i*)(amounts + i)));
+
+        __m256i positive = _mm256_cmpgt_epi64(amount, zero);
+        __m256i negative = _mm256_cmpgt_epi64(zero, amount);
+        __m256i outgoing = _mm256_and_si256(_mm256_sub_epi64(zero, amount), negative);
+        income = _mm256_add_epi64(income, _mm256_and_si256(amount, positive));
+        expense = _mm256_add_epi64(expense, outgoing);
+
+        // Scatter is scalar; the histogram has at most a few hundred entries
+        // and stays in L1.
+        _mm256_store_si256((__m256i*)spent, outgoing);
+        totals.categoryExpense[categoryIds[i]] += spent[0];
+        totals.categoryExpense[categoryIds[i + 1]] += spent[1];
+        totals.categoryExpense[categoryIds[i + 2]] += spent[2];
+        totals.categoryExpense[categoryIds[i + 3]] += spent[3];
+    }
+
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256((__m256i*)lanes, income);
+    totals.income += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_store_si256((__m256i*)lanes, expense);
+    totals.expense += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    AggregateScalar(dates + i, amounts + i, categoryIds + i, count - i, firstDate, lastDate, totals);
+}
+
+bool IsKernelSupported(AggregateKernel kernel) {
+    if (kernel == AggregateAVX2) return __builtin_cpu_supports("avx2");
+    if (kernel == AggregateSSE42) return __builtin_cpu_supports("sse4.2");
+    return true;
+}
+
+#else
+
+void AggregateSSE42(const int* dates, const int64_t* amounts, const uint8_t* categoryIds,
+                    size_t count, int firstDate, int lastDate, MonthSummary& totals) {
+    AggregateScalar(dates, amounts, categoryIds, count, firstDate, lastDate, totals);
+}
+
+void AggregateAVX2(const int* dates, const int64_t* amounts, const uint8_t* categoryIds,
+                   size_t count, int firstDate, int lastDate, MonthSummary& totals) {
+    AggregateScalar(dates, amounts, categoryIds, count, firstDate, lastDate, totals);
+}
+
+bool IsKernelSupported(AggregateKernel kernel) {
+    return kernel == AggregateScalar;
+}
+
+#endif
+
+AggregateKernel GetAggregateKernel() {
+    static AggregateKernel best = IsKernelSupported(AggregateAVX2) ? AggregateAVX2
+                                : IsKernelSupported(AggregateSSE42) ? AggregateSSE42
+                                : AggregateScalar;
+    return best;
+}
+
+const char* GetAggregateKernelName(AggregateKernel kernel) {
+    if (kernel == AggregateAVX2) return "avx2";
+    if (kernel == AggregateSSE42) return "sse4.2";
+    return "scalar";
+}
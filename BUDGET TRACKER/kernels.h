@@ -0,0 +1,27 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+// Fused aggregation over the ledger columns. One pass over the date,
+// amount and category columns produces income, expense and the
+// per-category expense histogram for rows whose date lies in
+// [firstDate, lastDate]. The SSE4.2/AVX2 variants are picked at runtime and
+// give exactly the same integers as the scalar one.
+
+#include "ledger.h"
+
+typedef void (*AggregateKernel)(const int* dates, const int64_t* amounts, const uint8_t* categoryIds,
+                                size_t count, int firstDate, int lastDate, MonthSummary& totals);
+
+// Adds into `totals`; callers zero it first.
+void AggregateScalar(const int* dates, const int64_t* amounts, const uint8_t* categoryIds,
+                     size_t count, int firstDate, int lastDate, MonthSummary& totals);
+void AggregateSSE42(const int* dates, const int64_t* amounts, const uint8_t* categoryIds,
+                    size_t count, int firstDate, int lastDate, MonthSummary& totals);
+void AggregateAVX2(const int* dates, const int64_t* amounts, const uint8_t* categoryIds,
+                   size_t count, int firstDate, int lastDate, MonthSummary& totals);
+
+bool IsKernelSupported(AggregateKernel kernel);
+AggregateKernel GetAggregateKernel(); // best kernel for this CPU
+const char* GetAggregateKernelName(AggregateKernel kernel);
+
+#endif
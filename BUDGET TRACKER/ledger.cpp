@@ -0,0 +1,1209 @@
+#include "ledger.h"
+#include "kernels.h"
+#include "journal.h"
+#include "search.h"
+#include "rollup.h"
+#include "table.h"
+#include "budget.h"
+#include "profile.h"
+#include <algorithm>
+#include <numeric>
+#include <iterator>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+TransactionStore transactions;
+uint64_t ledgerVersion = 0;
+bool buildBrowseIndexes = true;
+std::vector<std::string> categories = {"Food", "Housing", "Transportation", "Entertainment",
+                                     "Utilities", "Healthcare", "Education", "Shopping",
+                                     "Savings", "Other", "Income"};
+std::string ledgerPath = "transactions.csv";
+uint64_t ledgerLoadedBytes = 0;
+uint64_t ledgerLoadedFingerprint = 0;
+
+bool RowDateLess(uint32_t a, uint32_t b) {
+    int dateA = transactions.dates[a];
+    int dateB = transactions.dates[b];
+    return dateA < dateB || (dateA == dateB && a < b);
+}
+
+RowOrder dateOrder = {RowDateLess, {}, {}, {}};
+bool rowsInDateOrder = true; // dateOrder is the identity permutation
+
+std::unordered_map<int, MonthSummary> monthSummaries; // key: year * 12 + month
+const MonthSummary emptyMonthSummary = {};
+
+LoadProgress loadProgress = {{0}, {0}, {0}, {0}, {false}, 1, 0};
+
+void ResetLoadProgress(int focusFirstDate, int focusLastDate) {
+    loadProgress.bytesTotal = 0;
+    loadProgress.bytesDone = 0;
+    loadProgress.focusIncome = 0;
+    loadProgress.focusExpense = 0;
+    loadProgress.focusExact = false;
+    loadProgress.focusFirstDate = focusFirstDate;
+    loadProgress.focusLastDate = focusLastDate;
+}
+
+bool OpenMappedFile(const std::string& path, MappedFile& mapped) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return size.QuadPart == 0;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file); // the mapping keeps the file open
+    if (!mapping) return false;
+    mapped.mapping = mapping;
+    mapped.data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    mapped.size = (size_t)size.QuadPart;
+    return mapped.data != nullptr;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    mapped.size = (size_t)info.st_size;
+    if (mapped.size > 0) {
+        void* data = mmap(nullptr, mapped.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            mapped.size = 0;
+            return false;
+        }
+        madvise(data, mapped.size, MADV_SEQUENTIAL);
+        mapped.data = (const char*)data;
+    }
+    close(fd);
+    return true;
+#endif
+}
+
+void CloseMappedFile(MappedFile& mapped) {
+#ifdef _WIN32
+    if (mapped.data) UnmapViewOfFile(mapped.data);
+    if (mapped.mapping) CloseHandle((HANDLE)mapped.mapping);
+    mapped.mapping = nullptr;
+#else
+    if (mapped.data) munmap((void*)mapped.data, mapped.size);
+#endif
+    mapped.data = nullptr;
+    mapped.size = 0;
+}
+
+int DaysInMonth(int year, int month) {
+    const int monthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return monthDays[month - 1] + (month == 2 && leap ? 1 : 0);
+}
+
+bool ParseDate(const char* text, size_t length, int& packedDate) {
+    // YYYY-MM-DD, or with the month or day unpadded (2024-1-6) as files
+    // written by hand and older exports have them.
+    const char* p = text;
+    const char* end = text + length;
+    int fields[3] = {0, 0, 0};
+    const int maxDigits[3] = {4, 2, 2};
+    for (int field = 0; field < 3; field++) {
+        if (field > 0 && (p == end || *p++ != '-')) return false;
+        int digits = 0;
+        while (p < end && (unsigned)(*p - '0') <= 9 && digits < maxDigits[field]) {
+            fields[field] = fields[field] * 10 + (*p++ - '0');
+            digits++;
+        }
+        if (digits == 0 || (field == 0 && digits != 4)) return false;
+    }
+    int year = fields[0];
+    int month = fields[1];
+    int day = fields[2];
+    if (p != end || month < 1 || month > 12 || day < 1 || day > DaysInMonth(year, month)) return false;
+    packedDate = year * 10000 + month * 100 + day;
+    return true;
+}
+
+// What std::stof, which the first versions read amounts with, takes
+// beyond ParseAmount's own form: exponents, tabs, text after the number.
+bool ParseAmountLikeStof(const char* text, size_t length, int64_t& paise) {
+    char buffer[64];
+    length = std::min(length, sizeof(buffer) - 1); // strtod stops at the number anyway
+    memcpy(buffer, text, length);
+    buffer[length] = '\0';
+    char* end = nullptr;
+    double value = strtod(buffer, &end);
+    if (end == buffer || !std::isfinite(value) || std::fabs(value) >= 1e15) return false;
+    paise = llround(value * 100.0);
+    return true;
+}
+
+bool ParseAmount(const char* text, size_t length, int64_t& paise) {
+    // [spaces][+-]digits[.digits][spaces], which covers everything
+    // SaveTransactionToCSV writes, exactly. Rounds half away from zero to
+    // paise. Anything else goes to ParseAmountLikeStof.
+    const char* p = text;
+    const char* end = text + length;
+    while (p < end && *p == ' ') p++;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    int64_t rupees = 0;
+    int digitCount = 0;
+    while (p < end && (unsigned)(*p - '0') <= 9) {
+        if (digitCount >= 16) return ParseAmountLikeStof(text, length, paise);
+        rupees = rupees * 10 + (*p - '0');
+        digitCount++;
+        p++;
+    }
+    int64_t fraction = 0;
+    if (p < end && *p == '.') {
+        p++;
+        int fractionDigits = 0;
+        while (p < end && (unsigned)(*p - '0') <= 9) {
+            if (fractionDigits < 3) fraction = fraction * 10 + (*p - '0');
+            fractionDigits++;
+            digitCount++;
+            p++;
+        }
+        if (fractionDigits == 1) fraction *= 100;
+        else if (fractionDigits == 2) fraction *= 10;
+    }
+    if (digitCount == 0) return ParseAmountLikeStof(text, length, paise);
+    while (p < end && *p == ' ') p++;
+    if (p != end) return ParseAmountLikeStof(text, length, paise);
+
+    int64_t value = rupees * 100 + (fraction + 5) / 10;
+    paise = negative ? -value : value;
+    return true;
+}
+
+int PackDate(int year, int month, int day) {
+    return year * 10000 + month * 100 + day;
+}
+
+const char* FormatDate(int packedDate, char* buffer) {
+    int year = packedDate / 10000;
+    int month = packedDate / 100 % 100;
+    int day = packedDate % 100;
+    buffer[0] = (char)('0' + year / 1000 % 10);
+    buffer[1] = (char)('0' + year / 100 % 10);
+    buffer[2] = (char)('0' + year / 10 % 10);
+    buffer[3] = (char)('0' + year % 10);
+    buffer[4] = '-';
+    buffer[5] = (char)('0' + month / 10);
+    buffer[6] = (char)('0' + month % 10);
+    buffer[7] = '-';
+    buffer[8] = (char)('0' + day / 10);
+    buffer[9] = (char)('0' + day % 10);
+    buffer[10] = '\0';
+    return buffer;
+}
+
+const char* FormatAmount(int64_t paise, char* buffer) {
+    char digits[24];
+    uint64_t magnitude = paise < 0 ? (uint64_t)-paise : (uint64_t)paise;
+    int length = 0;
+    do {
+        digits[length++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+        if (length == 2) digits[length++] = '.';
+    } while (magnitude > 0 || length < 4);
+
+    char* out = buffer;
+    if (paise < 0) *out++ = '-';
+    while (length > 0) *out++ = digits[--length];
+    *out = '\0';
+    return buffer;
+}
+
+uint64_t HashBytes(const char* text, size_t length) {
+    uint64_t hash = 1469598103934665603ull; // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)text[i]) * 1099511628211ull;
+    }
+    return hash ^ (hash >> 29);
+}
+
+uint64_t FingerprintCSV(const char* data, uint64_t length) {
+    const uint64_t fingerprintBytes = 4096;
+    uint64_t start = length > fingerprintBytes ? length - fingerprintBytes : 0;
+    return HashBytes(data + start, length - start) ^ length;
+}
+
+uint32_t StringTable::Intern(const char* text, size_t length) {
+    if (offsets.size() * 2 >= slots.size()) {
+        // Grow to keep the load factor under 1/2; rehash from the arena.
+        std::vector<uint32_t> grown(slots.empty() ? 64 : slots.size() * 2, 0);
+        size_t mask = grown.size() - 1;
+        for (uint32_t id = 0; id < offsets.size(); id++) {
+            const char* stored = Get(id);
+            size_t slot = HashBytes(stored, strlen(stored)) & mask;
+            while (grown[slot] != 0) slot = (slot + 1) & mask;
+            grown[slot] = id + 1;
+        }
+        slots.swap(grown);
+    }
+
+    size_t mask = slots.size() - 1;
+    size_t slot = HashBytes(text, length) & mask;
+    while (slots[slot] != 0) {
+        const char* stored = Get(slots[slot] - 1);
+        if (strncmp(stored, text, length) == 0 && stored[length] == '\0') {
+            return slots[slot] - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    uint32_t id = (uint32_t)offsets.size();
+    offsets.push_back((uint32_t)arena.size());
+    arena.append(text, length);
+    arena.push_back('\0');
+    slots[slot] = id + 1;
+    return id;
+}
+
+size_t StringTable::MemoryUsage() const {
+    return arena.capacity() + offsets.capacity() * sizeof(uint32_t) + slots.capacity() * sizeof(uint32_t);
+}
+
+void StringTable::Clear() {
+    arena.clear();
+    offsets.clear();
+    slots.clear();
+}
+
+void TransactionStore::clear() {
+    dates.clear();
+    categoryIds.clear();
+    amounts.clear();
+    descriptionIds.clear();
+    descriptions.Clear();
+    deleted.clear();
+    deletedCount = 0;
+    recordLines = 0;
+    fileRowIds.clear();
+    fileRowBase = 0;
+}
+
+// An update or delete record from the CSV, with chunk-local ids like the rows.
+struct LedgerRecord {
+    uint32_t fileRow;
+    bool remove;
+    int date;
+    uint8_t categoryId;
+    int64_t amount;
+    uint32_t descriptionId;
+};
+
+struct ParsedChunk {
+    std::vector<int> dates;
+    std::vector<uint8_t> categoryIds;     // local to this chunk's categoryNames
+    std::vector<int64_t> amounts;
+    std::vector<uint32_t> descriptionIds; // local to this chunk's descriptions
+    StringTable categoryNames;
+    StringTable descriptions;
+    std::vector<LedgerRecord> records;
+    size_t skipped = 0;
+    bool keepSkipped = false;
+    std::string skippedLines; // the skipped lines verbatim, if keepSkipped
+};
+
+// Lines the loader skips carry no file row id, so a rewrite of the ledger
+// can carry them over anywhere without renumbering its records.
+void SkipLine(ParsedChunk& chunk, const char* line, const char* next, const char* end) {
+    chunk.skipped++;
+    if (!chunk.keepSkipped) return;
+    if (next > end) {
+        chunk.skippedLines.append(line, end);
+        chunk.skippedLines += csvNewline;
+    } else {
+        chunk.skippedLines.append(line, next);
+    }
+}
+
+// Date, category, amount and optional description from [line, lineEnd),
+// interning the names into the chunk's tables.
+bool ParseCSVFields(const char* line, const char* lineEnd, ParsedChunk& chunk, int& packedDate, uint8_t& categoryId,
+                    int64_t& paise, uint32_t& descriptionId) {
+    const char* comma1 = (const char*)memchr(line, ',', lineEnd - line);
+    const char* comma2 = comma1 ? (const char*)memchr(comma1 + 1, ',', lineEnd - comma1 - 1) : nullptr;
+    const char* amountEnd = comma2 ? (const char*)memchr(comma2 + 1, ',', lineEnd - comma2 - 1) : nullptr;
+    if (comma2 && !amountEnd) amountEnd = lineEnd; // description is optional
+
+    if (!comma2 || !ParseDate(line, comma1 - line, packedDate) ||
+        !ParseAmount(comma2 + 1, amountEnd - comma2 - 1, paise)) {
+        return false;
+    }
+    uint32_t category = chunk.categoryNames.Intern(comma1 + 1, comma2 - comma1 - 1);
+    if (category >= (uint32_t)maxCategories) {
+        category = chunk.categoryNames.Intern("Other", 5);
+    }
+    const char* description = amountEnd < lineEnd ? amountEnd + 1 : lineEnd;
+    categoryId = (uint8_t)category;
+    descriptionId = chunk.descriptions.Intern(description, lineEnd - description);
+    return true;
+}
+
+// "#update,<id>,<row fields>" or "#delete,<id>".
+bool ParseRecord(const char* line, const char* lineEnd, ParsedChunk& chunk, LedgerRecord& record) {
+    const char* p = line;
+    if (lineEnd - p > 8 && memcmp(p, "#update,", 8) == 0) {
+        record.remove = false;
+        p += 8;
+    } else if (lineEnd - p > 8 && memcmp(p, "#delete,", 8) == 0) {
+        record.remove = true;
+        p += 8;
+    } else {
+        return false;
+    }
+    uint64_t fileRow = 0;
+    const char* digits = p;
+    while (p < lineEnd && (unsigned)(*p - '0') <= 9 && fileRow < UINT32_MAX) fileRow = fileRow * 10 + (*p++ - '0');
+    if (p == digits || fileRow >= UINT32_MAX) return false;
+    record.fileRow = (uint32_t)fileRow;
+    if (record.remove) return p == lineEnd;
+    return p < lineEnd && *p == ',' &&
+           ParseCSVFields(p + 1, lineEnd, chunk, record.date, record.categoryId, record.amount, record.descriptionId);
+}
+
+// Parses the complete lines in [begin, end) straight into columns. Fields
+// are located in place; the only allocations are column growth and new
+// distinct strings.
+void ParseCSVChunk(const char* begin, const char* end, ParsedChunk& chunk) {
+    size_t estimate = (end - begin) / 32;
+    chunk.dates.reserve(estimate);
+    chunk.categoryIds.reserve(estimate);
+    chunk.amounts.reserve(estimate);
+    chunk.descriptionIds.reserve(estimate);
+
+    const char* line = begin;
+    while (line < end) {
+        const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+        if (!lineEnd) lineEnd = end;
+        const char* next = lineEnd + 1;
+        if (lineEnd > line && lineEnd[-1] == '\r') lineEnd--;
+        if (lineEnd == line) { // blank line
+            line = next;
+            continue;
+        }
+
+        if (*line == '#') {
+            LedgerRecord record;
+            if (ParseRecord(line, lineEnd, chunk, record)) {
+                chunk.records.push_back(record);
+            } else {
+                SkipLine(chunk, line, next, end);
+            }
+            line = next;
+            continue;
+        }
+
+        int packedDate;
+        uint8_t categoryId;
+        int64_t paise;
+        uint32_t descriptionId;
+        if (!ParseCSVFields(line, lineEnd, chunk, packedDate, categoryId, paise, descriptionId)) {
+            SkipLine(chunk, line, next, end); // Skip invalid lines
+            line = next;
+            continue;
+        }
+
+        chunk.dates.push_back(packedDate);
+        chunk.categoryIds.push_back(categoryId);
+        chunk.amounts.push_back(paise);
+        chunk.descriptionIds.push_back(descriptionId);
+        line = next;
+    }
+}
+
+// Adds a parsed chunk's share of the focus range to the running totals.
+void PublishChunkProgress(const ParsedChunk& chunk, size_t bytes) {
+    int64_t income = 0;
+    int64_t expense = 0;
+    for (size_t i = 0; i < chunk.dates.size(); i++) {
+        if (chunk.dates[i] < loadProgress.focusFirstDate || chunk.dates[i] > loadProgress.focusLastDate) continue;
+        if (chunk.amounts[i] > 0) income += chunk.amounts[i];
+        else expense -= chunk.amounts[i];
+    }
+    loadProgress.focusIncome += income;
+    loadProgress.focusExpense += expense;
+    loadProgress.bytesDone += bytes;
+}
+
+int GetCategoryId(const std::string& category) {
+    for (size_t i = 0; i < categories.size(); i++) {
+        if (categories[i] == category) return (int)i;
+    }
+    if ((int)categories.size() >= maxCategories) {
+        return GetCategoryId("Other");
+    }
+    categories.push_back(category);
+    return (int)categories.size() - 1;
+}
+
+void AddToMonthSummary(uint32_t row, int64_t sign = 1) {
+    int packedDate = transactions.dates[row];
+    if (packedDate == 0) return;
+    int year = packedDate / 10000;
+    int month = packedDate / 100 % 100 - 1;
+
+    MonthSummary& summary = monthSummaries[year * 12 + month]; // zero-initialised on first use
+    int64_t amount = transactions.amounts[row];
+    if (amount > 0) {
+        summary.income += sign * amount;
+    } else if (amount < 0) {
+        summary.expense += sign * -amount;
+        summary.categoryExpense[transactions.categoryIds[row]] += sign * -amount;
+    }
+}
+
+const MonthSummary& GetMonthSummary(int month, int year) {
+    auto it = monthSummaries.find(year * 12 + month);
+    return it != monthSummaries.end() ? it->second : emptyMonthSummary;
+}
+
+const size_t pendingLimit = 4096;
+
+// removed[i] - i, the rows still in the order before removed[i], never
+// decreases, so the marks up to the index-th row are found by bisection.
+size_t RowOrder::MainPosition(size_t index) const {
+    size_t low = 0;
+    size_t high = removed.size();
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (removed[middle] - middle <= index) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return index + low;
+}
+
+void RowOrder::Insert(uint32_t row) {
+    if (pending.empty() && (MainSize() == 0 || less(main[MainPosition(MainSize() - 1)], row))) {
+        main.push_back(row); // sorts last: the common case for new entries
+        return;
+    }
+    pending.insert(std::upper_bound(pending.begin(), pending.end(), row, less), row);
+    if (pending.size() >= pendingLimit) Flush();
+}
+
+void RowOrder::Flush() {
+    if (!removed.empty()) {
+        size_t kept = removed[0];
+        size_t next = 0;
+        for (size_t i = kept; i < main.size(); i++) {
+            if (next < removed.size() && removed[next] == i) {
+                next++;
+            } else {
+                main[kept++] = main[i];
+            }
+        }
+        main.resize(kept);
+        removed.clear();
+    }
+    if (pending.empty()) return;
+    size_t middle = main.size();
+    main.insert(main.end(), pending.begin(), pending.end());
+    std::inplace_merge(main.begin(), main.begin() + middle, main.end(), less);
+    pending.clear();
+}
+
+void RowOrder::InsertMany(std::vector<uint32_t>& rows) {
+    if (rows.size() < pendingLimit) {
+        for (uint32_t row : rows) Insert(row);
+        return;
+    }
+    // One sort and one merge instead of a flush every pendingLimit rows.
+    Flush();
+    if (!std::is_sorted(rows.begin(), rows.end(), less)) std::sort(rows.begin(), rows.end(), less);
+    size_t middle = main.size();
+    main.insert(main.end(), rows.begin(), rows.end());
+    if (middle > 0 && less(main[middle], main[middle - 1])) {
+        std::inplace_merge(main.begin(), main.begin() + middle, main.end(), less);
+    }
+}
+
+void RowOrder::Remove(uint32_t row) {
+    auto it = std::lower_bound(pending.begin(), pending.end(), row, less);
+    if (it != pending.end() && *it == row) {
+        pending.erase(it);
+        return;
+    }
+    // Marked rows may since sort elsewhere, so the search only visits the rest.
+    size_t low = 0;
+    size_t high = MainSize();
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (less(main[MainPosition(middle)], row)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == MainSize()) return;
+    uint32_t position = (uint32_t)MainPosition(low);
+    if (main[position] != row) return;
+    removed.insert(std::upper_bound(removed.begin(), removed.end(), position), position);
+    if (removed.size() >= pendingLimit) Flush();
+}
+
+void RowOrder::Clear() {
+    main.clear();
+    pending.clear();
+    removed.clear();
+}
+
+// How many of the first `rank` rows in merged order come from `pending`.
+size_t SplitRank(const RowOrder& order, size_t rank) {
+    size_t mainSize = order.MainSize();
+    size_t low = rank > mainSize ? rank - mainSize : 0;
+    size_t high = std::min(rank, order.pending.size());
+    while (low < high) {
+        size_t taken = (low + high + 1) / 2;
+        size_t fromMain = rank - taken;
+        if (fromMain == mainSize || order.less(order.pending[taken - 1], order.main[order.MainPosition(fromMain)])) {
+            low = taken;
+        } else {
+            high = taken - 1;
+        }
+    }
+    return low;
+}
+
+void RowOrder::GetLast(size_t skip, size_t count, std::vector<uint32_t>& out) const {
+    out.clear();
+    if (skip >= size()) return;
+    size_t rank = size() - skip;
+    size_t fromPending = SplitRank(*this, rank);
+    size_t fromMain = rank - fromPending;
+    while (out.size() < count && fromPending + fromMain > 0) {
+        if (fromMain == 0 || (fromPending > 0 && less(main[MainPosition(fromMain - 1)], pending[fromPending - 1]))) {
+            out.push_back(pending[--fromPending]);
+        } else {
+            out.push_back(main[MainPosition(--fromMain)]);
+        }
+    }
+}
+
+void RowOrder::GetFirst(size_t skip, size_t count, std::vector<uint32_t>& out) const {
+    out.clear();
+    if (skip >= size()) return;
+    size_t fromPending = SplitRank(*this, skip);
+    size_t fromMain = skip - fromPending;
+    // Walks `main` by position, stepping over marks, since whole orders are read this way.
+    size_t position = MainPosition(fromMain);
+    size_t nextRemoved = std::lower_bound(removed.begin(), removed.end(), position) - removed.begin();
+    while (out.size() < count && (fromPending < pending.size() || fromMain < MainSize())) {
+        if (fromMain == MainSize() || (fromPending < pending.size() && less(pending[fromPending], main[position]))) {
+            out.push_back(pending[fromPending++]);
+        } else {
+            out.push_back(main[position++]);
+            fromMain++;
+            while (nextRemoved < removed.size() && removed[nextRemoved] == position) {
+                position++;
+                nextRemoved++;
+            }
+        }
+    }
+}
+
+void BuildDateIndex() {
+    PROFILE_SCOPE("Date index");
+    const std::vector<int>& dates = transactions.dates;
+    std::vector<uint32_t>& index = dateOrder.main;
+    dateOrder.Clear();
+    index.resize(dates.size());
+    bool sorted = true;
+    for (size_t i = 0; i < dates.size(); i++) {
+        index[i] = (uint32_t)i;
+        if (i > 0 && dates[i] < dates[i - 1]) sorted = false;
+    }
+    rowsInDateOrder = sorted && transactions.deletedCount == 0;
+    if (transactions.deletedCount > 0) {
+        index.erase(std::remove_if(index.begin(), index.end(), [](uint32_t row) { return transactions.IsDeleted(row); }),
+                    index.end());
+    }
+    if (sorted) return; // an append-only ledger is usually already in date order
+
+    // Sort (date, row) pairs packed into one integer so ties keep file order.
+    std::vector<uint64_t> keys(index.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        keys[i] = ((uint64_t)(uint32_t)dates[index[i]] << 32) | index[i];
+    }
+    std::sort(keys.begin(), keys.end());
+    for (size_t i = 0; i < keys.size(); i++) {
+        index[i] = (uint32_t)keys[i];
+    }
+}
+
+void AddToDateIndex(uint32_t row) {
+    // Rows dated today sort last and are appended, keeping the identity.
+    if (!dateOrder.main.empty() && RowDateLess(row, dateOrder.main.back())) rowsInDateOrder = false;
+    dateOrder.Insert(row);
+}
+
+void AddRowsToIndexes(uint32_t firstRow) {
+    PROFILE_SCOPE("Index new rows");
+    std::vector<uint32_t> rows;
+    rows.reserve(transactions.size() - firstRow);
+    for (uint32_t row = firstRow; row < transactions.size(); row++) {
+        if (transactions.IsDeleted(row)) {
+            rowsInDateOrder = false;
+            continue;
+        }
+        AddToMonthSummary(row);
+        if (rowsInDateOrder && row > 0 && RowDateLess(row, row - 1)) rowsInDateOrder = false;
+        rows.push_back(row);
+    }
+    dateOrder.InsertMany(rows);
+    AddRowsToDayRollups(firstRow);
+    if (buildBrowseIndexes) {
+        AddRowsToSearchIndex(firstRow);
+        AddRowsToTableOrders(firstRow);
+    }
+    AddRowsToBudgets(firstRow);
+    ledgerVersion++;
+}
+
+RowSpan GetRowsInDateRange(int firstDate, int lastDate) {
+    dateOrder.Flush(); // spans need one contiguous array
+    const std::vector<uint32_t>& index = dateOrder.main;
+    auto first = std::lower_bound(index.begin(), index.end(), firstDate,
+                                  [](uint32_t row, int value) { return transactions.dates[row] < value; });
+    auto last = std::upper_bound(first, index.end(), lastDate,
+                                 [](int value, uint32_t row) { return value < transactions.dates[row]; });
+    RowSpan span;
+    span.first = index.data() + (first - index.begin());
+    span.last = index.data() + (last - index.begin());
+    return span;
+}
+
+void GetRecentRows(size_t page, size_t pageSize, std::vector<uint32_t>& out) {
+    dateOrder.GetLast(page * pageSize, pageSize, out);
+}
+
+RowSpan GetRowsForMonth(int month, int year) {
+    int firstDate = PackDate(year, month + 1, 1);
+    return GetRowsInDateRange(firstDate, firstDate + 99);
+}
+
+void SumDateRange(int firstDate, int lastDate, MonthSummary& totals) {
+    totals = MonthSummary();
+    size_t firstRow = 0;
+    size_t lastRow = transactions.size();
+    if (rowsInDateOrder) {
+        // Rows are stored in date order, so the range is one contiguous block.
+        RowSpan span = GetRowsInDateRange(firstDate, lastDate);
+        firstRow = span.first - dateOrder.main.data();
+        lastRow = span.last - dateOrder.main.data();
+    }
+    GetAggregateKernel()(transactions.dates.data() + firstRow, transactions.amounts.data() + firstRow,
+                         transactions.categoryIds.data() + firstRow, lastRow - firstRow,
+                         firstDate, lastDate, totals);
+}
+
+const char* FindLinesEnd(const char* begin, const char* end) {
+    while (end > begin && end[-1] != '\n') end--;
+    return end;
+}
+
+std::vector<const char*> SplitIntoLineChunks(const char* begin, const char* end) {
+    // Several chunks per core so uneven lines still balance.
+    const size_t minChunkBytes = 1 << 20;
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunkCount = std::min(threadCount * 4, (size_t)(end - begin) / minChunkBytes + 1);
+    std::vector<const char*> bounds(chunkCount + 1, end);
+    bounds[0] = begin;
+    for (size_t i = 1; i < chunkCount; i++) {
+        const char* guess = begin + (end - begin) * i / chunkCount;
+        if (guess < bounds[i - 1]) guess = bounds[i - 1];
+        const char* newline = (const char*)memchr(guess, '\n', end - guess);
+        bounds[i] = newline ? newline + 1 : end;
+    }
+    return bounds;
+}
+
+void RunParallel(size_t count, const std::function<void(size_t)>& task) {
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            task(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(threadCount, count); i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) thread.join();
+}
+
+// Applies a chunk's records to `store`, mapping the chunk's category and
+// description ids through the maps. Returns the records naming no live row.
+size_t ApplyChunkRecords(const ParsedChunk& chunk, const std::vector<uint8_t>& categoryMap,
+                         const std::vector<uint32_t>& descriptionMap, TransactionStore& store) {
+    size_t unmatched = 0;
+    for (const LedgerRecord& record : chunk.records) {
+        store.recordLines++;
+        uint32_t row = record.fileRow;
+        if (row >= store.size() || store.IsDeleted(row)) {
+            unmatched++;
+        } else if (record.remove) {
+            store.amounts[row] = 0;
+            if (store.deleted.size() <= row) store.deleted.resize(row + 1, false);
+            store.deleted[row] = true;
+            store.deletedCount++;
+        } else {
+            store.dates[row] = record.date;
+            store.categoryIds[row] = categoryMap[record.categoryId];
+            store.amounts[row] = record.amount;
+            store.descriptionIds[row] = descriptionMap[record.descriptionId];
+        }
+    }
+    return unmatched;
+}
+
+// Appends a parsed chunk to the store, remapping its local category and
+// description ids to the global ones, then applies its records. A load
+// starts from an empty store (or a snapshot of the file's rows), so file
+// row ids are row ids. Returns the records naming no live row.
+size_t MergeChunk(ParsedChunk& chunk) {
+    std::vector<uint8_t> categoryMap(chunk.categoryNames.Count());
+    for (uint32_t id = 0; id < chunk.categoryNames.Count(); id++) {
+        categoryMap[id] = (uint8_t)GetCategoryId(chunk.categoryNames.Get(id));
+    }
+
+    std::vector<uint32_t> descriptionMap(chunk.descriptions.Count());
+    if (transactions.descriptions.Count() == 0) {
+        transactions.descriptions = std::move(chunk.descriptions); // ids carry over unchanged
+        for (uint32_t id = 0; id < descriptionMap.size(); id++) descriptionMap[id] = id;
+    } else {
+        for (uint32_t id = 0; id < descriptionMap.size(); id++) {
+            const char* text = chunk.descriptions.Get(id);
+            descriptionMap[id] = transactions.descriptions.Intern(text, strlen(text));
+        }
+    }
+
+    transactions.dates.insert(transactions.dates.end(), chunk.dates.begin(), chunk.dates.end());
+    transactions.amounts.insert(transactions.amounts.end(), chunk.amounts.begin(), chunk.amounts.end());
+    for (uint8_t id : chunk.categoryIds) {
+        transactions.categoryIds.push_back(categoryMap[id]);
+    }
+    for (uint32_t id : chunk.descriptionIds) {
+        transactions.descriptionIds.push_back(descriptionMap[id]);
+    }
+
+    size_t unmatched = ApplyChunkRecords(chunk, categoryMap, descriptionMap, transactions);
+    chunk = ParsedChunk();
+    return unmatched;
+}
+
+void ReadCSVRange(const char* begin, const char* end, TransactionStore& store, std::vector<std::string>& names,
+                  std::string& skippedLines) {
+    ParsedChunk chunk;
+    chunk.keepSkipped = true;
+    ParseCSVChunk(begin, end, chunk);
+    skippedLines.swap(chunk.skippedLines);
+    std::vector<uint8_t> categoryMap(chunk.categoryNames.Count());
+    std::vector<uint32_t> descriptionMap(chunk.descriptions.Count());
+    std::iota(categoryMap.begin(), categoryMap.end(), 0);
+    std::iota(descriptionMap.begin(), descriptionMap.end(), 0);
+    names.clear();
+    for (uint32_t id = 0; id < chunk.categoryNames.Count(); id++) names.push_back(chunk.categoryNames.Get(id));
+    store.clear();
+    store.dates.swap(chunk.dates);
+    store.categoryIds.swap(chunk.categoryIds);
+    store.amounts.swap(chunk.amounts);
+    store.descriptionIds.swap(chunk.descriptionIds);
+    ApplyChunkRecords(chunk, categoryMap, descriptionMap, store);
+    store.descriptions = std::move(chunk.descriptions);
+}
+
+LoadStats AppendCSVRange(const char* begin, const char* end) {
+    PROFILE_SCOPE("Parse CSV");
+    LoadStats stats = {0, 0};
+    if (begin >= end) return stats;
+
+    // Handed out newest first: an append-only ledger keeps the current
+    // month at the end of the file, so its totals fill in early.
+    loadProgress.bytesTotal += end - begin;
+    std::vector<const char*> bounds = SplitIntoLineChunks(begin, end);
+    size_t chunkCount = bounds.size() - 1;
+    std::vector<ParsedChunk> chunks(chunkCount);
+    RunParallel(chunkCount, [&](size_t i) {
+        size_t chunk = chunkCount - 1 - i;
+        PROFILE_SCOPE("Parse chunk");
+        ParseCSVChunk(bounds[chunk], bounds[chunk + 1], chunks[chunk]);
+        PublishChunkProgress(chunks[chunk], bounds[chunk + 1] - bounds[chunk]);
+    });
+
+    size_t total = transactions.size();
+    for (const auto& chunk : chunks) total += chunk.dates.size();
+    transactions.dates.reserve(total);
+    transactions.categoryIds.reserve(total);
+    transactions.amounts.reserve(total);
+    transactions.descriptionIds.reserve(total);
+    size_t before = transactions.size();
+    for (auto& chunk : chunks) {
+        stats.rowsSkipped += chunk.skipped;
+        stats.rowsSkipped += MergeChunk(chunk);
+    }
+    stats.rowsLoaded = transactions.size() - before;
+    return stats;
+}
+
+std::string CollectSkippedLines(const char* begin, const char* end) {
+    std::string lines;
+    if (begin >= end) return lines;
+    std::vector<const char*> bounds = SplitIntoLineChunks(begin, end);
+    size_t chunkCount = bounds.size() - 1;
+    std::vector<std::string> skipped(chunkCount);
+    RunParallel(chunkCount, [&](size_t chunk) {
+        ParsedChunk parsed; // its columns go as soon as the chunk is done
+        parsed.keepSkipped = true;
+        ParseCSVChunk(bounds[chunk], bounds[chunk + 1], parsed);
+        skipped[chunk].swap(parsed.skippedLines);
+    });
+    for (const auto& chunkLines : skipped) lines += chunkLines;
+    return lines;
+}
+
+void RebuildLedgerIndexes() {
+    PROFILE_SCOPE("Rebuild indexes");
+    // The focus month first, in one pass, so it is exact before the
+    // summaries for every other month are built.
+    if (loadProgress.focusFirstDate <= loadProgress.focusLastDate) {
+        MonthSummary focus = {};
+        GetAggregateKernel()(transactions.dates.data(), transactions.amounts.data(), transactions.categoryIds.data(),
+                             transactions.size(), loadProgress.focusFirstDate, loadProgress.focusLastDate, focus);
+        loadProgress.focusIncome = focus.income;
+        loadProgress.focusExpense = focus.expense;
+        loadProgress.focusExact = true;
+    }
+    BuildDateIndex(); // the table orders start from it
+    ResetTableOrders();
+    RebuildMonthSummaries();
+    if (buildBrowseIndexes) BuildSearchIndex();
+    ledgerVersion++;
+}
+
+void RebuildMonthSummaries() {
+    PROFILE_SCOPE("Month summaries");
+    monthSummaries.clear();
+    for (uint32_t row = 0; row < transactions.size(); row++) {
+        AddToMonthSummary(row);
+    }
+    BuildDayRollups((uint32_t)transactions.size());
+    if (buildBrowseIndexes) {
+        BuildTableOrders();
+        RefreshSearchBounds();
+    }
+    ledgerVersion++;
+}
+
+LoadStats LoadTransactionsFromCSV() {
+    PROFILE_SCOPE("Load CSV");
+    LoadStats stats = {0, 0};
+    transactions.clear();
+    dateOrder.Clear();
+    monthSummaries.clear();
+
+    ledgerLoadedBytes = 0;
+    ledgerLoadedFingerprint = 0;
+
+    MappedFile mapped;
+    if (!OpenMappedFile(ledgerPath, mapped)) return stats;
+
+    const char* data = mapped.data;
+    const char* end = data ? FindLinesEnd(data, data + mapped.size) : nullptr;
+    const char* body = data ? (const char*)memchr(data, '\n', end - data) : nullptr; // Skip header
+    if (body) {
+        stats = AppendCSVRange(body + 1, end);
+    }
+    ledgerLoadedBytes = end - data;
+    ledgerLoadedFingerprint = data ? FingerprintCSV(data, ledgerLoadedBytes) : 0;
+    CloseMappedFile(mapped);
+
+    RebuildLedgerIndexes();
+    return stats;
+}
+
+void AppendCSVRow(std::string& out, const TransactionStore& store, const std::vector<std::string>& names, uint32_t row) {
+    char date[11];
+    char amount[24];
+    out += FormatDate(store.dates[row], date);
+    out += ',';
+    out += names[store.categoryIds[row]];
+    out += ',';
+    out += FormatAmount(store.amounts[row], amount);
+    out += ',';
+    out += store.descriptions.Get(store.descriptionIds[row]);
+    out += csvNewline;
+}
+
+void AppendCSVRow(std::string& out, uint32_t row) {
+    AppendCSVRow(out, transactions, categories, row);
+}
+
+// Queued for the writer thread when one is running (the UI); tools
+// without a journal append synchronously.
+void WriteLedgerLine(const std::string& line) {
+    if (!JournalAppend(line)) {
+        AppendToLedgerFile(ledgerPath, line, false, true);
+    }
+}
+
+void SaveTransactionToCSV(const Transaction& transaction) {
+    PROFILE_SCOPE("Save row");
+    char amount[24];
+    std::string line;
+    line.reserve(64 + transaction.description.size());
+    line += transaction.date;
+    line += ',';
+    line += transaction.category;
+    line += ',';
+    line += FormatAmount(ToPaise(transaction.amount), amount);
+    line += ',';
+    line += transaction.description;
+    line += csvNewline;
+    WriteLedgerLine(line);
+}
+
+void AddTransaction(const Transaction& transaction) {
+    PROFILE_SCOPE("Add transaction");
+    int packedDate;
+    if (!ParseDate(transaction.date.data(), transaction.date.size(), packedDate)) {
+        packedDate = 0; // kept, but outside every month and date range query
+    }
+    transactions.dates.push_back(packedDate);
+    transactions.categoryIds.push_back((uint8_t)GetCategoryId(transaction.category));
+    transactions.amounts.push_back(ToPaise(transaction.amount));
+    transactions.descriptionIds.push_back(
+        transactions.descriptions.Intern(transaction.description.data(), transaction.description.size()));
+
+    uint32_t row = (uint32_t)transactions.size() - 1;
+    AddToMonthSummary(row);
+    AddToDateIndex(row);
+    AddRowsToDayRollups(row);
+    if (buildBrowseIndexes) {
+        AddRowsToSearchIndex(row);
+        AddRowsToTableOrders(row);
+    }
+    AddRowsToBudgets(row);
+    ledgerVersion++;
+    SaveTransactionToCSV(transaction);
+}
+
+// Takes a row out of every index and summary while its columns still hold
+// the values it was indexed under; IndexRow puts it back.
+void UnindexRow(uint32_t row) {
+    AddToMonthSummary(row, -1);
+    dateOrder.Remove(row);
+    rowsInDateOrder = false;
+    RemoveRowFromDayRollups(row);
+    if (buildBrowseIndexes) {
+        RemoveRowFromSearchIndex(row);
+        RemoveRowFromTableOrders(row);
+    }
+}
+
+void IndexRow(uint32_t row) {
+    AddToMonthSummary(row);
+    dateOrder.Insert(row);
+    InsertRowIntoDayRollups(row);
+    if (buildBrowseIndexes) {
+        InsertRowIntoSearchIndex(row);
+        InsertRowIntoTableOrders(row);
+    }
+}
+
+bool UpdateTransaction(uint32_t row, const Transaction& transaction) {
+    PROFILE_SCOPE("Update transaction");
+    if (row >= transactions.size() || transactions.IsDeleted(row)) return false;
+    int packedDate;
+    if (!ParseDate(transaction.date.data(), transaction.date.size(), packedDate)) {
+        packedDate = 0;
+    }
+    int oldDate = transactions.dates[row];
+    int oldCategoryId = transactions.categoryIds[row];
+    int64_t oldAmount = transactions.amounts[row];
+
+    UnindexRow(row);
+    transactions.dates[row] = packedDate;
+    transactions.categoryIds[row] = (uint8_t)GetCategoryId(transaction.category);
+    transactions.amounts[row] = ToPaise(transaction.amount);
+    transactions.descriptionIds[row] =
+        transactions.descriptions.Intern(transaction.description.data(), transaction.description.size());
+    IndexRow(row);
+    UpdateRowInBudgets(row, oldDate, oldCategoryId, oldAmount);
+    transactions.recordLines++;
+    ledgerVersion++;
+
+    std::string line = "#update," + std::to_string(transactions.FileRowId(row)) + ",";
+    AppendCSVRow(line, row);
+    WriteLedgerLine(line);
+    return true;
+}
+
+bool DeleteTransaction(uint32_t row) {
+    PROFILE_SCOPE("Delete transaction");
+    if (row >= transactions.size() || transactions.IsDeleted(row)) return false;
+    UnindexRow(row);
+    transactions.amounts[row] = 0;
+    if (transactions.deleted.size() <= row) transactions.deleted.resize(row + 1, false);
+    transactions.deleted[row] = true;
+    transactions.deletedCount++;
+    transactions.recordLines++;
+    ledgerVersion++;
+
+    WriteLedgerLine("#delete," + std::to_string(transactions.FileRowId(row)) + csvNewline);
+    return true;
+}
+
+size_t GetLiveRowCount() {
+    return transactions.size() - transactions.deletedCount;
+}
+
+void RenumberFileRows(uint32_t rowCount) {
+    transactions.recordLines = 0;
+    if (transactions.deletedCount == 0) {
+        transactions.fileRowIds.clear(); // nothing dropped: row ids again
+        transactions.fileRowBase = 0;
+        return;
+    }
+    transactions.fileRowIds.assign(rowCount, noFileRow);
+    uint32_t fileRow = 0;
+    for (uint32_t row = 0; row < rowCount; row++) {
+        if (!transactions.IsDeleted(row)) transactions.fileRowIds[row] = fileRow++;
+    }
+    transactions.fileRowBase = fileRow;
+}
+
+void RemapFileRows(const std::vector<uint32_t>& fileRows, uint32_t keptRows, size_t recordLines) {
+    uint32_t dropped = (uint32_t)fileRows.size() - keptRows;
+    uint32_t nextFileRow = transactions.FileRowId((uint32_t)transactions.size()) - dropped;
+    std::vector<uint32_t> fileRowIds(transactions.size());
+    bool renumbered = false;
+    for (uint32_t row = 0; row < transactions.size(); row++) {
+        uint32_t fileRow = transactions.FileRowId(row);
+        if (fileRow != noFileRow) fileRow = fileRow < fileRows.size() ? fileRows[fileRow] : fileRow - dropped;
+        fileRowIds[row] = fileRow;
+        if (fileRow != row) renumbered = true;
+    }
+    transactions.recordLines = recordLines;
+    if (!renumbered) fileRowIds.clear(); // nothing dropped: row ids again
+    transactions.fileRowIds.swap(fileRowIds);
+    transactions.fileRowBase = transactions.fileRowIds.empty() ? 0 : nextFileRow;
+}
+
+Transaction GetTransaction(uint32_t row) {
+    char date[11];
+    return {FormatDate(transactions.dates[row], date),
+            categories[transactions.categoryIds[row]],
+            ToRupees(transactions.amounts[row]),
+            transactions.descriptions.Get(transactions.descriptionIds[row])};
+}
+
+size_t GetLedgerMemoryUsage() {
+    size_t monthBytes = monthSummaries.size() * (sizeof(MonthSummary) + sizeof(int) + 2 * sizeof(void*));
+    return transactions.dates.capacity() * sizeof(int) +
+           transactions.categoryIds.capacity() * sizeof(uint8_t) +
+           transactions.amounts.capacity() * sizeof(int64_t) +
+           transactions.descriptionIds.capacity() * sizeof(uint32_t) +
+           transactions.descriptions.MemoryUsage() +
+           (dateOrder.main.capacity() + dateOrder.pending.capacity() + dateOrder.removed.capacity()) * sizeof(uint32_t) +
+           monthBytes;
+}
+
+double GetProcessCpuSeconds() {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) return 0.0;
+    uint64_t ticks = ((uint64_t)kernel.dwHighDateTime << 32 | kernel.dwLowDateTime) +
+                     ((uint64_t)user.dwHighDateTime << 32 | user.dwLowDateTime);
+    return ticks / 1e7; // 100 ns units
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+std::string GetMonthName(int month) {
+    const std::string monthNames[] = {"January", "February", "March", "April", "May", "June",
+                                     "July", "August", "September", "October", "November", "December"};
+    return monthNames[month];
+}
+
+std::vector<Transaction> GetTransactionsForMonth(int month, int year) {
+    RowSpan rows = GetRowsForMonth(month, year);
+    std::vector<Transaction> result;
+    result.reserve(rows.size());
+    for (uint32_t row : rows) {
+        result.push_back(GetTransaction(row));
+    }
+    return result;
+}
+
+std::map<std::string, double> GetCategorySummary(const std::vector<Transaction>& transactions) {
+    std::map<std::string, double> categorySummary;
+
+    for (const auto& transaction : transactions) {
+        if (transaction.amount < 0) {
+            categorySummary[transaction.category] += -transaction.amount;
+        }
+    }
+
+    return categorySummary;
+}
+
+double GetTotalIncome(const std::vector<Transaction>& transactions) {
+    double total = 0.0;
+    for (const auto& transaction : transactions) {
+        if (transaction.amount > 0) {
+            total += transaction.amount;
+        }
+    }
+    return total;
+}
+
+double GetTotalExpense(const std::vector<Transaction>& transactions) {
+    double total = 0.0;
+    for (const auto& transaction : transactions) {
+        if (transaction.amount < 0) {
+            total += -transaction.amount;
+        }
+    }
+    return total;
+}
@@ -0,0 +1,253 @@
+#ifndef LEDGER_H
+#define LEDGER_H
+
+// Ledger core: transaction storage, CSV persistence and monthly queries.
+// Has no raylib dependency so it can be used by the UI (2.cpp) and by
+// headless tools such as the benchmark (bench.cpp).
+
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+
+// One row as entered in the UI or written to the CSV.
+struct Transaction {
+    std::string date;
+    std::string category;
+    double amount;
+    std::string description;
+};
+
+struct LoadStats {
+    size_t rowsLoaded;
+    size_t rowsSkipped; // malformed rows (bad date or amount)
+};
+
+// Append-only set of strings stored back to back, null-terminated, in one
+// arena. Ids are dense and assigned in first-seen order.
+struct StringTable {
+    std::string arena;
+    std::vector<uint32_t> offsets; // start of each string in arena
+    std::vector<uint32_t> slots;   // open-addressed hash of id + 1, 0 = empty
+
+    uint32_t Intern(const char* text, size_t length);
+    const char* Get(uint32_t id) const { return arena.data() + offsets[id]; }
+    size_t Count() const { return offsets.size(); }
+    size_t MemoryUsage() const;
+    void Clear();
+};
+
+const uint32_t noFileRow = UINT32_MAX;
+
+// The ledger, one column per field. Row ids index every column and never
+// change once assigned. A deleted row keeps its id but leaves every index,
+// and its amount is zeroed so column scans count nothing for it.
+//
+// The CSV refers to rows by their position among its data lines, the file
+// row id. That is the row id until a compaction drops deleted rows from the
+// file; from then on, rows below fileRowIds.size() map through it
+// (noFileRow for the dropped ones) and later rows follow on from fileRowBase.
+struct TransactionStore {
+    std::vector<int> dates;                // yyyymmdd, parsed once
+    std::vector<uint8_t> categoryIds;      // index into `categories`
+    std::vector<int64_t> amounts;          // paise; income > 0, expenses < 0
+    std::vector<uint32_t> descriptionIds;  // index into `descriptions`
+    StringTable descriptions;              // interned, so repeated text is stored once
+    std::vector<bool> deleted;             // by row, only as far as the last deleted one
+    size_t deletedCount = 0;
+    size_t recordLines = 0;                // update and delete records in the CSV
+    std::vector<uint32_t> fileRowIds;
+    uint32_t fileRowBase = 0;
+
+    size_t size() const { return dates.size(); }
+    bool empty() const { return dates.empty(); }
+    bool IsDeleted(uint32_t row) const { return row < deleted.size() && deleted[row]; }
+    uint32_t FileRowId(uint32_t row) const {
+        return row < fileRowIds.size() ? fileRowIds[row] : fileRowBase + (row - (uint32_t)fileRowIds.size());
+    }
+    void clear();
+};
+
+// Per-category ids index `categories`; unknown names read from the CSV are
+// appended, so ids always fit in maxCategories.
+const int maxCategories = 256;
+
+// Income/expense totals for one calendar month, kept up to date by
+// LoadTransactionsFromCSV and AddTransaction so screens never rescan rows.
+// SumDateRange fills the same shape for an arbitrary range.
+struct MonthSummary {
+    int64_t income;
+    int64_t expense;
+    int64_t categoryExpense[maxCategories]; // indexed by category id, expenses only
+};
+
+// Row ids kept sorted by `less`. A row that sorts last is appended to
+// `main`; any other row goes into the small sorted `pending` buffer, which
+// is merged into `main` once it passes pendingLimit. A row removed from
+// `main` is only marked, by position in `removed`, and dropped at the next
+// merge (or once pendingLimit rows are marked). Inserts and removes are
+// therefore a binary search plus a short memmove, whatever the ledger
+// size, and rank queries read the arrays without merging.
+struct RowOrder {
+    bool (*less)(uint32_t a, uint32_t b);
+    std::vector<uint32_t> main;
+    std::vector<uint32_t> pending;
+    std::vector<uint32_t> removed; // sorted positions in `main` no longer in the order
+
+    void Insert(uint32_t row);
+    void InsertMany(std::vector<uint32_t>& rows); // sorts `rows` unless already sorted
+    void Flush(); // drop `removed` from `main` and merge `pending` into it
+    void Remove(uint32_t row); // call while its columns still hold the values it was sorted by
+    void Clear();
+    size_t size() const { return MainSize() + pending.size(); }
+    // The rows of `main` still in the order, and where the index-th is.
+    size_t MainSize() const { return main.size() - removed.size(); }
+    size_t MainPosition(size_t index) const;
+    // Up to `count` rows starting `skip` rows from the end (largest first).
+    void GetLast(size_t skip, size_t count, std::vector<uint32_t>& out) const;
+    // Up to `count` rows starting `skip` rows from the start (smallest first).
+    void GetFirst(size_t skip, size_t count, std::vector<uint32_t>& out) const;
+};
+
+// Rows by date, ties in row order: the ledger's main index.
+bool RowDateLess(uint32_t a, uint32_t b);
+extern RowOrder dateOrder;
+
+// Row ids in date order. Spans point into the maintained index and are
+// invalidated by the next AddTransaction/Load.
+struct RowSpan {
+    const uint32_t* first;
+    const uint32_t* last;
+    const uint32_t* begin() const { return first; }
+    const uint32_t* end() const { return last; }
+    size_t size() const { return last - first; }
+};
+
+// Read-only view of a whole file, memory-mapped so loaders parse straight
+// out of the page cache without copying.
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* mapping = nullptr;
+#endif
+};
+
+bool OpenMappedFile(const std::string& path, MappedFile& mapped);
+void CloseMappedFile(MappedFile& mapped);
+
+// Progress of the load in flight, written by the loader threads and safe
+// to read from any other thread. Rows dated within [focusFirstDate,
+// focusLastDate] (the month on screen) are totalled as each chunk is parsed,
+// so a UI can show them before the whole ledger is in; focusExact is set
+// once the totals cover every row.
+struct LoadProgress {
+    std::atomic<size_t> bytesTotal;
+    std::atomic<size_t> bytesDone;
+    std::atomic<int64_t> focusIncome;
+    std::atomic<int64_t> focusExpense;
+    std::atomic<bool> focusExact;
+    int focusFirstDate;
+    int focusLastDate;
+};
+
+extern LoadProgress loadProgress;
+// Call before starting a load; an empty range (first > last) disables focus totals.
+void ResetLoadProgress(int focusFirstDate, int focusLastDate);
+
+extern TransactionStore transactions;
+extern uint64_t ledgerVersion; // bumped by every change to the store or its summaries
+// The search index and table orders, which only the screens browse; runs
+// that just need totals (import, export, reports) turn them off before loading.
+extern bool buildBrowseIndexes;
+extern std::vector<std::string> categories;
+extern std::string ledgerPath; // defaults to "transactions.csv"
+// The CSV prefix the store holds, as its length and FingerprintCSV: the
+// complete lines the last load read, moved on past the store's own appends
+// and rows tailed from other programs (watch.h). A line still being
+// written at load time is left for later.
+extern uint64_t ledgerLoadedBytes;
+extern uint64_t ledgerLoadedFingerprint;
+
+LoadStats LoadTransactionsFromCSV();
+// Parses CSV data lines (no header) in parallel and appends them to the
+// store, then applies the update and delete records among them:
+//
+//   #update,<file row id>,<date>,<category>,<amount>,<description>
+//   #delete,<file row id>
+//
+// Callers follow up with RebuildLedgerIndexes().
+LoadStats AppendCSVRange(const char* begin, const char* end);
+// The same lines read on one thread into a store of their own, with
+// category ids indexing `names`, and the lines it skipped in
+// `skippedLines`; leaves the ledger alone, so it can run in the background.
+void ReadCSVRange(const char* begin, const char* end, TransactionStore& store, std::vector<std::string>& names,
+                  std::string& skippedLines);
+// The lines in [begin, end) a load skips, verbatim and in file order, for
+// a rewrite of the ledger to carry over.
+std::string CollectSkippedLines(const char* begin, const char* end);
+void RebuildLedgerIndexes(); // month summaries, date, search and table indexes from the columns
+// Month summaries, day rollups and table sort orders, after changing
+// amounts or categories in place.
+void RebuildMonthSummaries();
+void AddRowsToIndexes(uint32_t firstRow); // after appending rows firstRow.. to the columns
+// Just past the last newline in [begin, end), or begin if there is none.
+const char* FindLinesEnd(const char* begin, const char* end);
+// Newline-aligned [bounds[i], bounds[i + 1]) chunks, a few per core.
+std::vector<const char*> SplitIntoLineChunks(const char* begin, const char* end);
+// Runs task(0) .. task(count - 1) on up to one thread per core.
+void RunParallel(size_t count, const std::function<void(size_t)>& task);
+void SaveTransactionToCSV(const Transaction& transaction);
+void AddTransaction(const Transaction& transaction);
+// Change or delete an existing row in place, keeping every index and
+// summary current, and append the matching record to the CSV. Both return
+// false for a row that does not exist or is already deleted.
+bool UpdateTransaction(uint32_t row, const Transaction& transaction);
+bool DeleteTransaction(uint32_t row);
+size_t GetLiveRowCount(); // rows less deleted ones
+// The CSV now holds the live rows below rowCount, in order, followed by
+// every row from rowCount on (after a compaction or rewrite).
+void RenumberFileRows(uint32_t rowCount);
+// After a compaction of the CSV's first fileRows.size() file rows, which
+// kept keptRows of them: their ids map through fileRows and later ones
+// move down to follow. The file now holds recordLines records.
+void RemapFileRows(const std::vector<uint32_t>& fileRows, uint32_t keptRows, size_t recordLines);
+Transaction GetTransaction(uint32_t row);
+void AppendCSVRow(std::string& out, uint32_t row);
+void AppendCSVRow(std::string& out, const TransactionStore& store, const std::vector<std::string>& names, uint32_t row);
+size_t GetLedgerMemoryUsage();
+double GetProcessCpuSeconds(); // user + kernel time of every thread so far
+uint64_t HashBytes(const char* text, size_t length);
+// Hash of the last few KB of a CSV prefix and its length. Rows are only
+// ever appended, so a file whose prefix still matches is taken to have
+// just grown; a rewritten or truncated one fails it.
+uint64_t FingerprintCSV(const char* data, uint64_t length);
+
+std::string GetMonthName(int month);
+int GetCategoryId(const std::string& category);
+// A real calendar date, YYYY-MM-DD with the month and day padded or not.
+bool ParseDate(const char* text, size_t length, int& packedDate);
+int DaysInMonth(int year, int month); // month is 1-12
+bool ParseAmount(const char* text, size_t length, int64_t& paise);
+int PackDate(int year, int month, int day); // month is 1-12
+const char* FormatDate(int packedDate, char* buffer);  // needs 11 bytes
+const char* FormatAmount(int64_t paise, char* buffer); // needs 24 bytes, "%.2f" style
+inline double ToRupees(int64_t paise) { return paise / 100.0; }
+inline int64_t ToPaise(double rupees) { return (int64_t)(rupees * 100.0 + (rupees < 0 ? -0.5 : 0.5)); }
+
+const MonthSummary& GetMonthSummary(int month, int year);
+RowSpan GetRowsInDateRange(int firstDate, int lastDate); // inclusive yyyymmdd bounds
+RowSpan GetRowsForMonth(int month, int year);
+// Newest first: page 0 holds the pageSize most recent rows. `out` is reused
+// by the caller, so repeated calls do not allocate.
+void GetRecentRows(size_t page, size_t pageSize, std::vector<uint32_t>& out);
+// Totals for any date range in one fused pass over the columns (kernels.h).
+void SumDateRange(int firstDate, int lastDate, MonthSummary& totals);
+std::vector<Transaction> GetTransactionsForMonth(int month, int year);
+std::map<std::string, double> GetCategorySummary(const std::vector<Transaction>& transactions);
+double GetTotalIncome(const std::vector<Transaction>& transactions);
+double GetTotalExpense(const std::vector<Transaction>& transactions);
+
+#endif
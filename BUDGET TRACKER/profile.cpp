@@ -0,0 +1,124 @@
+#include "profile.h"
+
+#ifdef BUDGET_PROFILE
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+struct ProfileEvent {
+    const char* name;
+    uint64_t start; // ns since profileEpoch
+    uint64_t duration;
+    uint32_t thread;
+};
+
+// Scopes only wrap whole phases, a handful per frame, so one lock is cheap
+// enough and keeps every thread's events in one ring.
+std::mutex profileMutex;
+std::vector<ProfileEvent> profileEvents;
+size_t nextProfileEvent = 0; // oldest event once the ring is full
+std::vector<ProfileTotal> profileTotals;
+std::vector<double> frameTimes;
+size_t nextFrameTime = 0;
+uint64_t frameStart = 0;
+
+uint64_t ProfileClock() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+const uint64_t profileEpoch = ProfileClock();
+std::atomic<uint32_t> profileThreadCount(0);
+thread_local const uint32_t profileThread = profileThreadCount++;
+
+void RecordProfileEvent(const char* name, uint64_t start, uint64_t end) {
+    ProfileEvent event = {name, start - profileEpoch, end - start, profileThread};
+    double ms = event.duration / 1e6;
+    std::lock_guard<std::mutex> lock(profileMutex);
+    if (profileEvents.size() < maxProfileEvents) {
+        profileEvents.push_back(event);
+    } else {
+        profileEvents[nextProfileEvent] = event;
+        nextProfileEvent = (nextProfileEvent + 1) % maxProfileEvents;
+    }
+
+    ProfileTotal* total = nullptr;
+    for (ProfileTotal& candidate : profileTotals) {
+        if (candidate.name == name) total = &candidate;
+    }
+    if (!total) {
+        profileTotals.push_back({name, 0, 0.0, 0.0, 0.0});
+        total = &profileTotals.back();
+    }
+    total->calls++;
+    total->lastMs = ms;
+    total->totalMs += ms;
+    if (ms > total->maxMs) total->maxMs = ms;
+}
+
+ProfileScope::ProfileScope(const char* name) : name(name), start(ProfileClock()) {}
+
+ProfileScope::~ProfileScope() {
+    RecordProfileEvent(name, start, ProfileClock());
+}
+
+ProfilePhases::ProfilePhases(const char* name) : name(name), start(ProfileClock()) {}
+
+void ProfilePhases::Next(const char* next) {
+    uint64_t now = ProfileClock();
+    RecordProfileEvent(name, start, now);
+    name = next;
+    start = now;
+}
+
+ProfilePhases::~ProfilePhases() {
+    RecordProfileEvent(name, start, ProfileClock());
+}
+
+void ProfileBeginFrame() {
+    frameStart = ProfileClock();
+}
+
+void ProfileEndFrame() {
+    uint64_t end = ProfileClock();
+    RecordProfileEvent("Frame", frameStart, end);
+    std::lock_guard<std::mutex> lock(profileMutex);
+    double ms = (end - frameStart) / 1e6;
+    if (frameTimes.size() < maxProfileFrames) {
+        frameTimes.push_back(ms);
+    } else {
+        frameTimes[nextFrameTime] = ms;
+        nextFrameTime = (nextFrameTime + 1) % maxProfileFrames;
+    }
+}
+
+void GetProfileFrameTimes(std::vector<double>& out) {
+    std::lock_guard<std::mutex> lock(profileMutex);
+    out.assign(frameTimes.begin() + nextFrameTime, frameTimes.end());
+    out.insert(out.end(), frameTimes.begin(), frameTimes.begin() + nextFrameTime);
+}
+
+void GetProfileTotals(std::vector<ProfileTotal>& out) {
+    std::lock_guard<std::mutex> lock(profileMutex);
+    out = profileTotals;
+}
+
+// Chrome's trace event format: one complete ("X") event per scope, in
+// microseconds. Names are string literals without quotes or backslashes.
+bool WriteProfileTrace(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) return false;
+    std::lock_guard<std::mutex> lock(profileMutex);
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < profileEvents.size(); i++) {
+        const ProfileEvent& event = profileEvents[(nextProfileEvent + i) % profileEvents.size()];
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}\n",
+                i > 0 ? "," : "", event.name, event.thread, event.start / 1e3, event.duration / 1e3);
+    }
+    fprintf(file, "]}\n");
+    return fclose(file) == 0;
+}
+
+#endif
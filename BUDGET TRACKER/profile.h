@@ -0,0 +1,72 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// Scoped timers for finding slow frames, loads and saves. Built with
+// -DBUDGET_PROFILE, PROFILE_SCOPE("name") times the rest of the enclosing
+// block and records it for the overlay (F3 in the app) and for a Chrome
+// trace (chrome://tracing, ui.perfetto.dev) written by WriteProfileTrace.
+// Without the flag every macro expands to nothing and profile.cpp is
+// empty, so release builds pay nothing.
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#ifdef BUDGET_PROFILE
+
+struct ProfileScope {
+    const char* name; // a string literal: totals are kept per pointer
+    uint64_t start;
+    explicit ProfileScope(const char* name);
+    ~ProfileScope();
+};
+
+// Consecutive phases of one function (layout, query, draw): each Next ends
+// the running phase and starts the named one; the last ends with the block.
+struct ProfilePhases {
+    const char* name;
+    uint64_t start;
+    explicit ProfilePhases(const char* name);
+    void Next(const char* next);
+    ~ProfilePhases();
+};
+
+#define PROFILE_JOIN_(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_JOIN(profileScope, __LINE__)(name)
+#define PROFILE_PHASES(name) ProfilePhases profilePhases(name)
+#define PROFILE_NEXT_PHASE(name) profilePhases.Next(name)
+#define PROFILE_BEGIN_FRAME() ProfileBeginFrame()
+#define PROFILE_END_FRAME() ProfileEndFrame()
+
+// Every call of one scope name so far.
+struct ProfileTotal {
+    const char* name;
+    size_t calls;
+    double lastMs;
+    double totalMs;
+    double maxMs;
+};
+
+const size_t maxProfileEvents = 1 << 20; // the trace keeps the most recent ones
+const size_t maxProfileFrames = 1000;
+
+// A frame is the work between the two calls, recorded as a "Frame" scope;
+// the wait for vsync or input that follows is not counted.
+void ProfileBeginFrame();
+void ProfileEndFrame();
+void GetProfileFrameTimes(std::vector<double>& out); // ms, last maxProfileFrames frames, oldest first
+void GetProfileTotals(std::vector<ProfileTotal>& out); // in first-seen order
+bool WriteProfileTrace(const std::string& path);
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_PHASES(name) ((void)0)
+#define PROFILE_NEXT_PHASE(name) ((void)0)
+#define PROFILE_BEGIN_FRAME() ((void)0)
+#define PROFILE_END_FRAME() ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,128 @@
+#include "report.h"
+#include "profile.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+bool ParseMonth(const char* text, const char* end, int& monthIndex) {
+    if (end - text != 7 || text[4] != '-') return false;
+    int year = 0;
+    for (int i = 0; i < 4; i++) {
+        if (text[i] < '0' || text[i] > '9') return false;
+        year = year * 10 + (text[i] - '0');
+    }
+    if (text[5] < '0' || text[5] > '9' || text[6] < '0' || text[6] > '9') return false;
+    int month = (text[5] - '0') * 10 + (text[6] - '0');
+    if (month < 1 || month > 12) return false;
+    monthIndex = year * 12 + month - 1;
+    return true;
+}
+
+bool ParseMonthRange(const char* text, int& firstMonth, int& lastMonth) {
+    const char* end = text + strlen(text);
+    const char* colon = strchr(text, ':');
+    if (!colon) {
+        if (!ParseMonth(text, end, firstMonth)) return false;
+        lastMonth = firstMonth;
+        return true;
+    }
+    return ParseMonth(text, colon, firstMonth) && ParseMonth(colon + 1, end, lastMonth) && firstMonth <= lastMonth;
+}
+
+bool ParseReportFormat(const char* text, ReportFormat& format) {
+    if (strcmp(text, "csv") == 0) {
+        format = REPORT_CSV;
+    } else if (strcmp(text, "json") == 0) {
+        format = REPORT_JSON;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void AppendJsonString(std::string& out, const std::string& text) {
+    out += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+// One month in either format, with the same rounding as the summary screen.
+void FormatReportMonth(int monthIndex, ReportFormat format, std::string& out) {
+    const MonthSummary& summary = GetMonthSummary(monthIndex % 12, monthIndex / 12);
+    char month[16];
+    char income[24];
+    char expense[24];
+    char balance[24];
+    char amount[24];
+    char percent[16];
+    snprintf(month, sizeof(month), "%04d-%02d", monthIndex / 12, monthIndex % 12 + 1);
+    FormatAmount(summary.income, income);
+    FormatAmount(summary.expense, expense);
+    FormatAmount(summary.income - summary.expense, balance);
+
+    if (format == REPORT_JSON) {
+        out += "{\"month\":\"";
+        out += month;
+        out += "\",\"income\":";
+        out += income;
+        out += ",\"expense\":";
+        out += expense;
+        out += ",\"balance\":";
+        out += balance;
+        out += ",\"categories\":[";
+    }
+    bool any = false;
+    for (size_t i = 0; i < categories.size(); i++) {
+        if (categories[i] == "Income" || summary.categoryExpense[i] <= 0) continue;
+        FormatAmount(summary.categoryExpense[i], amount);
+        snprintf(percent, sizeof(percent), "%.1f", (double)summary.categoryExpense[i] / summary.expense * 100.0);
+        if (format == REPORT_JSON) {
+            out += any ? ",{\"name\":" : "{\"name\":";
+            AppendJsonString(out, categories[i]);
+            out += ",\"amount\":";
+            out += amount;
+            out += ",\"percent\":";
+            out += percent;
+            out += '}';
+        } else {
+            out.append(month).append(",").append(income).append(",").append(expense).append(",").append(balance);
+            out.append(",").append(categories[i]).append(",").append(amount).append(",").append(percent).append("\n");
+        }
+        any = true;
+    }
+    if (format == REPORT_JSON) {
+        out += "]}";
+    } else if (!any) {
+        out.append(month).append(",").append(income).append(",").append(expense).append(",").append(balance);
+        out.append(",,,\n"); // no expenses this month
+    }
+}
+
+void WriteReport(int firstMonth, int lastMonth, ReportFormat format, std::ostream& out) {
+    PROFILE_SCOPE("Report");
+    std::vector<std::string> blocks(lastMonth - firstMonth + 1);
+    RunParallel(blocks.size(), [&](size_t i) {
+        FormatReportMonth(firstMonth + (int)i, format, blocks[i]);
+    });
+
+    if (format == REPORT_JSON) {
+        out << "[\n";
+        for (size_t i = 0; i < blocks.size(); i++) out << blocks[i] << (i + 1 < blocks.size() ? ",\n" : "\n");
+        out << "]\n";
+    } else {
+        out << "month,income,expense,balance,category,amount,percent\n";
+        for (const std::string& block : blocks) out << block;
+    }
+    out.flush();
+}
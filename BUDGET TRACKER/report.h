@@ -0,0 +1,21 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+// Month-end reports without a window (2.exe --report): the Monthly Summary
+// screen's figures for a run of months, that is income, expense, balance
+// and each category's expense with its share of the month's expenses.
+// Figures come from the month summaries; months are formatted in parallel,
+// one block of text each, and written in month order.
+
+#include "ledger.h"
+#include <ostream>
+
+enum ReportFormat { REPORT_CSV, REPORT_JSON };
+
+// "YYYY-MM:YYYY-MM" or a single "YYYY-MM", inclusive, as month indexes
+// (year * 12 + month - 1, the month summaries' keys).
+bool ParseMonthRange(const char* text, int& firstMonth, int& lastMonth);
+bool ParseReportFormat(const char* text, ReportFormat& format);
+void WriteReport(int firstMonth, int lastMonth, ReportFormat format, std::ostream& out);
+
+#endif
@@ -0,0 +1,218 @@
+#include "rollup.h"
+#include "profile.h"
+#include <algorithm>
+#include <climits>
+
+// Node i (1-based) sums days (i - lowbit(i), i] counted from rollupFirstDay;
+// its columns are income, expense, then expense by category id.
+int rollupFirstDay = 0;
+int rollupDays = 0; // tree size, a power of two; 0 until the first build
+int rollupStride = 2;
+std::vector<int64_t> rollupTree;
+uint32_t rolledRows = 0;
+
+const int paddingDays = 366; // room for back-dated and future rows before a rebuild
+
+// Days since 1970-01-01; counting years from March puts the leap day last.
+int DaysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+int CivilFromDays(int days) {
+    days += 719468;
+    int era = (days >= 0 ? days : days - 146096) / 146097;
+    int dayOfEra = days - era * 146097;
+    int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int monthFromMarch = (5 * dayOfYear + 2) / 153;
+    int day = dayOfYear - (153 * monthFromMarch + 2) / 5 + 1;
+    int month = monthFromMarch < 10 ? monthFromMarch + 3 : monthFromMarch - 9;
+    int year = yearOfEra + era * 400 + (month <= 2);
+    return PackDate(year, month, day);
+}
+
+// Day number of a stored date, or of the first real day on or after a
+// range bound such as yyyymm00 or yyyy0231.
+int DayOnOrAfter(int packedDate) {
+    int year = packedDate / 10000;
+    int month = packedDate / 100 % 100;
+    int day = packedDate % 100;
+    if (month < 1) return DaysFromCivil(year, 1, 1);
+    if (month > 12) return DaysFromCivil(year + 1, 1, 1);
+    if (day > DaysInMonth(year, month)) return DaysFromCivil(year, month, DaysInMonth(year, month)) + 1;
+    return DaysFromCivil(year, month, std::max(day, 1));
+}
+
+// The last real day on or before a range bound such as yyyymm31.
+int DayOnOrBefore(int packedDate) {
+    int year = packedDate / 10000;
+    int month = packedDate / 100 % 100;
+    int day = packedDate % 100;
+    if (month < 1) return DaysFromCivil(year, 1, 1) - 1;
+    if (month > 12) return DaysFromCivil(year, 12, 31);
+    if (day < 1) return DaysFromCivil(year, month, 1) - 1;
+    return DaysFromCivil(year, month, std::min(day, DaysInMonth(year, month)));
+}
+
+inline void AddRowToNode(int64_t* node, uint32_t row, int64_t sign = 1) {
+    int64_t amount = transactions.amounts[row];
+    if (amount > 0) {
+        node[0] += sign * amount;
+    } else if (amount < 0) {
+        node[1] += sign * -amount;
+        node[2 + transactions.categoryIds[row]] += sign * -amount;
+    }
+}
+
+void BuildDayRollups(uint32_t rowCount) {
+    PROFILE_SCOPE("Day rollups");
+    rolledRows = rowCount;
+    int firstDay = INT_MAX;
+    int lastDay = INT_MIN;
+    for (uint32_t row = 0; row < rowCount; row++) {
+        if (transactions.dates[row] == 0) continue;
+        int day = DayOnOrAfter(transactions.dates[row]);
+        firstDay = std::min(firstDay, day);
+        lastDay = std::max(lastDay, day);
+    }
+    rollupTree.clear();
+    rollupDays = 0;
+    if (firstDay > lastDay) return;
+
+    rollupFirstDay = firstDay - paddingDays;
+    int span = lastDay - rollupFirstDay + 1 + paddingDays;
+    rollupDays = 1;
+    while (rollupDays < span) rollupDays *= 2;
+    // Category columns in steps of 8, so a new category rarely forces a rebuild.
+    rollupStride = 2 + (int)(categories.size() + 7) / 8 * 8;
+    rollupTree.assign((size_t)(rollupDays + 1) * rollupStride, 0);
+
+    // Per-day totals first, then each node passes its sums up to its parent:
+    // a linear build instead of one O(log days) update per row.
+    for (uint32_t row = 0; row < rowCount; row++) {
+        if (transactions.dates[row] == 0) continue;
+        int node = DayOnOrAfter(transactions.dates[row]) - rollupFirstDay + 1;
+        AddRowToNode(&rollupTree[(size_t)node * rollupStride], row);
+    }
+    for (int node = 1; node <= rollupDays; node++) {
+        int parent = node + (node & -node);
+        if (parent > rollupDays) continue;
+        const int64_t* from = &rollupTree[(size_t)node * rollupStride];
+        int64_t* to = &rollupTree[(size_t)parent * rollupStride];
+        for (int column = 0; column < rollupStride; column++) to[column] += from[column];
+    }
+}
+
+// Adds sign times the row's amounts along its day's update path.
+void AddRowToPath(uint32_t row, int64_t sign) {
+    for (int node = DayOnOrAfter(transactions.dates[row]) - rollupFirstDay + 1; node <= rollupDays;
+         node += node & -node) {
+        AddRowToNode(&rollupTree[(size_t)node * rollupStride], row, sign);
+    }
+}
+
+void AddRowsToDayRollups(uint32_t firstRow) {
+    uint32_t rowCount = (uint32_t)transactions.size();
+    bool rebuild = rollupDays == 0 || rowCount - firstRow > rolledRows;
+    for (uint32_t row = firstRow; row < rowCount && !rebuild; row++) {
+        if (transactions.dates[row] == 0) continue;
+        int node = DayOnOrAfter(transactions.dates[row]) - rollupFirstDay + 1;
+        rebuild = node < 1 || node > rollupDays || 2 + transactions.categoryIds[row] >= rollupStride;
+    }
+    if (rebuild) {
+        BuildDayRollups(rowCount);
+        return;
+    }
+
+    for (uint32_t row = firstRow; row < rowCount; row++) {
+        if (transactions.dates[row] != 0) AddRowToPath(row, 1);
+    }
+    rolledRows = rowCount;
+}
+
+void RemoveRowFromDayRollups(uint32_t row) {
+    if (row >= rolledRows || transactions.dates[row] == 0) return;
+    AddRowToPath(row, -1);
+}
+
+void InsertRowIntoDayRollups(uint32_t row) {
+    if (row >= rolledRows || transactions.dates[row] == 0) return;
+    int node = DayOnOrAfter(transactions.dates[row]) - rollupFirstDay + 1;
+    if (rollupDays == 0 || node < 1 || node > rollupDays || 2 + transactions.categoryIds[row] >= rollupStride) {
+        BuildDayRollups(rolledRows);
+        return;
+    }
+    AddRowToPath(row, 1);
+}
+
+// Adds sign * (sum of days 1 .. node) into `columns`.
+void AddPrefix(int node, int64_t sign, std::vector<int64_t>& columns) {
+    for (; node > 0; node -= node & -node) {
+        const int64_t* sums = &rollupTree[(size_t)node * rollupStride];
+        for (int column = 0; column < rollupStride; column++) columns[column] += sign * sums[column];
+    }
+}
+
+void GetRangeSummary(int firstDate, int lastDate, MonthSummary& totals) {
+    totals = MonthSummary();
+    if (rolledRows != transactions.size()) AddRowsToDayRollups(rolledRows);
+    if (rollupDays == 0 || firstDate > lastDate) return;
+
+    int first = firstDate <= 0 ? 1 : DayOnOrAfter(firstDate) - rollupFirstDay + 1;
+    int last = DayOnOrBefore(lastDate) - rollupFirstDay + 1;
+    first = std::max(first, 1);
+    last = std::min(last, rollupDays);
+    if (first > last) return;
+
+    std::vector<int64_t> columns(rollupStride, 0);
+    AddPrefix(last, 1, columns);
+    AddPrefix(first - 1, -1, columns);
+    totals.income = columns[0];
+    totals.expense = columns[1];
+    for (int category = 0; category + 2 < rollupStride && category < maxCategories; category++) {
+        totals.categoryExpense[category] = columns[2 + category];
+    }
+}
+
+void GetDailyTotals(int& firstDay, int& stride, std::vector<int64_t>& columns) {
+    if (rolledRows != transactions.size()) AddRowsToDayRollups(rolledRows);
+    stride = rollupStride;
+    columns.assign(rollupTree.begin(), rollupTree.end());
+    // Undo the build: each node, taken from the top down, still holds its
+    // whole range when its sums are taken back out of its parent.
+    for (int node = rollupDays; node >= 1; node--) {
+        int parent = node + (node & -node);
+        if (parent > rollupDays) continue;
+        for (int column = 0; column < stride; column++) {
+            columns[(size_t)parent * stride + column] -= columns[(size_t)node * stride + column];
+        }
+    }
+
+    // Node n is day n - 1; trim the padding and empty days at either end.
+    int first = 1;
+    int last = rollupDays;
+    auto empty = [&](int node) {
+        for (int column = 0; column < stride; column++) {
+            if (columns[(size_t)node * stride + column] != 0) return false;
+        }
+        return true;
+    };
+    while (first <= last && empty(first)) first++;
+    while (last >= first && empty(last)) last--;
+    firstDay = rollupFirstDay + first - 1;
+    if (first > last) {
+        columns.clear();
+        return;
+    }
+    columns.erase(columns.begin() + (size_t)(last + 1) * stride, columns.end());
+    columns.erase(columns.begin(), columns.begin() + (size_t)first * stride);
+}
+
+size_t GetDayRollupMemoryUsage() {
+    return rollupTree.capacity() * sizeof(int64_t);
+}
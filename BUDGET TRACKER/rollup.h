@@ -0,0 +1,29 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+// Day-level rollups for arbitrary date ranges. Income, expense and each
+// category's expense are kept as running sums over days in a Fenwick tree,
+// one node per day holding every column side by side, so a range total is
+// two prefix sums of O(log days) nodes whatever the number of rows, and a
+// new row updates O(log days) nodes. The ledger keeps it current with its
+// month summaries.
+
+#include "ledger.h"
+
+void BuildDayRollups(uint32_t rowCount); // from rows 0 .. rowCount - 1
+void AddRowsToDayRollups(uint32_t firstRow); // rows firstRow.. were appended since the last call
+// A row changed in place: remove it with its old values, insert it with the new.
+void RemoveRowFromDayRollups(uint32_t row);
+void InsertRowIntoDayRollups(uint32_t row);
+// Same totals as SumDateRange (inclusive yyyymmdd bounds) from the rollups;
+// like the month summaries, rows without a valid date are left out.
+void GetRangeSummary(int firstDate, int lastDate, MonthSummary& totals);
+// The same columns per day (income, expense, then expense by category id),
+// day firstDay + i at columns[i * stride], from the first day with any
+// amount to the last. Linear in days, not rows; empty with no dated rows.
+void GetDailyTotals(int& firstDay, int& stride, std::vector<int64_t>& columns);
+int DaysFromCivil(int year, int month, int day); // days since 1970-01-01
+int CivilFromDays(int days); // packed yyyymmdd
+size_t GetDayRollupMemoryUsage();
+
+#endif
@@ -0,0 +1,221 @@
+#include "rules.h"
+#include "snapshot.h"
+#include "profile.h"
+#include <fstream>
+#include <climits>
+#include <cctype>
+#include <cstring>
+
+RuleSet rules;
+std::string rulesPath = "rules.txt";
+
+enum RuleKind { RULE_KEYWORD, RULE_PREFIX, RULE_REGEX };
+
+struct TrieNode {
+    std::vector<std::pair<uint8_t, int>> children; // (byte class, node)
+    int fail = 0;
+};
+
+int FindChild(const TrieNode& node, uint8_t byteClass) {
+    for (const auto& child : node.children) {
+        if (child.first == byteClass) return child.second;
+    }
+    return -1;
+}
+
+void TrimText(std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    size_t last = text.find_last_not_of(" \t\r");
+    text = first == std::string::npos ? std::string() : text.substr(first, last - first + 1);
+}
+
+LoadStats LoadRules(const std::string& path, RuleSet& ruleSet) {
+    PROFILE_SCOPE("Load rules");
+    LoadStats stats = {0, 0};
+    ruleSet = RuleSet();
+    std::ifstream file(path);
+
+    // Parse every line first: the byte classes depend on all literals.
+    struct Literal { int rule; RuleKind kind; std::string text; };
+    std::vector<Literal> literals;
+    std::string line;
+    while (std::getline(file, line)) {
+        TrimText(line);
+        if (line.empty() || line[0] == '#') continue;
+        size_t space = line.find_first_of(" \t");
+        size_t arrow = line.rfind("=>");
+        if (space == std::string::npos || arrow == std::string::npos || arrow < space) {
+            stats.rowsSkipped++;
+            continue;
+        }
+        std::string kindName = line.substr(0, space);
+        std::string pattern = line.substr(space, arrow - space);
+        std::string category = line.substr(arrow + 2);
+        TrimText(pattern);
+        TrimText(category);
+
+        RuleKind kind = RULE_KEYWORD;
+        if (kindName == "keyword") kind = RULE_KEYWORD;
+        else if (kindName == "prefix") kind = RULE_PREFIX;
+        else if (kindName == "regex") kind = RULE_REGEX;
+        else pattern.clear();
+        if (pattern.empty() || category.empty()) {
+            stats.rowsSkipped++;
+            continue;
+        }
+
+        int rule = (int)ruleSet.ruleCategory.size();
+        if (kind == RULE_REGEX) {
+            try {
+                ruleSet.regexRules.push_back({rule, std::regex(pattern, std::regex::icase | std::regex::optimize)});
+            } catch (const std::regex_error&) {
+                stats.rowsSkipped++;
+                continue;
+            }
+        } else {
+            for (char& c : pattern) c = (char)tolower((unsigned char)c);
+            literals.push_back({rule, kind, pattern});
+        }
+        ruleSet.ruleCategory.push_back(GetCategoryId(category));
+        stats.rowsLoaded++;
+    }
+
+    // Bytes that never occur in a literal share class 0, which keeps the
+    // transition table a few dozen columns wide. Upper case maps to the
+    // class of its lower case letter.
+    int classCount = 1;
+    for (const auto& literal : literals) {
+        for (unsigned char c : literal.text) {
+            if (ruleSet.byteClass[c] == 0) ruleSet.byteClass[c] = (uint8_t)classCount++;
+        }
+    }
+    for (int c = 'A'; c <= 'Z'; c++) {
+        ruleSet.byteClass[c] = ruleSet.byteClass[tolower(c)];
+    }
+    ruleSet.classCount = classCount;
+
+    std::vector<TrieNode> trie(1);
+    ruleSet.depth.assign(1, 0);
+    ruleSet.keywordRule.assign(1, INT_MAX);
+    ruleSet.prefixRule.assign(1, INT_MAX);
+    for (const auto& literal : literals) {
+        int node = 0;
+        for (unsigned char c : literal.text) {
+            uint8_t byteClass = ruleSet.byteClass[c];
+            int child = FindChild(trie[node], byteClass);
+            if (child < 0) {
+                child = (int)trie.size();
+                trie[node].children.push_back({byteClass, child});
+                trie.emplace_back();
+                ruleSet.depth.push_back(ruleSet.depth[node] + 1);
+                ruleSet.keywordRule.push_back(INT_MAX);
+                ruleSet.prefixRule.push_back(INT_MAX);
+            }
+            node = child;
+        }
+        std::vector<int>& target = literal.kind == RULE_KEYWORD ? ruleSet.keywordRule : ruleSet.prefixRule;
+        target[node] = std::min(target[node], literal.rule);
+    }
+
+    // Breadth-first: fail links, inherited keyword matches and the full
+    // transition table, so matching never follows a fail link.
+    ruleSet.next.assign(trie.size() * classCount, 0);
+    std::vector<int> queue;
+    for (const auto& child : trie[0].children) {
+        ruleSet.next[child.first] = child.second;
+        queue.push_back(child.second);
+    }
+    for (size_t head = 0; head < queue.size(); head++) {
+        int node = queue[head];
+        int fail = trie[node].fail;
+        ruleSet.keywordRule[node] = std::min(ruleSet.keywordRule[node], ruleSet.keywordRule[fail]);
+        for (int byteClass = 0; byteClass < classCount; byteClass++) {
+            ruleSet.next[(size_t)node * classCount + byteClass] = ruleSet.next[(size_t)fail * classCount + byteClass];
+        }
+        for (const auto& child : trie[node].children) {
+            trie[child.second].fail = ruleSet.next[(size_t)fail * classCount + child.first];
+            ruleSet.next[(size_t)node * classCount + child.first] = child.second;
+            queue.push_back(child.second);
+        }
+    }
+    return stats;
+}
+
+int MatchRules(const RuleSet& ruleSet, const char* text, size_t length) {
+    int best = INT_MAX;
+    if (!ruleSet.next.empty()) {
+        int state = 0;
+        for (size_t i = 0; i < length; i++) {
+            state = ruleSet.next[(size_t)state * ruleSet.classCount + ruleSet.byteClass[(unsigned char)text[i]]];
+            best = std::min(best, ruleSet.keywordRule[state]);
+            // While the state still spells the whole text so far, it is a prefix.
+            if (ruleSet.depth[state] == (int)i + 1) best = std::min(best, ruleSet.prefixRule[state]);
+        }
+    }
+    for (const auto& regexRule : ruleSet.regexRules) {
+        if (regexRule.rule >= best) break;
+        if (std::regex_search(text, text + length, regexRule.pattern)) {
+            best = regexRule.rule;
+            break;
+        }
+    }
+    return best == INT_MAX ? -1 : ruleSet.ruleCategory[best];
+}
+
+size_t CategorizeRows(const RuleSet& ruleSet, uint32_t firstRow, uint32_t lastRow) {
+    PROFILE_SCOPE("Categorize rows");
+    if (ruleSet.ruleCategory.empty() || firstRow >= lastRow) return 0;
+
+    // Each distinct description is matched once, however many rows use it.
+    const int unmatched = -1;
+    const int unseen = -2;
+    std::vector<int> categoryByDescription(transactions.descriptions.Count(), unseen);
+    std::vector<uint32_t> pending;
+    for (uint32_t row = firstRow; row < lastRow; row++) {
+        int& category = categoryByDescription[transactions.descriptionIds[row]];
+        if (category == unseen) {
+            category = unmatched;
+            pending.push_back(transactions.descriptionIds[row]);
+        }
+    }
+    const size_t blockSize = 4096;
+    RunParallel((pending.size() + blockSize - 1) / blockSize, [&](size_t block) {
+        size_t last = std::min(pending.size(), (block + 1) * blockSize);
+        for (size_t i = block * blockSize; i < last; i++) {
+            const char* text = transactions.descriptions.Get(pending[i]);
+            categoryByDescription[pending[i]] = MatchRules(ruleSet, text, strlen(text));
+        }
+    });
+
+    const size_t rowsPerBlock = 1 << 16;
+    size_t blocks = (lastRow - firstRow + rowsPerBlock - 1) / rowsPerBlock;
+    std::vector<size_t> changed(blocks, 0);
+    RunParallel(blocks, [&](size_t block) {
+        uint32_t first = firstRow + (uint32_t)(block * rowsPerBlock);
+        uint32_t last = (uint32_t)std::min<size_t>(lastRow, first + rowsPerBlock);
+        for (uint32_t row = first; row < last; row++) {
+            int category = categoryByDescription[transactions.descriptionIds[row]];
+            if (category >= 0 && transactions.categoryIds[row] != category && !transactions.IsDeleted(row)) {
+                transactions.categoryIds[row] = (uint8_t)category;
+                changed[block]++;
+            }
+        }
+    });
+    size_t total = 0;
+    for (size_t count : changed) total += count;
+    return total;
+}
+
+bool ApplyRulesToLedger(size_t& changed) {
+    LoadRules(rulesPath, rules);
+    std::vector<uint8_t> before = transactions.categoryIds;
+    changed = CategorizeRows(rules, 0, (uint32_t)transactions.size());
+    if (changed == 0) return true;
+    if (!RewriteLedgerFile()) {
+        transactions.categoryIds.swap(before); // the file still has the old ones
+        changed = 0;
+        return false;
+    }
+    RebuildMonthSummaries();
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef RULES_H
+#define RULES_H
+
+// Auto-categorization from a rule file (rules.txt), one rule per line:
+//
+//   # comment
+//   keyword swiggy => Food          description contains "swiggy"
+//   prefix  ATM/ => Other           description starts with "ATM/"
+//   regex   ^NEFT.*SALARY => Income
+//
+// Matching ignores case and the first matching rule in file order wins.
+// Keyword and prefix rules compile into one Aho-Corasick automaton, so a
+// description is checked against every literal in a single pass; regex
+// rules only run when no earlier literal rule has matched. Rules are
+// matched once per distinct description, not once per row.
+
+#include "ledger.h"
+#include <regex>
+
+struct RegexRule {
+    int rule; // position in the file
+    std::regex pattern;
+};
+
+struct RuleSet {
+    // Automaton as a DFA over byte classes: next[state * classCount + byteClass[c]].
+    int classCount = 1;
+    uint8_t byteClass[256] = {};
+    std::vector<int> next;
+    std::vector<int> depth;       // length of the literal spelled by each state
+    std::vector<int> keywordRule; // lowest keyword rule ending at a state or its suffixes, INT_MAX if none
+    std::vector<int> prefixRule;  // lowest prefix rule spelling exactly this state, INT_MAX if none
+    std::vector<RegexRule> regexRules;
+    std::vector<int> ruleCategory; // category id by rule
+};
+
+extern RuleSet rules;
+extern std::string rulesPath; // defaults to "rules.txt"
+
+// Compiles `path` into `ruleSet`. rowsLoaded/rowsSkipped count rule lines;
+// malformed lines and bad regexes are skipped. Run on the UI thread, as
+// unknown category names are added to `categories`.
+LoadStats LoadRules(const std::string& path, RuleSet& ruleSet);
+// Category id of the first rule matching `text`, or -1.
+int MatchRules(const RuleSet& ruleSet, const char* text, size_t length);
+// Sets the category of every row in [firstRow, lastRow) whose description
+// matches a rule, in parallel. Returns the number of rows changed; month
+// summaries are left for the caller to rebuild.
+size_t CategorizeRows(const RuleSet& ruleSet, uint32_t firstRow, uint32_t lastRow);
+// Reloads rulesPath, recategorizes the whole ledger and, if anything
+// changed, rewrites the CSV and rebuilds the summaries. `changed` counts
+// the rows recategorized. Returns false, with the store as it was, if the
+// CSV could not be rewritten (see RewriteLedgerFile).
+bool ApplyRulesToLedger(size_t& changed);
+
+#endif
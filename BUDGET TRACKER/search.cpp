@@ -0,0 +1,555 @@
+#include "search.h"
+#include "profile.h"
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <cstdint>
+#include <queue>
+#include <functional>
+
+const uint32_t noEntry = UINT32_MAX;
+
+// Word index: each token's postings are a chain through flat arrays,
+// newest description first, so a token costs one slot however rare it is.
+StringTable searchTokens;              // distinct lower-cased words
+std::vector<uint32_t> tokenHead;       // by token id: its newest posting
+std::vector<uint32_t> tokenCounts;     // by token id: descriptions using it
+std::vector<uint32_t> postingNext;     // by posting: the token's previous posting
+std::vector<uint32_t> postingDescription;
+
+// Trigram index: ascending description ids by trigram code. Letters,
+// digits and space each have a code of their own; other bytes share the
+// rest, which only adds candidates the text check then drops.
+const int trigramBits = 18;
+std::vector<std::vector<uint32_t>> trigramPostings;
+
+std::vector<uint32_t> newestRow;  // by description id: its newest row
+std::vector<uint32_t> olderRow;   // by row: the previous row with the same description
+std::vector<uint32_t> rowCounts;  // by description id
+// Bounds on a description's rows, so a filter or a newest-first walk can
+// pass over it without visiting them. Removing a row leaves them as they
+// were, which keeps them bounds.
+std::vector<int> newestDates;           // by description id: no row is dated later
+std::vector<int> oldestDates;           // by description id: no row is dated earlier
+std::vector<uint16_t> sharedCategories; // by description id: every row's, or mixedCategories
+const uint16_t noCategory = 0xFFFF;
+const uint16_t mixedCategories = 0xFFFE;
+uint32_t indexedDescriptions = 0;
+
+// Query scratch by description id while walking rows: unscored until
+// seen (or marked as a candidate), then its score or noMatch. Only the
+// entries a query touched are reset after it.
+std::vector<uint8_t> descriptionScores;
+std::vector<uint32_t> scoredDescriptions; // touched by the query in flight, besides its candidates
+const uint8_t unscored = 0;
+const uint8_t candidate = 254;
+const uint8_t noMatch = 255;
+const size_t maxTerms = 8; // keeps 3 * terms below candidate
+
+// A query with more candidate descriptions than this is not narrowed down
+// further; its newest rows are checked one by one instead.
+const size_t broadQuery = 4096;
+// Past this many, marking a broad query's candidates costs more than
+// scoring the descriptions its newest rows turn up.
+const size_t markedCandidates = 16 * broadQuery;
+// Rows walked in about the time it takes to score one candidate row.
+const size_t scoredRowCost = 64;
+// A walk without candidates looks them up after all once the descriptions
+// it still has to score, going by its matches so far, look like more.
+const size_t unmarkedScores = 4096;
+
+bool TokenLess(uint32_t a, uint32_t b) {
+    return strcmp(searchTokens.Get(a), searchTokens.Get(b)) < 0;
+}
+
+RowOrder tokenOrder = {TokenLess, {}, {}, {}}; // token ids in text order, for prefix lookups
+
+inline char LowerByte(char c) {
+    return c >= 'A' && c <= 'Z' ? (char)(c + ('a' - 'A')) : c;
+}
+
+// Letters, digits and any UTF-8 byte; everything else separates words.
+inline bool IsWordByte(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || (unsigned char)c >= 0x80;
+}
+
+inline uint32_t TrigramCode(char c) {
+    if (c >= 'a' && c <= 'z') return c - 'a' + 1;
+    if (c >= '0' && c <= '9') return c - '0' + 27;
+    if (c == ' ') return 37;
+    return 38 + (unsigned char)c % 26;
+}
+
+inline uint32_t PackTrigram(const char* text) {
+    return (TrigramCode(text[0]) << 12) | (TrigramCode(text[1]) << 6) | TrigramCode(text[2]);
+}
+
+void IndexDescription(uint32_t description, std::vector<uint32_t>& newTokens) {
+    std::string text = transactions.descriptions.Get(description);
+    for (char& c : text) c = LowerByte(c);
+
+    for (size_t i = 0; i < text.size();) {
+        if (!IsWordByte(text[i])) {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < text.size() && IsWordByte(text[i])) i++;
+        uint32_t token = searchTokens.Intern(text.data() + start, i - start);
+        if (token == tokenHead.size()) {
+            tokenHead.push_back(noEntry);
+            tokenCounts.push_back(0);
+            newTokens.push_back(token);
+        }
+        uint32_t head = tokenHead[token];
+        if (head != noEntry && postingDescription[head] == description) continue; // word repeated
+        tokenHead[token] = (uint32_t)postingDescription.size();
+        tokenCounts[token]++;
+        postingNext.push_back(head);
+        postingDescription.push_back(description);
+    }
+    for (size_t i = 0; i + 3 <= text.size(); i++) {
+        std::vector<uint32_t>& postings = trigramPostings[PackTrigram(text.data() + i)];
+        if (postings.empty() || postings.back() != description) postings.push_back(description);
+    }
+}
+
+void BuildSearchIndex() {
+    PROFILE_SCOPE("Search index");
+    searchTokens.Clear();
+    tokenHead.clear();
+    tokenCounts.clear();
+    postingNext.clear();
+    postingDescription.clear();
+    tokenOrder.Clear();
+    trigramPostings.assign((size_t)1 << trigramBits, {});
+    newestRow.clear();
+    olderRow.clear();
+    rowCounts.clear();
+    newestDates.clear();
+    oldestDates.clear();
+    sharedCategories.clear();
+    descriptionScores.clear();
+    scoredDescriptions.clear();
+    indexedDescriptions = 0;
+    AddRowsToSearchIndex(0);
+}
+
+// Descriptions are interned in order, so new ones are always the last ids.
+void IndexNewDescriptions() {
+    if (trigramPostings.empty()) trigramPostings.resize((size_t)1 << trigramBits);
+    std::vector<uint32_t> newTokens;
+    uint32_t descriptionCount = (uint32_t)transactions.descriptions.Count();
+    for (; indexedDescriptions < descriptionCount; indexedDescriptions++) {
+        IndexDescription(indexedDescriptions, newTokens);
+    }
+    tokenOrder.InsertMany(newTokens);
+    newestRow.resize(descriptionCount, noEntry);
+    rowCounts.resize(descriptionCount, 0);
+    newestDates.resize(descriptionCount, INT32_MIN);
+    oldestDates.resize(descriptionCount, INT32_MAX);
+    sharedCategories.resize(descriptionCount, noCategory);
+    descriptionScores.resize(descriptionCount, 0);
+}
+
+inline void WidenDescriptionBounds(uint32_t row) {
+    uint32_t description = transactions.descriptionIds[row];
+    uint16_t category = transactions.categoryIds[row];
+    uint16_t& shared = sharedCategories[description];
+    if (shared == noCategory) shared = category;
+    else if (shared != category) shared = mixedCategories;
+    newestDates[description] = std::max(newestDates[description], transactions.dates[row]);
+    oldestDates[description] = std::min(oldestDates[description], transactions.dates[row]);
+}
+
+void AddRowsToSearchIndex(uint32_t firstRow) {
+    IndexNewDescriptions();
+    for (uint32_t row = firstRow; row < transactions.size(); row++) {
+        if (transactions.IsDeleted(row)) {
+            olderRow.push_back(noEntry);
+            continue;
+        }
+        uint32_t description = transactions.descriptionIds[row];
+        olderRow.push_back(newestRow[description]);
+        newestRow[description] = row;
+        rowCounts[description]++;
+        WidenDescriptionBounds(row);
+    }
+}
+
+void RemoveRowFromSearchIndex(uint32_t row) {
+    if (row >= olderRow.size()) return;
+    uint32_t description = transactions.descriptionIds[row];
+    for (uint32_t* link = &newestRow[description]; *link != noEntry; link = &olderRow[*link]) {
+        if (*link == row) {
+            *link = olderRow[row];
+            olderRow[row] = noEntry;
+            if (--rowCounts[description] == 0) {
+                newestDates[description] = INT32_MIN;
+                oldestDates[description] = INT32_MAX;
+                sharedCategories[description] = noCategory;
+            }
+            return;
+        }
+    }
+}
+
+void InsertRowIntoSearchIndex(uint32_t row) {
+    if (row >= olderRow.size()) return;
+    IndexNewDescriptions();
+    uint32_t description = transactions.descriptionIds[row];
+    uint32_t* link = &newestRow[description];
+    while (*link != noEntry && *link > row) link = &olderRow[*link]; // the chain stays newest first
+    olderRow[row] = *link;
+    *link = row;
+    rowCounts[description]++;
+    WidenDescriptionBounds(row);
+}
+
+void RefreshSearchBounds() {
+    // Only an index that covers the rows; a stale one is rebuilt before use.
+    if (olderRow.size() != transactions.size() || indexedDescriptions != transactions.descriptions.Count()) return;
+    std::fill(newestDates.begin(), newestDates.end(), INT32_MIN);
+    std::fill(oldestDates.begin(), oldestDates.end(), INT32_MAX);
+    std::fill(sharedCategories.begin(), sharedCategories.end(), noCategory);
+    for (uint32_t row = 0; row < transactions.size(); row++) {
+        if (!transactions.IsDeleted(row)) WidenDescriptionBounds(row);
+    }
+}
+
+size_t GetSearchIndexMemoryUsage() {
+    size_t bytes = searchTokens.MemoryUsage() + trigramPostings.capacity() * sizeof(std::vector<uint32_t>);
+    for (const auto& postings : trigramPostings) bytes += postings.capacity() * sizeof(uint32_t);
+    return bytes + (tokenHead.capacity() + tokenCounts.capacity() + postingNext.capacity() + postingDescription.capacity() +
+                    tokenOrder.main.capacity() + tokenOrder.pending.capacity() + newestRow.capacity() +
+                    olderRow.capacity() + rowCounts.capacity() + scoredDescriptions.capacity()) * sizeof(uint32_t) +
+           (newestDates.capacity() + oldestDates.capacity()) * sizeof(int) +
+           sharedCategories.capacity() * sizeof(uint16_t) + descriptionScores.capacity();
+}
+
+// How well `term` (lower case) matches lower-cased `text`: 3 if it equals a
+// word, 2 if it starts one, 1 if it only occurs inside one, 0 if absent.
+// Terms shorter than three characters only count as word prefixes.
+int ScoreTerm(const std::string& text, const std::string& term) {
+    int best = 0;
+    for (size_t at = text.find(term); at != std::string::npos; at = text.find(term, at + 1)) {
+        bool wordStart = at == 0 || !IsWordByte(text[at - 1]);
+        size_t end = at + term.size();
+        if (!wordStart) {
+            if (term.size() >= 3) best = std::max(best, 1);
+        } else if (end == text.size() || !IsWordByte(text[end]) || !IsWordByte(term.back())) {
+            return 3;
+        } else {
+            best = 2;
+        }
+    }
+    return best;
+}
+
+std::string scoreText; // reused, as most descriptions outgrow the small-string buffer
+
+int ScoreDescription(uint32_t description, const std::vector<std::string>& terms) {
+    std::string& text = scoreText;
+    text = transactions.descriptions.Get(description);
+    for (char& c : text) c = LowerByte(c);
+    int score = 0;
+    for (const std::string& term : terms) {
+        int termScore = ScoreTerm(text, term);
+        if (termScore == 0) return 0;
+        score += termScore;
+    }
+    return score;
+}
+
+// Token ids whose text starts with `prefix`, from one sorted run.
+void FindTokenPrefix(const std::vector<uint32_t>& sorted, const std::string& prefix, std::vector<uint32_t>& out) {
+    auto first = std::lower_bound(sorted.begin(), sorted.end(), prefix, [](uint32_t token, const std::string& value) {
+        return strcmp(searchTokens.Get(token), value.c_str()) < 0;
+    });
+    for (auto it = first; it != sorted.end(); ++it) {
+        if (strncmp(searchTokens.Get(*it), prefix.c_str(), prefix.size()) != 0) break;
+        out.push_back(*it);
+    }
+}
+
+// The best score `term` can reach in any description, from the word index
+// alone: 3 if it is a word, 2 if it starts one, otherwise 1.
+int BestTermScore(const std::string& term, std::vector<uint32_t>& tokens) {
+    for (char c : term) {
+        if (!IsWordByte(c)) return 3; // spans words; only the text can tell
+    }
+    tokens.clear();
+    FindTokenPrefix(tokenOrder.main, term, tokens);
+    FindTokenPrefix(tokenOrder.pending, term, tokens);
+    for (uint32_t token : tokens) {
+        if (searchTokens.Get(token)[term.size()] == '\0') return 3;
+    }
+    return tokens.empty() ? 1 : 2;
+}
+
+// Keeps the ids of `out` that are also in `other`; both ascending.
+void IntersectPostings(std::vector<uint32_t>& out, const std::vector<uint32_t>& other) {
+    size_t kept = 0;
+    auto from = other.begin();
+    for (uint32_t description : out) {
+        // Galloping: `other` is usually far longer, and the next match is
+        // rarely far ahead of the last one.
+        size_t step = 1;
+        while (step < (size_t)(other.end() - from) && from[step] < description) step *= 2;
+        from = std::lower_bound(from, from + std::min(step + 1, (size_t)(other.end() - from)), description);
+        if (from == other.end()) break;
+        if (*from == description) out[kept++] = description;
+    }
+    out.resize(kept);
+}
+
+// Descriptions that can contain every term: those holding all trigrams of
+// the long terms, or for short terms only, a word starting with the one
+// whose words are rarest. Returns true with ascending ids. A broad query
+// returns false and a cheaper superset instead, in no particular order, or
+// unless `whole`, none at all if it would be too large to be worth marking.
+bool FindCandidates(const std::vector<std::string>& terms, bool whole, std::vector<uint32_t>& out) {
+    out.clear();
+    std::vector<const std::vector<uint32_t>*> lists;
+    std::vector<const std::vector<uint32_t>*> rarestByTerm;
+    for (const std::string& term : terms) {
+        for (size_t i = 0; i + 3 <= term.size(); i++) {
+            const std::vector<uint32_t>& postings = trigramPostings[PackTrigram(term.data() + i)];
+            if (postings.empty()) return true;
+            lists.push_back(&postings);
+            if (i == 0) rarestByTerm.push_back(&postings);
+            if (postings.size() < rarestByTerm.back()->size()) rarestByTerm.back() = &postings;
+        }
+    }
+
+    if (lists.empty()) {
+        std::vector<uint32_t> tokens;
+        std::vector<uint32_t> rarest;
+        size_t postings = SIZE_MAX;
+        for (const std::string& term : terms) {
+            tokens.clear();
+            FindTokenPrefix(tokenOrder.main, term, tokens);
+            FindTokenPrefix(tokenOrder.pending, term, tokens);
+            size_t count = 0;
+            for (uint32_t token : tokens) count += tokenCounts[token];
+            if (count < postings) {
+                postings = count;
+                rarest.swap(tokens);
+            }
+        }
+        if (postings > broadQuery && !whole) return false;
+        for (uint32_t token : rarest) {
+            for (uint32_t posting = tokenHead[token]; posting != noEntry; posting = postingNext[posting]) {
+                out.push_back(postingDescription[posting]);
+            }
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+        return postings <= broadQuery;
+    }
+
+    std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) {
+        return a->size() < b->size();
+    });
+    if (lists[0]->size() > markedCandidates && !whole) return false;
+    out = *lists[0];
+    if (out.size() > broadQuery) {
+        // Too many to narrow down trigram by trigram, but one list for each
+        // other term still drops the candidates missing one of its words.
+        for (size_t i = 0; i < rarestByTerm.size() && out.size() <= markedCandidates; i++) {
+            if (rarestByTerm[i] != lists[0]) IntersectPostings(out, *rarestByTerm[i]);
+        }
+        return false;
+    }
+    // Against a much longer list, checking the text of each candidate later
+    // is cheaper than intersecting.
+    for (size_t i = 1; i < lists.size() && !out.empty() && lists[i]->size() < 16 * out.size(); i++) {
+        if (lists[i] != lists[i - 1]) IntersectPostings(out, *lists[i]);
+    }
+    return true;
+}
+
+inline bool RowPassesFilter(uint32_t row, const SearchFilter& filter) {
+    int date = transactions.dates[row];
+    return date >= filter.firstDate && date <= filter.lastDate &&
+           (filter.categoryId < 0 || transactions.categoryIds[row] == filter.categoryId);
+}
+
+inline bool NewerRow(uint32_t a, uint32_t b) {
+    int dateA = transactions.dates[a];
+    int dateB = transactions.dates[b];
+    return dateA != dateB ? dateA > dateB : a > b;
+}
+
+// Sorts newest row first.
+inline uint64_t RowRecency(uint32_t row) {
+    return (uint64_t)(uint32_t)transactions.dates[row] << 32 | row;
+}
+
+// Few candidates: score them in order of their newest row, keeping every
+// row the filter lets through. Stops once `limit` rows have the best score
+// the query can have and no candidate left has a row newer than theirs.
+void CollectScoredRows(const std::vector<uint32_t>& candidates, const std::vector<std::string>& terms,
+                       int bestScore, const SearchFilter& filter, size_t limit, std::vector<uint32_t>& out) {
+    std::vector<std::pair<uint64_t, uint32_t>> order; // (no row more recent, description)
+    order.reserve(candidates.size());
+    for (uint32_t description : candidates) {
+        if (rowCounts[description] > 0) {
+            order.push_back({(uint64_t)(uint32_t)newestDates[description] << 32 | UINT32_MAX, description});
+        }
+    }
+    std::sort(order.begin(), order.end(), std::greater<std::pair<uint64_t, uint32_t>>());
+    std::vector<std::pair<int, uint32_t>> matches; // (score, row)
+    std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> best; // newest best rows
+    for (const auto& next : order) {
+        if (limit > 0 && best.size() >= limit && best.top() > next.first) break;
+        int score = -1;
+        for (uint32_t row = newestRow[next.second]; row != noEntry; row = olderRow[row]) {
+            if (!RowPassesFilter(row, filter)) continue;
+            if (score < 0) score = ScoreDescription(next.second, terms);
+            if (score == 0) break;
+            matches.push_back({score, row});
+            if (score < bestScore) continue;
+            best.push(RowRecency(row));
+            if (best.size() > limit) best.pop();
+        }
+    }
+    size_t taken = std::min(limit, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + taken, matches.end(),
+                      [](const std::pair<int, uint32_t>& a, const std::pair<int, uint32_t>& b) {
+                          return a.first != b.first ? a.first > b.first : NewerRow(a.second, b.second);
+                      });
+    for (size_t i = 0; i < taken; i++) out.push_back(matches[i].second);
+}
+
+// Many matches: walk the date index from the newest end, scoring each
+// description the first time one of its rows comes up, or with
+// `candidates`, only the descriptions among them; an empty query matches
+// every row. Stops once `limit` rows reach the best score the query can
+// have, which for everyday words happens within the first few hundred
+// rows. Returns false, with nothing collected, once the rows still to walk,
+// going by how often the best score has come up so far, look like more
+// than `fallbackRows`, or without candidates, the descriptions still to
+// score look like more than unmarkedScores.
+bool CollectNewestRows(const std::vector<uint32_t>* candidates, const std::vector<std::string>& terms,
+                       int bestScore, const SearchFilter& filter, size_t limit, size_t fallbackRows,
+                       std::vector<uint32_t>& out) {
+    if (candidates) {
+        for (uint32_t description : *candidates) descriptionScores[description] = candidate;
+    }
+    const uint8_t toScore = candidates ? candidate : unscored;
+    std::vector<std::vector<uint32_t>> levels(bestScore + 1);
+    RowSpan span = GetRowsInDateRange(filter.firstDate, filter.lastDate);
+    const uint32_t* it = span.last;
+    for (size_t walked = 1; it != span.first && levels[bestScore].size() < limit; walked++) {
+        if (walked % 4096 == 0 && walked * limit / (levels[bestScore].size() + 1) - walked > fallbackRows) break;
+        uint32_t row = *--it;
+        if (filter.categoryId >= 0 && transactions.categoryIds[row] != filter.categoryId) continue;
+        int score = bestScore;
+        if (!terms.empty()) {
+            uint32_t description = transactions.descriptionIds[row];
+            uint8_t& known = descriptionScores[description];
+            if (known == toScore) {
+                size_t scored = scoredDescriptions.size();
+                if (!candidates && scored > 0 && scored % 256 == 0 &&
+                    scored * limit / (levels[bestScore].size() + 1) - scored > unmarkedScores) {
+                    break;
+                }
+                int found = ScoreDescription(description, terms);
+                if (!candidates) scoredDescriptions.push_back(description);
+                known = found > 0 ? (uint8_t)found : noMatch;
+            }
+            if (known == unscored || known == noMatch) continue; // unscored: not a candidate
+            score = known;
+        }
+        if (levels[score].size() < limit) levels[score].push_back(row);
+    }
+    if (candidates) {
+        for (uint32_t description : *candidates) descriptionScores[description] = unscored;
+    }
+    for (uint32_t description : scoredDescriptions) descriptionScores[description] = unscored;
+    scoredDescriptions.clear();
+    if (it != span.first && levels[bestScore].size() < limit) return false;
+    for (int score = bestScore; score > 0; score--) {
+        for (size_t i = 0; i < levels[score].size() && out.size() < limit; i++) out.push_back(levels[score][i]);
+    }
+    return true;
+}
+
+void SearchTransactions(const std::string& query, const SearchFilter& filter, size_t limit,
+                        std::vector<uint32_t>& out) {
+    out.clear();
+    if (olderRow.size() != transactions.size()) {
+        BuildSearchIndex(); // rows appended without going through the ledger
+    }
+    limit = std::min(limit, transactions.size()); // keeps the walks' projections in range
+
+    std::vector<std::string> terms;
+    std::string term;
+    for (size_t i = 0; i <= query.size(); i++) {
+        if (i == query.size() || query[i] == ' ' || query[i] == '\t') {
+            if (!term.empty() && terms.size() < maxTerms) terms.push_back(term);
+            term.clear();
+        } else {
+            term += LowerByte(query[i]);
+        }
+    }
+    if (terms.empty()) {
+        CollectNewestRows(nullptr, terms, 1, filter, limit, SIZE_MAX, out);
+        return;
+    }
+    std::sort(terms.begin(), terms.end(), [](const std::string& a, const std::string& b) {
+        return a.size() > b.size();
+    });
+
+    int bestScore = 0;
+    std::vector<uint32_t> tokens;
+    for (const std::string& queryTerm : terms) bestScore += BestTermScore(queryTerm, tokens);
+
+    // Too many candidates to mark: score descriptions as the newest rows
+    // turn them up, unless the matches prove rare.
+    std::vector<uint32_t> candidates;
+    bool broad = !FindCandidates(terms, false, candidates) && candidates.empty();
+    if (broad) {
+        if (CollectNewestRows(nullptr, terms, bestScore, filter, limit, SIZE_MAX, out)) return;
+        FindCandidates(terms, true, candidates);
+    }
+
+    // Drop the candidates the filter rules out by their bounds alone. No
+    // row newer than the newest candidate row can match.
+    SearchFilter bounded = filter;
+    int newest = INT32_MIN;
+    size_t candidateRows = 0;
+    size_t kept = 0;
+    for (uint32_t description : candidates) {
+        uint32_t rows = rowCounts[description];
+        int newestDate = newestDates[description];
+        if (rows == 0 || newestDate < filter.firstDate) continue;
+        if (newestDate > filter.lastDate && oldestDates[description] > filter.lastDate) continue;
+        if (filter.categoryId >= 0) {
+            uint16_t shared = sharedCategories[description];
+            if (shared != mixedCategories && shared != filter.categoryId) continue;
+        }
+        newest = std::max(newest, newestDate);
+        candidateRows += rows;
+        candidates[kept++] = description;
+    }
+    candidates.resize(kept);
+    bounded.lastDate = std::min(filter.lastDate, newest);
+    if (candidateRows <= 4 * broadQuery) {
+        CollectScoredRows(candidates, terms, bestScore, bounded, limit, out);
+        return;
+    }
+
+    // The newest matches of a broad query can sit behind any number of
+    // newer rows that do not match; starting again below them skips those.
+    if (broad && bounded.lastDate < filter.lastDate &&
+        CollectNewestRows(nullptr, terms, bestScore, bounded, limit, SIZE_MAX, out)) {
+        return;
+    }
+    // With a few thousand candidates, the walk gives up once the best
+    // matches prove too rare for it to beat scoring their rows.
+    size_t fallbackRows = candidateRows <= markedCandidates ? candidateRows * scoredRowCost : SIZE_MAX;
+    if (CollectNewestRows(&candidates, terms, bestScore, bounded, limit, fallbackRows, out)) return;
+    CollectScoredRows(candidates, terms, bestScore, bounded, limit, out);
+}
@@ -0,0 +1,42 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+// Full-text search over transaction descriptions. Descriptions are interned
+// (TransactionStore::descriptions), so the index covers each distinct text
+// once:
+//   - an inverted token index (lower-cased letter/digit runs), sorted so
+//     short queries can be answered as token prefixes;
+//   - a trigram index, so any query of three or more characters is a
+//     substring search over the few descriptions holding all its trigrams;
+//   - per description, a chain of its rows, newest first, and bounds on
+//     their dates and categories.
+// The ledger keeps it current: BuildSearchIndex runs after a load,
+// AddRowsToSearchIndex after rows are appended, and edits and deletes take
+// a row out of its chain and put it back.
+
+#include "ledger.h"
+
+struct SearchFilter {
+    int firstDate = 0;          // inclusive yyyymmdd bounds
+    int lastDate = 99999999;
+    int categoryId = -1;        // -1 for any category
+};
+
+// Rows whose description contains every whitespace-separated term of
+// `query` (case ignored), best match first: a term equal to a word ranks
+// above a word prefix, which ranks above a substring; ties go to the
+// newest. An empty query matches every row. Fills `out` with at most
+// `limit` rows.
+void SearchTransactions(const std::string& query, const SearchFilter& filter, size_t limit,
+                        std::vector<uint32_t>& out);
+
+void BuildSearchIndex();
+void AddRowsToSearchIndex(uint32_t firstRow); // rows firstRow.. were appended since the last call
+// A row changed in place: remove it under its old description, insert it under the new.
+void RemoveRowFromSearchIndex(uint32_t row);
+void InsertRowIntoSearchIndex(uint32_t row);
+// Categories changed in place (rules applied, say); RebuildMonthSummaries calls it.
+void RefreshSearchBounds();
+size_t GetSearchIndexMemoryUsage();
+
+#endif
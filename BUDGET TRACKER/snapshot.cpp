@@ -0,0 +1,521 @@
+#include "snapshot.h"
+#include "journal.h"
+#include "watch.h"
+#include "profile.h"
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+const char snapshotMagic[8] = {'B', 'T', 'S', 'N', 'A', 'P', '\0', '\0'};
+uint64_t snapshotCsvBytes = 0; // CSV prefix covered by the snapshot on disk, 0 if unknown
+uint64_t snapshotCsvFingerprint = 0;
+double compactionRatio = 0.25;
+const size_t compactionMinLines = 256; // not worth a rewrite below this
+
+std::string GetSnapshotPath() {
+    std::string path = ledgerPath;
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0) {
+        path.resize(path.size() - 4);
+    }
+    return path + ".snap";
+}
+
+// Zigzag varint, so the small forward and backward steps between
+// neighbouring rows take one or two bytes.
+void AppendVarint(std::string& out, int64_t value) {
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    while (zigzag >= 0x80) {
+        out.push_back((char)(zigzag | 0x80));
+        zigzag >>= 7;
+    }
+    out.push_back((char)zigzag);
+}
+
+bool DecodeDates(const uint8_t* data, size_t length, size_t count, std::vector<int>& dates) {
+    const uint8_t* end = data + length;
+    dates.resize(count);
+    int64_t date = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t zigzag = 0;
+        for (int shift = 0;; shift += 7) {
+            if (data == end || shift > 63) return false;
+            uint8_t byte = *data++;
+            zigzag |= (uint64_t)(byte & 0x7f) << shift;
+            if (byte < 0x80) break;
+        }
+        date += (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+        dates[i] = (int)date;
+    }
+    return data == end;
+}
+
+bool ReadSnapshot(const MappedFile& snapshot, const MappedFile& csv, LoadStats& stats) {
+    SnapshotHeader header;
+    if (snapshot.size < sizeof(header)) return false;
+    memcpy(&header, snapshot.data, sizeof(header));
+    if (memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0 ||
+        header.version != snapshotVersion || header.headerBytes != sizeof(header)) {
+        return false;
+    }
+    if (header.csvBytes == 0 || header.csvBytes > csv.size ||
+        FingerprintCSV(csv.data, header.csvBytes) != header.csvFingerprint) {
+        return false;
+    }
+
+    uint64_t rows = header.rowCount;
+    for (int block = 0; block < SNAPSHOT_BLOCK_COUNT; block++) {
+        uint64_t offset = header.blockOffset[block];
+        if (offset % 8 != 0 || offset > snapshot.size || header.blockBytes[block] > snapshot.size - offset) {
+            return false;
+        }
+    }
+    if (rows > UINT32_MAX || header.blockBytes[SNAPSHOT_CATEGORY_IDS] != rows ||
+        header.blockBytes[SNAPSHOT_AMOUNTS] != rows * sizeof(int64_t) ||
+        header.blockBytes[SNAPSHOT_DESCRIPTION_IDS] != rows * sizeof(uint32_t) ||
+        header.blockBytes[SNAPSHOT_DESCRIPTION_OFFSETS] % sizeof(uint32_t) != 0 ||
+        header.blockBytes[SNAPSHOT_DESCRIPTION_SLOTS] % sizeof(uint32_t) != 0 ||
+        header.blockBytes[SNAPSHOT_DELETED_ROWS] % sizeof(uint32_t) != 0) {
+        return false;
+    }
+    auto block = [&](int index) { return snapshot.data + header.blockOffset[index]; };
+
+    // Category names map snapshot ids onto this build's ids; usually the
+    // identity, but a changed default list must not mislabel rows.
+    std::vector<uint8_t> categoryMap;
+    bool identity = true;
+    const char* name = block(SNAPSHOT_CATEGORIES);
+    const char* namesEnd = name + header.blockBytes[SNAPSHOT_CATEGORIES];
+    while (name < namesEnd) {
+        const char* nameEnd = (const char*)memchr(name, '\0', namesEnd - name);
+        if (!nameEnd || categoryMap.size() == maxCategories) return false;
+        int id = GetCategoryId(std::string(name, nameEnd));
+        identity = identity && id == (int)categoryMap.size();
+        categoryMap.push_back((uint8_t)id);
+        name = nameEnd + 1;
+    }
+
+    size_t descriptionCount = header.blockBytes[SNAPSHOT_DESCRIPTION_OFFSETS] / sizeof(uint32_t);
+    size_t arenaBytes = header.blockBytes[SNAPSHOT_DESCRIPTION_ARENA];
+    size_t slotCount = header.blockBytes[SNAPSHOT_DESCRIPTION_SLOTS] / sizeof(uint32_t);
+    if ((slotCount & (slotCount - 1)) != 0 || descriptionCount * 2 > slotCount ||
+        (arenaBytes > 0 && block(SNAPSHOT_DESCRIPTION_ARENA)[arenaBytes - 1] != '\0')) {
+        return false;
+    }
+
+    transactions.clear();
+    if (!DecodeDates((const uint8_t*)block(SNAPSHOT_DATES), header.blockBytes[SNAPSHOT_DATES], rows,
+                     transactions.dates)) {
+        return false;
+    }
+    const uint8_t* categoryIds = (const uint8_t*)block(SNAPSHOT_CATEGORY_IDS);
+    transactions.categoryIds.assign(categoryIds, categoryIds + rows);
+    for (uint8_t& id : transactions.categoryIds) {
+        if (id >= categoryMap.size()) return false;
+        if (!identity) id = categoryMap[id];
+    }
+    transactions.amounts.resize(rows);
+    memcpy(transactions.amounts.data(), block(SNAPSHOT_AMOUNTS), rows * sizeof(int64_t));
+    transactions.descriptionIds.resize(rows);
+    memcpy(transactions.descriptionIds.data(), block(SNAPSHOT_DESCRIPTION_IDS), rows * sizeof(uint32_t));
+    for (uint32_t id : transactions.descriptionIds) {
+        if (id >= descriptionCount) return false;
+    }
+
+    StringTable& descriptions = transactions.descriptions;
+    descriptions.offsets.resize(descriptionCount);
+    memcpy(descriptions.offsets.data(), block(SNAPSHOT_DESCRIPTION_OFFSETS), descriptionCount * sizeof(uint32_t));
+    for (uint32_t offset : descriptions.offsets) {
+        if (offset >= arenaBytes) return false;
+    }
+    descriptions.arena.assign(block(SNAPSHOT_DESCRIPTION_ARENA), arenaBytes);
+    descriptions.slots.resize(slotCount);
+    memcpy(descriptions.slots.data(), block(SNAPSHOT_DESCRIPTION_SLOTS), slotCount * sizeof(uint32_t));
+    for (uint32_t slot : descriptions.slots) {
+        if (slot > descriptionCount) return false;
+    }
+
+    const uint32_t* deletedRows = (const uint32_t*)block(SNAPSHOT_DELETED_ROWS);
+    size_t deletedCount = header.blockBytes[SNAPSHOT_DELETED_ROWS] / sizeof(uint32_t);
+    for (size_t i = 0; i < deletedCount; i++) {
+        uint32_t row = deletedRows[i];
+        if (row >= rows || transactions.IsDeleted(row)) return false;
+        if (transactions.deleted.size() <= row) transactions.deleted.resize(row + 1, false);
+        transactions.deleted[row] = true;
+    }
+    transactions.deletedCount = deletedCount;
+    transactions.recordLines = header.recordLines;
+
+    const char* end = FindLinesEnd(csv.data + header.csvBytes, csv.data + csv.size);
+    LoadStats tail = AppendCSVRange(csv.data + header.csvBytes, end);
+    stats.rowsLoaded = rows + tail.rowsLoaded;
+    stats.rowsSkipped = tail.rowsSkipped;
+    snapshotCsvBytes = header.csvBytes;
+    snapshotCsvFingerprint = header.csvFingerprint;
+    ledgerLoadedBytes = end - csv.data;
+    ledgerLoadedFingerprint = FingerprintCSV(csv.data, ledgerLoadedBytes);
+    return true;
+}
+
+bool LoadSnapshot(LoadStats& stats) {
+    PROFILE_SCOPE("Load snapshot");
+    MappedFile snapshot;
+    if (!OpenMappedFile(GetSnapshotPath(), snapshot)) return false;
+    bool loaded = false;
+    MappedFile csv;
+    if (snapshot.data && OpenMappedFile(ledgerPath, csv)) {
+        loaded = csv.data && ReadSnapshot(snapshot, csv, stats);
+        CloseMappedFile(csv);
+    }
+    CloseMappedFile(snapshot);
+    if (!loaded) {
+        transactions.clear();
+        return false;
+    }
+    RebuildLedgerIndexes();
+    return true;
+}
+
+LoadStats LoadLedger() {
+    LoadStats stats = {0, 0};
+    if (LoadSnapshot(stats)) return stats;
+    snapshotCsvBytes = 0;
+    return LoadTransactionsFromCSV();
+}
+
+bool RenameOver(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+bool SaveSnapshot() {
+    PROFILE_SCOPE("Save snapshot");
+    if (!FlushJournal()) return false; // the store holds rows the file never got
+    // The snapshot covers the prefix the store holds, not the whole file:
+    // rows other programs appended since are parsed by the next load.
+    MappedFile csv;
+    if (!OpenMappedFile(ledgerPath, csv)) return false;
+    bool held = CatchUpOwnWrites(csv);
+    CloseMappedFile(csv);
+    uint64_t csvBytes = ledgerLoadedBytes;
+    uint64_t fingerprint = ledgerLoadedFingerprint;
+    if (!held || csvBytes == 0) return false;
+    if (csvBytes == snapshotCsvBytes && fingerprint == snapshotCsvFingerprint) {
+        return true; // nothing appended since the last one
+    }
+
+    std::string names;
+    for (const auto& category : categories) {
+        names += category;
+        names.push_back('\0');
+    }
+    // The columns as the CSV numbers them: after a compaction, without the
+    // rows it dropped.
+    TransactionStore inFile;
+    const TransactionStore* store = &transactions;
+    if (!transactions.fileRowIds.empty()) {
+        for (uint32_t row = 0; row < transactions.size(); row++) {
+            if (transactions.FileRowId(row) == noFileRow) continue;
+            inFile.dates.push_back(transactions.dates[row]);
+            inFile.categoryIds.push_back(transactions.categoryIds[row]);
+            inFile.amounts.push_back(transactions.amounts[row]);
+            inFile.descriptionIds.push_back(transactions.descriptionIds[row]);
+            if (transactions.IsDeleted(row)) {
+                inFile.deleted.resize(inFile.size(), false);
+                inFile.deleted.back() = true;
+            }
+        }
+        store = &inFile;
+    }
+    std::vector<uint32_t> deletedRows;
+    for (uint32_t row = 0; row < store->deleted.size(); row++) {
+        if (store->deleted[row]) deletedRows.push_back(row);
+    }
+    std::string dates;
+    dates.reserve(store->size() * 2);
+    int previous = 0;
+    for (int date : store->dates) {
+        AppendVarint(dates, (int64_t)date - previous);
+        previous = date;
+    }
+
+    const StringTable& descriptions = transactions.descriptions;
+    const void* blockData[SNAPSHOT_BLOCK_COUNT] = {
+        names.data(), dates.data(), store->categoryIds.data(), store->amounts.data(),
+        store->descriptionIds.data(), descriptions.offsets.data(), descriptions.arena.data(),
+        descriptions.slots.data(), deletedRows.data()};
+
+    SnapshotHeader header = {};
+    memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshotVersion;
+    header.headerBytes = sizeof(header);
+    header.rowCount = store->size();
+    header.csvBytes = csvBytes;
+    header.csvFingerprint = fingerprint;
+    header.recordLines = transactions.recordLines;
+    header.blockBytes[SNAPSHOT_CATEGORIES] = names.size();
+    header.blockBytes[SNAPSHOT_DATES] = dates.size();
+    header.blockBytes[SNAPSHOT_CATEGORY_IDS] = store->categoryIds.size();
+    header.blockBytes[SNAPSHOT_AMOUNTS] = store->amounts.size() * sizeof(int64_t);
+    header.blockBytes[SNAPSHOT_DESCRIPTION_IDS] = store->descriptionIds.size() * sizeof(uint32_t);
+    header.blockBytes[SNAPSHOT_DESCRIPTION_OFFSETS] = descriptions.offsets.size() * sizeof(uint32_t);
+    header.blockBytes[SNAPSHOT_DESCRIPTION_ARENA] = descriptions.arena.size();
+    header.blockBytes[SNAPSHOT_DESCRIPTION_SLOTS] = descriptions.slots.size() * sizeof(uint32_t);
+    header.blockBytes[SNAPSHOT_DELETED_ROWS] = deletedRows.size() * sizeof(uint32_t);
+    uint64_t offset = sizeof(header);
+    for (int block = 0; block < SNAPSHOT_BLOCK_COUNT; block++) {
+        offset = (offset + 7) & ~(uint64_t)7;
+        header.blockOffset[block] = offset;
+        offset += header.blockBytes[block];
+    }
+
+    // Written beside the old snapshot and renamed over it, so a crash
+    // leaves either the old snapshot or the new one, never half of one.
+    std::string path = GetSnapshotPath();
+    std::string tempPath = path + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    const char padding[8] = {};
+    file.write((const char*)&header, sizeof(header));
+    uint64_t written = sizeof(header);
+    for (int block = 0; block < SNAPSHOT_BLOCK_COUNT; block++) {
+        file.write(padding, header.blockOffset[block] - written);
+        file.write((const char*)blockData[block], header.blockBytes[block]);
+        written = header.blockOffset[block] + header.blockBytes[block];
+    }
+    file.close();
+    if (!file || !RenameOver(tempPath, path)) {
+        remove(tempPath.c_str());
+        return false;
+    }
+    snapshotCsvBytes = csvBytes;
+    snapshotCsvFingerprint = fingerprint;
+    return true;
+}
+
+// Header, then `keptLines` (lines of the ledger the loader skips), then the
+// live rows of `store`, whose category ids index `names`.
+bool WriteLiveRows(const TransactionStore& store, const std::vector<std::string>& names, const std::string& path,
+                   const std::string& keptLines) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    std::string text = csvHeader;
+    text += keptLines;
+    for (uint32_t row = 0; row < store.size(); row++) {
+        if (store.IsDeleted(row)) continue;
+        AppendCSVRow(text, store, names, row);
+        if (text.size() >= (1 << 20)) {
+            file.write(text.data(), text.size());
+            text.clear();
+        }
+    }
+    file.write(text.data(), text.size());
+    return (bool)file;
+}
+
+bool ExportTransactionsToCSV(const std::string& path) {
+    PROFILE_SCOPE("Export CSV");
+    return WriteLiveRows(transactions, categories, path, std::string());
+}
+
+// Renames tempPath over the ledger, locked by BeginLedgerReplace; the
+// store now holds all of the new file.
+bool ReplaceLedgerFile(const std::string& tempPath) {
+    MappedFile written;
+    bool ok = OpenMappedFile(tempPath, written);
+    uint64_t bytes = written.size;
+    uint64_t fingerprint = written.data ? FingerprintCSV(written.data, written.size) : 0;
+    CloseMappedFile(written);
+    ok = ok && RenameOver(tempPath, ledgerPath);
+    if (ok) SetLedgerHeld(bytes, fingerprint);
+    UnlockLedgerFile();
+    if (!ok) remove(tempPath.c_str());
+    return ok;
+}
+
+bool RewriteLedgerFile() {
+    PROFILE_SCOPE("Rewrite ledger");
+    StopCompaction();
+    if (!BeginLedgerReplace()) return false;
+    // The store has no trace of the lines it skipped; they are only in the file.
+    MappedFile csv;
+    bool mapped = OpenMappedFile(ledgerPath, csv);
+    std::string keptLines;
+    uint64_t held = mapped ? std::min<uint64_t>(ledgerLoadedBytes, csv.size) : 0;
+    const char* body = held ? (const char*)memchr(csv.data, '\n', held) : nullptr;
+    if (body) keptLines = CollectSkippedLines(body + 1, csv.data + held);
+    if (mapped) CloseMappedFile(csv);
+    std::string tempPath = ledgerPath + ".tmp";
+    if (!WriteLiveRows(transactions, categories, tempPath, keptLines)) {
+        UnlockLedgerFile();
+        remove(tempPath.c_str());
+        return false;
+    }
+    if (!ReplaceLedgerFile(tempPath)) return false;
+    ReopenJournal();
+    RenumberFileRows((uint32_t)transactions.size());
+    return true;
+}
+
+// The compaction in flight. The writer thread reads the CSV prefix the
+// store held when it started, not the store, which edits go on changing.
+std::thread compactionThread;
+std::atomic<bool> compactionDone(false);
+bool compactionWritten = false;
+uint64_t compactionBytes = 0;
+uint64_t compactionFingerprint = 0;
+std::vector<uint32_t> compactionFileRows; // new file row id by old, noFileRow if dropped
+uint32_t compactionKeptRows = 0;
+size_t compactionRetryDead = 0; // after a failed write, wait for this many dead lines
+
+std::string GetCompactionPath() {
+    return ledgerPath + ".compact";
+}
+
+// Lines of the CSV that are records or deleted rows. Rows a compaction
+// already dropped are deleted but no longer in the file.
+size_t GetDeadLedgerLines() {
+    size_t dropped = transactions.fileRowIds.size() - transactions.fileRowBase;
+    return transactions.recordLines + transactions.deletedCount - dropped;
+}
+
+// Replays the first `bytes` of the ledger at `csvPath` into a store of its
+// own and writes its live rows to `path`, numbering them in compactionFileRows.
+bool WriteCompactedLedger(const std::string& csvPath, const std::string& path, uint64_t bytes, uint64_t fingerprint) {
+    PROFILE_SCOPE("Compact ledger");
+    MappedFile csv;
+    if (!OpenMappedFile(csvPath, csv)) return false;
+    TransactionStore store;
+    std::vector<std::string> names;
+    std::string keptLines;
+    bool current = csv.size >= bytes && FingerprintCSV(csv.data, bytes) == fingerprint;
+    const char* body = current ? (const char*)memchr(csv.data, '\n', bytes) : nullptr;
+    if (body) ReadCSVRange(body + 1, csv.data + bytes, store, names, keptLines);
+    CloseMappedFile(csv);
+    if (!current) return false;
+    compactionFileRows.assign(store.size(), noFileRow);
+    uint32_t kept = 0;
+    for (uint32_t row = 0; row < store.size(); row++) {
+        if (!store.IsDeleted(row)) compactionFileRows[row] = kept++;
+    }
+    compactionKeptRows = kept;
+    return WriteLiveRows(store, names, path, keptLines);
+}
+
+// Copies the ledger lines in [begin, end), which follow the compacted
+// prefix, with their records renumbered for the compacted file. Records
+// naming a row it dropped are left out. Returns the records kept.
+size_t CopyLinesAfterCompaction(const char* begin, const char* end, std::string& out) {
+    size_t records = 0;
+    uint32_t dropped = (uint32_t)compactionFileRows.size() - compactionKeptRows;
+    for (const char* line = begin; line < end;) {
+        const char* next = (const char*)memchr(line, '\n', end - line);
+        next = next ? next + 1 : end;
+        const char* digits = line + 8;
+        bool record = next - line > 8 && (memcmp(line, "#update,", 8) == 0 || memcmp(line, "#delete,", 8) == 0);
+        uint64_t fileRow = 0;
+        const char* p = digits;
+        while (record && p < next && (unsigned)(*p - '0') <= 9 && fileRow < UINT32_MAX) fileRow = fileRow * 10 + (*p++ - '0');
+        if (!record || p == digits || fileRow >= UINT32_MAX) {
+            out.append(line, next); // a data line, or one the loader skips either way
+        } else {
+            uint32_t newRow = fileRow < compactionFileRows.size() ? compactionFileRows[fileRow] : (uint32_t)fileRow - dropped;
+            if (newRow != noFileRow) {
+                out.append(line, 8);
+                out += std::to_string(newRow);
+                out.append(p, next);
+                records++;
+            }
+        }
+        line = next;
+    }
+    return records;
+}
+
+void FinishCompaction() {
+    compactionThread.join();
+    std::string tempPath = GetCompactionPath();
+    if (!compactionWritten) {
+        remove(tempPath.c_str());
+        compactionFileRows.clear();
+        compactionRetryDead = GetDeadLedgerLines() + compactionMinLines;
+        return;
+    }
+
+    // Whatever reached the old file after the compacted prefix, our rows
+    // and records or rows tailed from other programs, is in the store once
+    // the journal is drained; it is appended to the new file before that
+    // replaces the old one.
+    if (!BeginLedgerReplace()) {
+        remove(tempPath.c_str());
+        compactionFileRows.clear();
+        return;
+    }
+    MappedFile csv;
+    bool ok = OpenMappedFile(ledgerPath, csv) && CatchUpOwnWrites(csv) && compactionBytes <= ledgerLoadedBytes &&
+              FingerprintCSV(csv.data, compactionBytes) == compactionFingerprint;
+    std::string tail;
+    size_t records = ok ? CopyLinesAfterCompaction(csv.data + compactionBytes, csv.data + ledgerLoadedBytes, tail) : 0;
+    CloseMappedFile(csv);
+    if (!ok || (!tail.empty() && !AppendToLedgerFile(tempPath, tail, false)) || !ReplaceLedgerFile(tempPath)) {
+        UnlockLedgerFile();
+        remove(tempPath.c_str());
+        compactionFileRows.clear();
+        compactionRetryDead = GetDeadLedgerLines() + compactionMinLines;
+        return;
+    }
+    ReopenJournal();
+    RemapFileRows(compactionFileRows, compactionKeptRows, records);
+    compactionFileRows.clear();
+}
+
+bool ParseCompactionPercent(const char* text, double& ratio) {
+    char* end = nullptr;
+    double percent = strtod(text, &end);
+    if (end == text || *end != '\0' || !(percent >= 0.0 && percent <= 100.0)) return false;
+    ratio = percent / 100.0;
+    return true;
+}
+
+void CompactLedgerIfNeeded() {
+    if (compactionThread.joinable()) {
+        if (compactionDone) FinishCompaction();
+        return;
+    }
+    if (compactionRatio <= 0 || !IsJournalRunning()) return;
+    size_t dead = GetDeadLedgerLines();
+    size_t fileLines = transactions.size() + transactions.recordLines -
+                       (transactions.fileRowIds.size() - transactions.fileRowBase);
+    if (dead < compactionMinLines || dead < compactionRetryDead || (double)dead < compactionRatio * fileLines) return;
+
+    if (ledgerLoadedBytes == 0) return;
+    compactionBytes = ledgerLoadedBytes;
+    compactionFingerprint = ledgerLoadedFingerprint;
+    compactionRetryDead = 0;
+    compactionDone = false;
+    compactionWritten = false;
+    compactionThread = std::thread([csvPath = ledgerPath, path = GetCompactionPath(), bytes = compactionBytes,
+                                    fingerprint = compactionFingerprint]() {
+        compactionWritten = WriteCompactedLedger(csvPath, path, bytes, fingerprint);
+        compactionDone = true;
+    });
+}
+
+void StopCompaction() {
+    if (!compactionThread.joinable()) return;
+    compactionThread.join();
+    compactionFileRows.clear();
+    remove(GetCompactionPath().c_str());
+}
@@ -0,0 +1,255 @@
+#include "table.h"
+#include "profile.h"
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <climits>
+
+std::vector<uint8_t> categoryRanks;     // by category id, position in name order
+std::vector<uint32_t> descriptionRanks; // by description id, position in text order
+size_t rankedCategories = 0;
+uint32_t rankedDescriptions = 0;
+
+inline unsigned char LowerChar(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? (unsigned char)(c + ('a' - 'A')) : c;
+}
+
+// Case-insensitive, then byte order, so distinct texts never tie.
+bool DescriptionTextLess(uint32_t a, uint32_t b) {
+    const unsigned char* textA = (const unsigned char*)transactions.descriptions.Get(a);
+    const unsigned char* textB = (const unsigned char*)transactions.descriptions.Get(b);
+    for (size_t i = 0;; i++) {
+        unsigned char lowerA = LowerChar(textA[i]);
+        unsigned char lowerB = LowerChar(textB[i]);
+        if (lowerA != lowerB) return lowerA < lowerB;
+        if (lowerA == 0) break;
+    }
+    int order = strcmp((const char*)textA, (const char*)textB);
+    return order != 0 ? order < 0 : a < b;
+}
+
+RowOrder descriptionOrder = {DescriptionTextLess, {}, {}, {}}; // description ids in text order
+
+struct TextPrefix {
+    uint64_t high; // lower-cased bytes 0-7, big-endian so they compare as text
+    uint64_t low;  // bytes 8-15
+    uint32_t id;
+};
+
+bool CategoryRowLess(uint32_t a, uint32_t b) {
+    uint8_t rankA = categoryRanks[transactions.categoryIds[a]];
+    uint8_t rankB = categoryRanks[transactions.categoryIds[b]];
+    return rankA != rankB ? rankA < rankB : RowDateLess(a, b);
+}
+
+bool AmountRowLess(uint32_t a, uint32_t b) {
+    int64_t amountA = transactions.amounts[a];
+    int64_t amountB = transactions.amounts[b];
+    return amountA != amountB ? amountA < amountB : RowDateLess(a, b);
+}
+
+bool DescriptionRowLess(uint32_t a, uint32_t b) {
+    uint32_t rankA = descriptionRanks[transactions.descriptionIds[a]];
+    uint32_t rankB = descriptionRanks[transactions.descriptionIds[b]];
+    return rankA != rankB ? rankA < rankB : RowDateLess(a, b);
+}
+
+RowOrder categoryRows = {CategoryRowLess, {}, {}, {}};
+RowOrder amountRows = {AmountRowLess, {}, {}, {}};
+RowOrder descriptionRows = {DescriptionRowLess, {}, {}, {}};
+
+// Description ranks are spread over the whole uint32_t range, so a new
+// description usually takes a free rank between its neighbours in text
+// order and no other rank changes. Only a batch of new ones, or a gap
+// used up, spreads them all out again.
+const size_t rankSpreadBatch = 1024;
+
+void SpreadDescriptionRanks() {
+    descriptionOrder.Flush();
+    const std::vector<uint32_t>& ids = descriptionOrder.main;
+    uint64_t step = (1ULL << 32) / (ids.size() + 1);
+    for (size_t i = 0; i < ids.size(); i++) descriptionRanks[ids[i]] = (uint32_t)((i + 1) * step);
+}
+
+// Gives `id`, already in descriptionOrder, the rank halfway between its
+// neighbours; false if they leave no room.
+bool PlaceDescriptionRank(uint32_t id) {
+    uint64_t low = 0;          // ranks are strictly between low and high
+    uint64_t high = 1ULL << 32;
+    for (const std::vector<uint32_t>* ids : {&descriptionOrder.main, &descriptionOrder.pending}) {
+        auto it = std::lower_bound(ids->begin(), ids->end(), id, DescriptionTextLess);
+        auto next = it != ids->end() && *it == id ? it + 1 : it;
+        if (it != ids->begin()) low = std::max<uint64_t>(low, descriptionRanks[*(it - 1)]);
+        if (next != ids->end()) high = std::min<uint64_t>(high, descriptionRanks[*next]);
+    }
+    if (high - low < 2) return false;
+    descriptionRanks[id] = (uint32_t)(low + (high - low) / 2);
+    return true;
+}
+
+// New names get ranks in between the old ones; the old ones keep their
+// relative order, so every row order stays sorted.
+void UpdateRanks() {
+    if (categories.size() != rankedCategories) {
+        std::vector<uint8_t> byName(categories.size());
+        std::iota(byName.begin(), byName.end(), 0);
+        std::sort(byName.begin(), byName.end(), [](uint8_t a, uint8_t b) { return categories[a] < categories[b]; });
+        categoryRanks.resize(categories.size());
+        for (size_t i = 0; i < byName.size(); i++) categoryRanks[byName[i]] = (uint8_t)i;
+        rankedCategories = categories.size();
+    }
+    uint32_t descriptionCount = (uint32_t)transactions.descriptions.Count();
+    if (descriptionCount != rankedDescriptions) {
+        // Descriptions are interned in row order, so new ones are always the
+        // last ids. Sorting on their first 16 lower-cased bytes settles most
+        // comparisons, even between "Payment ref ..." style texts, without
+        // reading the text again.
+        std::vector<TextPrefix> keyed;
+        keyed.reserve(descriptionCount - rankedDescriptions);
+        for (uint32_t id = rankedDescriptions; id < descriptionCount; id++) {
+            const unsigned char* text = (const unsigned char*)transactions.descriptions.Get(id);
+            TextPrefix key = {0, 0, id};
+            for (int i = 0; i < 16 && text[i] != 0; i++) {
+                (i < 8 ? key.high : key.low) |= (uint64_t)LowerChar(text[i]) << (56 - i % 8 * 8);
+            }
+            keyed.push_back(key);
+        }
+        std::sort(keyed.begin(), keyed.end(), [](const TextPrefix& a, const TextPrefix& b) {
+            if (a.high != b.high) return a.high < b.high;
+            return a.low != b.low ? a.low < b.low : DescriptionTextLess(a.id, b.id);
+        });
+        descriptionRanks.resize(descriptionCount);
+        bool spread = keyed.size() >= rankSpreadBatch;
+        size_t placed = 0;
+        for (; !spread && placed < keyed.size(); placed++) {
+            descriptionOrder.Insert(keyed[placed].id);
+            spread = !PlaceDescriptionRank(keyed[placed].id);
+        }
+        if (spread) {
+            std::vector<uint32_t> newDescriptions;
+            for (size_t i = placed; i < keyed.size(); i++) newDescriptions.push_back(keyed[i].id);
+            descriptionOrder.InsertMany(newDescriptions);
+            SpreadDescriptionRanks();
+        }
+        rankedDescriptions = descriptionCount;
+    }
+}
+
+// Stable LSD radix sort of `byDate` on the low `keyBytes` bytes of
+// key(row), so rows with equal keys stay in date order. Keys are read
+// again on every pass rather than stored, which keeps the extra memory to
+// one row array. They are taken relative to the smallest, so a narrow
+// range of large values leaves high bytes every row shares, and those
+// passes are skipped.
+template <typename KeyFunction>
+void SortRowsByKey(const std::vector<uint32_t>& byDate, int keyBytes, KeyFunction key, std::vector<uint32_t>& out) {
+    uint64_t smallest = UINT64_MAX;
+    for (uint32_t row : byDate) smallest = std::min(smallest, key(row));
+    std::vector<size_t> counts((size_t)keyBytes * 256, 0);
+    for (uint32_t row : byDate) {
+        uint64_t value = key(row) - smallest;
+        for (int byte = 0; byte < keyBytes; byte++) counts[byte * 256 + (value >> (byte * 8) & 0xFF)]++;
+    }
+    out = byDate;
+    std::vector<uint32_t> scratch(out.size());
+    for (int byte = 0; byte < keyBytes; byte++) {
+        size_t* bucket = &counts[byte * 256];
+        if (std::find(bucket, bucket + 256, out.size()) != bucket + 256) continue;
+        size_t offset = 0;
+        for (int i = 0; i < 256; i++) {
+            size_t count = bucket[i];
+            bucket[i] = offset;
+            offset += count;
+        }
+        for (uint32_t row : out) scratch[bucket[(key(row) - smallest) >> (byte * 8) & 0xFF]++] = row;
+        out.swap(scratch);
+    }
+}
+
+void ResetTableOrders() {
+    categoryRanks.clear();
+    descriptionRanks.clear();
+    descriptionOrder.Clear();
+    rankedCategories = 0;
+    rankedDescriptions = 0;
+    categoryRows.Clear();
+    amountRows.Clear();
+    descriptionRows.Clear();
+}
+
+inline uint64_t CategoryKey(uint32_t row) {
+    return categoryRanks[transactions.categoryIds[row]];
+}
+
+inline uint64_t AmountKey(uint32_t row) {
+    return (uint64_t)transactions.amounts[row] ^ (1ULL << 63); // two's complement to unsigned order
+}
+
+inline uint64_t DescriptionKey(uint32_t row) {
+    return descriptionRanks[transactions.descriptionIds[row]];
+}
+
+void BuildTableOrders() {
+    PROFILE_SCOPE("Table orders");
+    UpdateRanks();
+    std::vector<uint32_t> byDate;
+    dateOrder.GetFirst(0, dateOrder.size(), byDate);
+    categoryRows.Clear();
+    amountRows.Clear();
+    SortRowsByKey(byDate, 1, CategoryKey, categoryRows.main);
+    SortRowsByKey(byDate, 8, AmountKey, amountRows.main);
+    if (descriptionRows.size() == byDate.size()) return;
+    descriptionRows.Clear();
+    SortRowsByKey(byDate, 4, DescriptionKey, descriptionRows.main);
+}
+
+void AddRowsToTableOrders(uint32_t firstRow) {
+    UpdateRanks();
+    // The new rows sorted once per order the same way as a full build, so
+    // each insert is a single merge.
+    std::vector<uint32_t> byDate;
+    for (uint32_t row = firstRow; row < transactions.size(); row++) {
+        if (!transactions.IsDeleted(row)) byDate.push_back(row);
+    }
+    if (!std::is_sorted(byDate.begin(), byDate.end(), RowDateLess)) std::sort(byDate.begin(), byDate.end(), RowDateLess);
+    std::vector<uint32_t> rows;
+    SortRowsByKey(byDate, 1, CategoryKey, rows);
+    categoryRows.InsertMany(rows);
+    SortRowsByKey(byDate, 8, AmountKey, rows);
+    amountRows.InsertMany(rows);
+    SortRowsByKey(byDate, 4, DescriptionKey, rows);
+    descriptionRows.InsertMany(rows);
+}
+
+void RemoveRowFromTableOrders(uint32_t row) {
+    categoryRows.Remove(row);
+    amountRows.Remove(row);
+    descriptionRows.Remove(row);
+}
+
+void InsertRowIntoTableOrders(uint32_t row) {
+    UpdateRanks();
+    categoryRows.Insert(row);
+    amountRows.Insert(row);
+    descriptionRows.Insert(row);
+}
+
+void GetTableRows(TableColumn column, bool descending, size_t skip, size_t count, std::vector<uint32_t>& out) {
+    const RowOrder& order = column == COLUMN_CATEGORY ? categoryRows
+                          : column == COLUMN_AMOUNT ? amountRows
+                          : column == COLUMN_DESCRIPTION ? descriptionRows
+                          : dateOrder;
+    if (descending) {
+        order.GetLast(skip, count, out);
+    } else {
+        order.GetFirst(skip, count, out);
+    }
+}
+
+size_t GetTableOrderMemoryUsage() {
+    size_t bytes = categoryRanks.capacity() * sizeof(uint8_t) + descriptionRanks.capacity() * sizeof(uint32_t);
+    for (const RowOrder* order : {&descriptionOrder, &categoryRows, &amountRows, &descriptionRows}) {
+        bytes += (order->main.capacity() + order->pending.capacity() + order->removed.capacity()) * sizeof(uint32_t);
+    }
+    return bytes;
+}
@@ -0,0 +1,31 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+// Sort orders for the full ledger table. Besides the date index, the rows
+// are kept as three permutations, by category name, amount and description
+// text (case ignored), each with ties in date order, so the table reads any
+// window of any order in O(log rows) and never sorts on the UI thread. A
+// load builds them with stable radix passes over the date order; appended
+// rows are inserted like new dates (RowOrder), and edited rows are taken
+// out and inserted again. Category and description names are compared
+// through rank tables; a new name is ranked between its neighbours, so no
+// row is reordered and, for descriptions, no other rank usually changes.
+
+#include "ledger.h"
+
+enum TableColumn { COLUMN_DATE, COLUMN_CATEGORY, COLUMN_AMOUNT, COLUMN_DESCRIPTION };
+
+void ResetTableOrders(); // before the columns are reloaded
+// The category and amount orders, after those columns change in place, and
+// the description order if it was reset (edits keep it current).
+void BuildTableOrders();
+void AddRowsToTableOrders(uint32_t firstRow); // rows firstRow.. were appended since the last call
+// A row changed in place: remove it with its old values, insert it with the new.
+void RemoveRowFromTableOrders(uint32_t row);
+void InsertRowIntoTableOrders(uint32_t row);
+// Up to `count` rows in `column` order, starting `skip` rows from the
+// first (or, if `descending`, from the last).
+void GetTableRows(TableColumn column, bool descending, size_t skip, size_t count, std::vector<uint32_t>& out);
+size_t GetTableOrderMemoryUsage();
+
+#endif
@@ -0,0 +1,195 @@
+#include "text.h"
+#include "ledger.h"
+#include "profile.h"
+#include "rlgl.h"
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+const int uiFontSizes[] = {14, 16, 18, 20, 24, 28, 32};
+const int uiFontCount = sizeof(uiFontSizes) / sizeof(uiFontSizes[0]);
+const float uiTextSpacing = 1;
+const float uiLineSpacing = 2;
+Font uiFonts[uiFontCount];
+bool uiFontsOwned = false; // false while they are raylib's default font
+
+// A glyph's rectangle in its atlas and where it goes, relative to the
+// string's position.
+struct GlyphQuad {
+    Rectangle source;
+    Rectangle dest;
+};
+
+struct TextLayout {
+    std::string text;
+    float size = 0;
+    int font = 0;
+    std::vector<GlyphQuad> glyphs;
+    Vector2 extent = {0, 0};
+    uint64_t lastFrame = 0;
+};
+
+struct QueuedGlyph {
+    Rectangle source;
+    Rectangle dest;
+    Color color;
+};
+
+std::unordered_map<uint64_t, TextLayout> textLayouts;
+std::vector<QueuedGlyph> textQueues[uiFontCount];
+uint64_t textFrame = 0;
+const uint64_t textLayoutFrames = 600; // unused this long, a layout is dropped
+const size_t textBatchQuads = 1024;    // well inside rlgl's default batch
+
+bool LoadUIFonts(const char* path) {
+    UnloadUIFonts();
+    uiFontsOwned = true;
+    for (int i = 0; i < uiFontCount; i++) {
+        uiFonts[i] = LoadFontEx(path, uiFontSizes[i], nullptr, 0);
+        if (uiFonts[i].texture.id == 0) uiFontsOwned = false;
+    }
+    if (!uiFontsOwned) {
+        for (int i = 0; i < uiFontCount; i++) {
+            if (uiFonts[i].texture.id != 0) UnloadFont(uiFonts[i]);
+            uiFonts[i] = GetFontDefault();
+        }
+        return false;
+    }
+    // Sizes between the baked ones are scaled down from the next larger.
+    for (int i = 0; i < uiFontCount; i++) SetTextureFilter(uiFonts[i].texture, TEXTURE_FILTER_BILINEAR);
+    return true;
+}
+
+void UnloadUIFonts() {
+    FlushUIText();
+    textLayouts.clear();
+    if (uiFontsOwned) {
+        for (int i = 0; i < uiFontCount; i++) UnloadFont(uiFonts[i]);
+    }
+    uiFontsOwned = false;
+}
+
+int PickUIFont(float size) {
+    for (int i = 0; i < uiFontCount; i++) {
+        if (uiFontSizes[i] >= size) return i;
+    }
+    return uiFontCount - 1;
+}
+
+// Places glyphs the way raylib's DrawTextEx does, with a spacing of 1.
+void BuildTextLayout(TextLayout& layout) {
+    const Font& font = uiFonts[layout.font];
+    float scale = layout.size / font.baseSize;
+    float padding = font.glyphPadding * scale;
+    float x = 0;
+    float y = 0;
+    float width = 0;
+    const char* text = layout.text.c_str();
+    for (size_t i = 0; i < layout.text.size();) {
+        int bytes = 0;
+        int codepoint = GetCodepointNext(text + i, &bytes);
+        i += bytes;
+        if (codepoint == '\n') {
+            width = std::max(width, x - uiTextSpacing);
+            x = 0;
+            y += layout.size + uiLineSpacing;
+            continue;
+        }
+        int index = GetGlyphIndex(font, codepoint);
+        const Rectangle& rec = font.recs[index];
+        const GlyphInfo& glyph = font.glyphs[index];
+        if (codepoint != ' ' && codepoint != '\t') {
+            GlyphQuad quad;
+            quad.source = {rec.x - font.glyphPadding, rec.y - font.glyphPadding,
+                           rec.width + 2.0f * font.glyphPadding, rec.height + 2.0f * font.glyphPadding};
+            quad.dest = {x + glyph.offsetX * scale - padding, y + glyph.offsetY * scale - padding,
+                         quad.source.width * scale, quad.source.height * scale};
+            layout.glyphs.push_back(quad);
+        }
+        x += (glyph.advanceX != 0 ? glyph.advanceX : rec.width) * scale + uiTextSpacing;
+    }
+    width = std::max(width, x - uiTextSpacing);
+    layout.extent = {std::max(width, 0.0f), y + layout.size};
+}
+
+const TextLayout& GetTextLayout(const char* text, float size) {
+    size_t length = strlen(text);
+    uint64_t key = HashBytes(text, length) ^ ((uint64_t)(size * 64.0f) * 0x9e3779b97f4a7c15ULL);
+    TextLayout& layout = textLayouts[key];
+    layout.lastFrame = textFrame;
+    if (layout.size == size && layout.text.size() == length && memcmp(layout.text.data(), text, length) == 0) {
+        return layout;
+    }
+    // New, or a hash collision: lay it out again.
+    layout.text.assign(text, length);
+    layout.size = size;
+    layout.font = PickUIFont(size);
+    layout.glyphs.clear();
+    BuildTextLayout(layout);
+    return layout;
+}
+
+void DrawUIText(const char* text, Vector2 position, float size, Color color) {
+    const TextLayout& layout = GetTextLayout(text, size);
+    // Whole pixels keep glyphs drawn at their baked size sharp.
+    float x = std::floor(position.x + 0.5f);
+    float y = std::floor(position.y + 0.5f);
+    std::vector<QueuedGlyph>& queue = textQueues[layout.font];
+    for (const GlyphQuad& quad : layout.glyphs) {
+        queue.push_back({quad.source, {x + quad.dest.x, y + quad.dest.y, quad.dest.width, quad.dest.height}, color});
+    }
+}
+
+Vector2 MeasureUIText(const char* text, float size) {
+    return GetTextLayout(text, size).extent;
+}
+
+void FlushUIText() {
+    for (int i = 0; i < uiFontCount; i++) {
+        std::vector<QueuedGlyph>& queue = textQueues[i];
+        if (queue.empty()) continue;
+        PROFILE_SCOPE("Text flush");
+        const Texture2D& atlas = uiFonts[i].texture;
+        float width = (float)atlas.width;
+        float height = (float)atlas.height;
+        for (size_t first = 0; first < queue.size(); first += textBatchQuads) {
+            size_t last = std::min(queue.size(), first + textBatchQuads);
+            rlCheckRenderBatchLimit(4 * (int)(last - first));
+            rlSetTexture(atlas.id);
+            rlBegin(RL_QUADS);
+            rlNormal3f(0.0f, 0.0f, 1.0f);
+            for (size_t q = first; q < last; q++) {
+                const QueuedGlyph& glyph = queue[q];
+                const Rectangle& s = glyph.source;
+                const Rectangle& d = glyph.dest;
+                rlColor4ub(glyph.color.r, glyph.color.g, glyph.color.b, glyph.color.a);
+                rlTexCoord2f(s.x / width, s.y / height);
+                rlVertex2f(d.x, d.y);
+                rlTexCoord2f(s.x / width, (s.y + s.height) / height);
+                rlVertex2f(d.x, d.y + d.height);
+                rlTexCoord2f((s.x + s.width) / width, (s.y + s.height) / height);
+                rlVertex2f(d.x + d.width, d.y + d.height);
+                rlTexCoord2f((s.x + s.width) / width, s.y / height);
+                rlVertex2f(d.x + d.width, d.y);
+            }
+            rlEnd();
+            rlSetTexture(0);
+        }
+        queue.clear();
+    }
+}
+
+void EndUITextFrame() {
+    textFrame++;
+    if (textFrame % 256 != 0) return;
+    for (auto it = textLayouts.begin(); it != textLayouts.end();) {
+        if (textFrame - it->second.lastFrame > textLayoutFrames) {
+            it = textLayouts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
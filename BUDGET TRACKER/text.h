@@ -0,0 +1,25 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+// Text drawing for the UI. The font is baked into one atlas per size the
+// screens use, so glyphs are drawn at their native size rather than scaled
+// from a single bitmap. A string's glyph quads are laid out once and cached
+// by its bytes and size; drawing it again only offsets them. Quads are
+// queued per atlas and sent by FlushUIText as one textured batch each,
+// instead of a texture switch per string between the shapes around it.
+
+#include "raylib.h"
+
+bool LoadUIFonts(const char* path); // false if it fell back to raylib's default font
+void UnloadUIFonts();
+
+void DrawUIText(const char* text, Vector2 position, float size, Color color);
+Vector2 MeasureUIText(const char* text, float size);
+
+// Draws the queued text. Call it before anything that must cover text
+// (or that changes the render target), and before EndDrawing.
+void FlushUIText();
+// Drops layouts not drawn or measured for a while; call once a frame.
+void EndUITextFrame();
+
+#endif
@@ -0,0 +1,153 @@
+#include "trend.h"
+#include "rollup.h"
+#include "profile.h"
+#include <algorithm>
+#include <climits>
+
+// One level of the pyramid: bucket start days, ascending, and the rollup
+// columns (income, expense, expense by category id) summed per bucket.
+struct TrendBuckets {
+    std::vector<int> firstDays;
+    std::vector<int64_t> columns;
+};
+
+TrendBuckets trendLevels[TREND_LEVEL_COUNT];
+int trendStride = 2;
+uint64_t trendVersion = UINT64_MAX; // ledgerVersion the pyramid was built from
+
+// First day of the bucket holding `day`. 1970-01-05 was a Monday.
+int GetBucketStart(int level, int day) {
+    if (level == TREND_DAY) return day;
+    if (level == TREND_WEEK) return day - ((day - 4) % 7 + 7) % 7;
+    int date = CivilFromDays(day);
+    if (level == TREND_MONTH) return DaysFromCivil(date / 10000, date / 100 % 100, 1);
+    return DaysFromCivil(date / 10000, 1, 1);
+}
+
+void UpdateTrendPyramid() {
+    if (trendVersion == ledgerVersion) return;
+    PROFILE_SCOPE("Trend pyramid");
+    trendVersion = ledgerVersion;
+
+    TrendBuckets& days = trendLevels[TREND_DAY];
+    int firstDay = 0;
+    GetDailyTotals(firstDay, trendStride, days.columns);
+    days.firstDays.resize(days.columns.size() / trendStride);
+    for (size_t i = 0; i < days.firstDays.size(); i++) days.firstDays[i] = firstDay + (int)i;
+
+    // Weeks and months are sums of whole days, years of whole months.
+    for (int level = TREND_WEEK; level < TREND_LEVEL_COUNT; level++) {
+        const TrendBuckets& finer = trendLevels[level == TREND_YEAR ? TREND_MONTH : TREND_DAY];
+        TrendBuckets& buckets = trendLevels[level];
+        buckets.firstDays.clear();
+        buckets.columns.clear();
+        for (size_t i = 0; i < finer.firstDays.size(); i++) {
+            int start = GetBucketStart(level, finer.firstDays[i]);
+            if (buckets.firstDays.empty() || buckets.firstDays.back() != start) {
+                buckets.firstDays.push_back(start);
+                buckets.columns.resize(buckets.columns.size() + trendStride, 0);
+            }
+            int64_t* to = &buckets.columns[buckets.columns.size() - trendStride];
+            const int64_t* from = &finer.columns[i * trendStride];
+            for (int column = 0; column < trendStride; column++) to[column] += from[column];
+        }
+    }
+}
+
+bool GetTrendExtent(int& firstDay, int& lastDay) {
+    const std::vector<int>& days = trendLevels[TREND_DAY].firstDays;
+    if (days.empty()) return false;
+    firstDay = days.front();
+    lastDay = days.back();
+    return true;
+}
+
+// Buckets [first, last) of `buckets` that cover [firstDay, lastDay], with
+// one more either side where there is one.
+void FindTrendBuckets(const TrendBuckets& buckets, int firstDay, int lastDay, size_t& first, size_t& last) {
+    const std::vector<int>& starts = buckets.firstDays;
+    first = std::upper_bound(starts.begin(), starts.end(), firstDay) - starts.begin();
+    first = first >= 2 ? first - 2 : 0;
+    last = std::upper_bound(starts.begin(), starts.end(), lastDay) - starts.begin();
+    last = std::min(last + 1, starts.size());
+}
+
+TrendLevel PickTrendLevel(int firstDay, int lastDay, int pixels) {
+    for (int level = TREND_DAY; level < TREND_YEAR; level++) {
+        size_t first;
+        size_t last;
+        FindTrendBuckets(trendLevels[level], firstDay, lastDay, first, last);
+        if (last - first <= (size_t)pixels * 2) return (TrendLevel)level;
+    }
+    return TREND_YEAR;
+}
+
+int64_t GetSeriesValue(const int64_t* bucket, int series) {
+    if (series == TREND_INCOME) return bucket[0];
+    if (series == TREND_EXPENSE) return bucket[1];
+    if (series == TREND_BALANCE) return bucket[0] - bucket[1];
+    int column = 2 + series - TREND_CATEGORY;
+    return column < trendStride ? bucket[column] : 0;
+}
+
+void GetTrendPoints(TrendLevel level, int series, int firstDay, int lastDay, size_t maxPoints,
+                    std::vector<TrendPoint>& out) {
+    const TrendBuckets& buckets = trendLevels[level];
+    out.clear();
+    size_t first;
+    size_t last;
+    FindTrendBuckets(buckets, firstDay, lastDay, first, last);
+    auto point = [&](size_t i) {
+        return TrendPoint{buckets.firstDays[i], GetSeriesValue(&buckets.columns[i * trendStride], series)};
+    };
+    if (last - first <= maxPoints || maxPoints < 3) {
+        for (size_t i = first; i < last; i++) out.push_back(point(i));
+        return;
+    }
+
+    // LTTB: the end points stay; between them, each of maxPoints - 2 equal
+    // slices keeps the point making the largest triangle with the point
+    // kept before it and the average of the next slice.
+    size_t slices = maxPoints - 2;
+    double sliceSize = (double)(last - first - 2) / slices;
+    auto sliceStart = [&](size_t slice) { return std::min(first + 1 + (size_t)(slice * sliceSize), last - 1); };
+    out.push_back(point(first));
+    TrendPoint kept = out.back();
+    for (size_t slice = 0; slice < slices; slice++) {
+        size_t begin = sliceStart(slice);
+        size_t end = std::max(sliceStart(slice + 1), begin + 1);
+        size_t nextEnd = slice + 1 < slices ? std::max(sliceStart(slice + 2), end + 1) : last;
+        double averageDay = 0;
+        double averageValue = 0;
+        for (size_t i = end; i < nextEnd; i++) {
+            averageDay += buckets.firstDays[i];
+            averageValue += (double)GetSeriesValue(&buckets.columns[i * trendStride], series);
+        }
+        averageDay /= nextEnd - end;
+        averageValue /= nextEnd - end;
+
+        double largest = -1;
+        TrendPoint best = point(begin);
+        for (size_t i = begin; i < end; i++) {
+            TrendPoint candidate = point(i);
+            double area = (kept.day - averageDay) * ((double)candidate.value - kept.value) -
+                          (kept.day - candidate.day) * (averageValue - kept.value);
+            if (area < 0) area = -area;
+            if (area > largest) {
+                largest = area;
+                best = candidate;
+            }
+        }
+        out.push_back(best);
+        kept = best;
+    }
+    out.push_back(point(last - 1));
+}
+
+size_t GetTrendMemoryUsage() {
+    size_t bytes = 0;
+    for (const TrendBuckets& buckets : trendLevels) {
+        bytes += buckets.firstDays.capacity() * sizeof(int) + buckets.columns.capacity() * sizeof(int64_t);
+    }
+    return bytes;
+}
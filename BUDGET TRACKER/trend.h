@@ -0,0 +1,41 @@
+#ifndef TREND_H
+#define TREND_H
+
+// Time series for the trend chart: income, expense, balance and each
+// category's expense across the whole history. The day rollups' per-day
+// totals are bucketed into a pyramid of day, week, month and year levels,
+// rebuilt only when the ledger changes, so drawing any view reads just the
+// buckets it covers. A view uses the finest level that gives at most two
+// buckets per pixel; a daily view wider than that is thinned with
+// largest-triangle-three-buckets (LTTB), which keeps the spikes that
+// plain striding would drop.
+
+#include "ledger.h"
+
+enum TrendLevel {
+    TREND_DAY,
+    TREND_WEEK,  // Monday to Sunday
+    TREND_MONTH,
+    TREND_YEAR,
+    TREND_LEVEL_COUNT
+};
+
+// Series ids; TREND_CATEGORY + id is that category's expense.
+enum TrendSeries { TREND_INCOME, TREND_EXPENSE, TREND_BALANCE, TREND_CATEGORY };
+
+struct TrendPoint {
+    int day;       // first day of the bucket, days since 1970-01-01
+    int64_t value; // paise
+};
+
+void UpdateTrendPyramid(); // rebuilds it if ledgerVersion moved since the last call
+bool GetTrendExtent(int& firstDay, int& lastDay); // first and last day with any amount
+// The finest level with at most two buckets per pixel over [firstDay, lastDay].
+TrendLevel PickTrendLevel(int firstDay, int lastDay, int pixels);
+// The buckets of `level` covering [firstDay, lastDay], plus one either side
+// so lines run off the edges, thinned by LTTB to maxPoints when there are more.
+void GetTrendPoints(TrendLevel level, int series, int firstDay, int lastDay, size_t maxPoints,
+                    std::vector<TrendPoint>& out);
+size_t GetTrendMemoryUsage();
+
+#endif
@@ -0,0 +1,242 @@
+#include "watch.h"
+#include "journal.h"
+#include "profile.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+std::thread watchThread;
+std::mutex watchMutex;
+std::condition_variable watchWake;
+bool watchStopping = false;
+void (*watchCallback)() = nullptr;
+std::atomic<bool> ledgerFileChanged(false);
+#ifdef __linux__
+int watchStopPipe[2] = {-1, -1}; // written to on stop, to wake poll()
+#endif
+
+bool tailActive = false;
+bool tailReload = false;
+std::vector<JournalWrite> ownWrites; // our batches not yet stepped over
+
+void SignalLedgerChange() {
+    ledgerFileChanged = true;
+    if (watchCallback) watchCallback();
+}
+
+struct FileStamp {
+    bool exists;
+    long long size;
+    long long modified;
+    long long inode; // a replaced file of the same size and second still differs here
+    bool operator!=(const FileStamp& other) const {
+        return exists != other.exists || size != other.size || modified != other.modified || inode != other.inode;
+    }
+};
+
+FileStamp GetFileStamp(const std::string& path) {
+    FileStamp stamp = {false, 0, 0, 0};
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0) {
+        stamp = {true, (long long)info.st_size, (long long)info.st_mtime, (long long)info.st_ino};
+    }
+    return stamp;
+}
+
+void PollLedgerFile(const std::string& path) {
+    std::unique_lock<std::mutex> lock(watchMutex);
+    FileStamp last = GetFileStamp(path);
+    while (!watchWake.wait_for(lock, std::chrono::milliseconds(500), []() { return watchStopping; })) {
+        FileStamp stamp = GetFileStamp(path);
+        if (stamp != last) {
+            last = stamp;
+            SignalLedgerChange();
+        }
+    }
+}
+
+#ifdef __linux__
+// The directory is watched rather than the file, so a file renamed over
+// it (a rewrite, or an editor's save) is seen too.
+bool WatchWithInotify(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) return false;
+    if (inotify_add_watch(fd, directory.c_str(),
+                          IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO) < 0) {
+        close(fd);
+        return false;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    pollfd waits[2] = {{fd, POLLIN, 0}, {watchStopPipe[0], POLLIN, 0}};
+    while (poll(waits, 2, -1) >= 0 || errno == EINTR) {
+        if (waits[1].revents) break;
+        bool changed = false;
+        ssize_t length;
+        while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char* at = buffer; at < buffer + length;) {
+                const inotify_event* event = (const inotify_event*)at;
+                if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && name == event->name)) changed = true;
+                at += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (changed) SignalLedgerChange();
+    }
+    close(fd);
+    return true;
+}
+#endif
+
+void StartLedgerWatch(const std::string& path, void (*onChange)()) {
+    StopLedgerWatch();
+    watchStopping = false;
+    watchCallback = onChange;
+#ifdef __linux__
+    if (pipe2(watchStopPipe, O_CLOEXEC) != 0) watchStopPipe[0] = watchStopPipe[1] = -1;
+#endif
+    watchThread = std::thread([path]() {
+#ifdef __linux__
+        if (watchStopPipe[0] >= 0 && WatchWithInotify(path)) return;
+#endif
+        PollLedgerFile(path);
+    });
+}
+
+void StopLedgerWatch() {
+    if (!watchThread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(watchMutex);
+        watchStopping = true;
+    }
+    watchWake.notify_one();
+#ifdef __linux__
+    if (watchStopPipe[1] >= 0) {
+        char wake = 0;
+        ssize_t written = write(watchStopPipe[1], &wake, 1);
+        (void)written;
+    }
+#endif
+    watchThread.join();
+#ifdef __linux__
+    for (int& fd : watchStopPipe) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+#endif
+}
+
+bool LedgerFileChanged() {
+    return ledgerFileChanged.exchange(false);
+}
+
+void SetLedgerHeld(uint64_t bytes, uint64_t fingerprint) {
+    ledgerLoadedBytes = bytes;
+    ledgerLoadedFingerprint = fingerprint;
+    tailReload = false;
+    TakeJournalWrites(ownWrites); // all in the new file, at offsets of the old one
+    ownWrites.clear();
+}
+
+void StartLedgerTail() {
+    tailActive = true;
+    tailReload = false;
+    TakeJournalWrites(ownWrites); // the load read every batch so far
+    ownWrites.clear();
+    ledgerFileChanged = true; // in case it grew since the load
+}
+
+bool CatchUpOwnWrites(const MappedFile& mapped) {
+    TakeJournalWrites(ownWrites);
+    uint64_t held = ledgerLoadedBytes;
+    if (mapped.size < held || (held > 0 && FingerprintCSV(mapped.data, held) != ledgerLoadedFingerprint)) {
+        return false; // truncated or rewritten
+    }
+    // Rows from elsewhere can only follow our batches: one landing in
+    // between would take a file row id the store has given to one of ours.
+    uint64_t position = held;
+    for (const JournalWrite& write : ownWrites) {
+        if (write.offset + write.length <= held) continue; // the load read it
+        if (write.offset != position || write.offset + write.length > mapped.size) return false;
+        position += write.length;
+    }
+    ownWrites.clear();
+    if (position != held) {
+        ledgerLoadedBytes = position;
+        ledgerLoadedFingerprint = FingerprintCSV(mapped.data, position);
+    }
+    return true;
+}
+
+TailResult ReadLedgerTail(const MappedFile& mapped, LoadStats& stats) {
+    if (!CatchUpOwnWrites(mapped)) return TAIL_RELOAD;
+
+    uint64_t position = ledgerLoadedBytes;
+    const char* begin = mapped.data + position;
+    // A line still being written waits for the next change.
+    const char* end = FindLinesEnd(begin, mapped.data + mapped.size);
+    const char* rows = begin;
+    if (position == 0 && begin < end) {
+        rows = (const char*)memchr(begin, '\n', end - begin) + 1; // header of a file another program started
+    }
+    if (rows < end) {
+        // Edits from elsewhere may number rows against a file we have not
+        // seen, and their indexes are only rebuilt by a full load, so a
+        // record is turned away before any line reaches the store.
+        for (const char* line = rows; line < end; line = (const char*)memchr(line, '\n', end - line) + 1) {
+            if (*line == '#') return TAIL_RELOAD;
+        }
+        uint32_t firstRow = (uint32_t)transactions.size();
+        stats = AppendCSVRange(rows, end);
+        AddRowsToIndexes(firstRow);
+    }
+    ledgerLoadedBytes = end - mapped.data;
+    ledgerLoadedFingerprint = FingerprintCSV(mapped.data, ledgerLoadedBytes);
+    return stats.rowsLoaded + stats.rowsSkipped > 0 ? TAIL_APPENDED : TAIL_UNCHANGED;
+}
+
+TailResult TailLedgerFile(LoadStats& stats) {
+    PROFILE_SCOPE("Tail ledger");
+    stats = {0, 0};
+    if (!tailActive) return TAIL_UNCHANGED;
+    if (tailReload) return TAIL_RELOAD;
+    // Our batches still on their way would read as rows from elsewhere.
+    // Rather than wait for the writer (and its fsync), try again later: the
+    // write itself is a change the watcher reports.
+    if (!TakeJournalWrites(ownWrites)) {
+        ledgerFileChanged = true;
+        return TAIL_UNCHANGED;
+    }
+    MappedFile mapped;
+    if (!OpenMappedFile(ledgerPath, mapped)) return TAIL_UNCHANGED; // removed; wait for it to come back
+    TailResult result = ReadLedgerTail(mapped, stats);
+    CloseMappedFile(mapped);
+    if (result == TAIL_RELOAD) tailReload = true;
+    return result;
+}
+
+bool BeginLedgerReplace() {
+    if (!FlushJournal()) return false; // the writer takes the lock too; and a rewrite would hold rows it is retrying
+    if (!LockLedgerFile(ledgerPath)) return false;
+    LoadStats stats;
+    if (TailLedgerFile(stats) == TAIL_RELOAD) {
+        UnlockLedgerFile();
+        ledgerFileChanged = true;
+        return false;
+    }
+    return true;
+}
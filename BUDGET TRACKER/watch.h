@@ -0,0 +1,49 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+// Live reload of rows other programs append to the ledger file. A watcher
+// thread waits for changes to it (inotify on the file's directory on Linux,
+// a size and mtime poll elsewhere) and raises a flag; the UI thread then
+// calls TailLedgerFile, which parses only the bytes past what the store
+// already holds. The journal records where its own batches went, so those
+// are stepped over rather than read back. A file that was truncated or
+// rewritten, or whose new bytes cannot simply be appended (edit records,
+// or foreign rows landing between ours), needs a full reload instead.
+
+#include "ledger.h"
+
+// `onChange`, if set, is also called from the watcher thread on each
+// change, e.g. to wake a UI that sleeps until input.
+void StartLedgerWatch(const std::string& path, void (*onChange)());
+void StopLedgerWatch();
+bool LedgerFileChanged(); // true once per change since the last call
+
+// Tails on from ledgerLoadedBytes; until the first call TailLedgerFile
+// does nothing. Call after each load, with the journal drained.
+void StartLedgerTail();
+// The store holds all `bytes` of a file that replaced the ledger, whose
+// FingerprintCSV is `fingerprint`.
+void SetLedgerHeld(uint64_t bytes, uint64_t fingerprint);
+// Moves ledgerLoadedBytes past the journal's batches that follow it in
+// `mapped`. False if the file no longer starts with what the store holds,
+// or has rows from elsewhere ahead of one of ours.
+bool CatchUpOwnWrites(const MappedFile& mapped);
+
+enum TailResult {
+    TAIL_UNCHANGED, // nothing new from other programs
+    TAIL_APPENDED,  // their rows are in the store and every index
+    TAIL_RELOAD     // the store no longer matches the file; load it again
+};
+// Merges complete lines appended by others since the last call. While a
+// journal batch is still being written it returns TAIL_UNCHANGED at once
+// and leaves LedgerFileChanged raised. Once it returns TAIL_RELOAD it keeps
+// doing so until the next StartLedgerTail or SetLedgerHeld.
+TailResult TailLedgerFile(LoadStats& stats);
+
+// Takes the ledger's append lock (LockLedgerFile) and tails it, so a
+// rewrite about to replace the file keeps every row appended to it so far.
+// Returns false, without the lock, if the store needs a reload instead.
+// The caller renames the new file in and calls UnlockLedgerFile.
+bool BeginLedgerReplace();
+
+#endif